@@ -0,0 +1,62 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Compositor stacking list */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "comp-stack.h"
+
+void meta_comp_stack_unlink(GList **head, GList **tail, GList *link) {
+  if (link->prev)
+    link->prev->next = link->next;
+  else
+    *head = link->next;
+
+  if (link->next)
+    link->next->prev = link->prev;
+  else
+    *tail = link->prev;
+
+  link->prev = NULL;
+  link->next = NULL;
+}
+
+void meta_comp_stack_insert_above(GList **head, GList **tail, GList *link,
+                                  GList *sibling) {
+  if (sibling == NULL) {
+    link->prev = *tail;
+    link->next = NULL;
+  } else {
+    link->prev = sibling->prev;
+    link->next = sibling;
+  }
+
+  if (link->prev)
+    link->prev->next = link;
+  else
+    *head = link;
+
+  if (link->next)
+    link->next->prev = link;
+  else
+    *tail = link;
+}
@@ -0,0 +1,42 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Compositor stacking list */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef META_COMP_STACK_H
+#define META_COMP_STACK_H
+
+#include <glib.h>
+
+/* The stack is an ordinary GList running from *head (top) to *tail
+ * (bottom), whose links are embedded in the windows they point to, so
+ * that a window can be moved without searching for it. Neither
+ * function allocates or frees anything.
+ */
+
+/* Takes link out of the stack */
+void meta_comp_stack_unlink(GList **head, GList **tail, GList *link);
+
+/* Puts link into the stack directly above sibling, or at the bottom if
+ * sibling is NULL.
+ */
+void meta_comp_stack_insert_above(GList **head, GList **tail, GList *link,
+                                  GList *sibling);
+
+#endif
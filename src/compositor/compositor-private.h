@@ -45,6 +45,12 @@ struct _MetaCompositor {
 
   void (*maximize_window)(MetaCompositor *compositor, MetaWindow *window);
   void (*unmaximize_window)(MetaCompositor *compositor, MetaWindow *window);
+
+  char *(*get_stats)(MetaCompositor *compositor);
+
+  cairo_surface_t *(*get_window_thumbnail)(MetaCompositor *compositor,
+                                           MetaWindow *window, int max_width,
+                                           int max_height);
 };
 
 #endif
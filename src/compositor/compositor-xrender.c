@@ -36,6 +36,7 @@
 #include <X11/extensions/Xfixes.h>
 #include <X11/extensions/Xrender.h>
 #include <X11/extensions/shape.h>
+#include <cairo/cairo-xlib-xrender.h>
 #include <cairo/cairo-xlib.h>
 #include <gdk/gdk.h>
 #include <gdk/gdkx.h>
@@ -49,13 +50,16 @@
 #include "../core/display-private.h"
 #include "../core/screen-private.h"
 #include "../core/workspace.h"
+#include "comp-stack.h"
 #include "compositor-private.h"
 #include "compositor-xrender.h"
 #include "core.h"
 #include "display.h"
 #include "errors.h"
 #include "frame.h"
+#include "prefs.h"
 #include "screen.h"
+#include "thumbnail.h"
 #include "window.h"
 #include "xprops.h"
 
@@ -107,6 +111,29 @@ typedef struct _MetaCompositorXRender {
 #ifdef USE_IDLE_REPAINT
   guint repaint_id;
 #endif
+
+  /* Every MetaCompWindow of every screen, keyed by XID */
+  GHashTable *windows_by_xid;
+
+  /* Frame timing, in microseconds of monotonic time */
+  gint64 damage_time;        /* first damage not painted yet, 0 if none */
+  gint64 last_frame_time;    /* start of the last paint */
+  gint64 refresh_interval;   /* measured from Present events, 0 if unknown */
+  gint64 last_paint_time;    /* how long the last paint took */
+  gint64 last_frame_latency; /* from first damage to end of the last paint */
+  guint64 frame_count;
+
+  /* Always-on counters, read with marco-message compositor-stats */
+  gint64 paint_time;             /* total time spent in paint_all */
+  guint64 damage_area;           /* pixels repainted over all frames */
+  guint64 last_damage_area;      /* pixels repainted by the last frame */
+  guint64 windows_painted;       /* window composites over all frames */
+  guint last_windows_painted;    /* window composites in the last frame */
+  guint64 shadows_created;       /* shadow images rendered on the CPU */
+  guint64 xfixes_requests;       /* XFixes requests sent */
+  guint64 thumbnails_rendered;   /* alt-tab thumbnails scaled */
+  gint64 thumbnail_render_time;  /* total time spent scaling them */
+
   guint enabled : 1;
   guint show_redraw : 1;
   guint debug : 1;
@@ -128,11 +155,67 @@ typedef struct _shadow {
   guchar *shadow_top;
 } shadow;
 
-#define NUM_BUFFER 2
+/* make_shadow() quantises the opacity into 25 steps */
+#define SHADOW_OPACITY_LEVELS 26
+
+/* The nine pieces a shadow is assembled from.  corners holds the shadow
+   of a (msize + 1) square window, the other pictures are single rows or
+   columns of it that repeat to fill the edges and the interior. */
+typedef struct _MetaShadowSlices {
+  int msize;
+
+  Picture corners;
+  Picture top;
+  Picture bottom;
+  Picture left;
+  Picture right;
+  Picture centre;
+} MetaShadowSlices;
+
+/* Number of shadow pictures kept around after their last user is gone */
+#define SHADOW_CACHE_SIZE 32
+
+typedef struct _MetaShadowKey {
+  MetaShadowType shadow_type;
+  guint opacity;
+  int width;
+  int height;
+  int border_left;
+  int border_top;
+  cairo_region_t *clip; /* frame bounds of the window, may be NULL */
+} MetaShadowKey;
+
+typedef struct _MetaShadowEntry {
+  MetaShadowKey key;
+
+  Picture picture;
+  int width;
+  int height;
+
+  guint ref_count;
+  GList *unused_link; /* set while ref_count is 0 */
+} MetaShadowEntry;
+
+typedef struct _MetaShadowCache {
+  GHashTable *entries;
+  GQueue unused; /* most recently released first */
+
+  guint hits;
+  guint misses;
+  guint evictions;
+} MetaShadowCache;
+
+#define ALPHA_LEVELS 256
+
+/* Upper bound of the compositing-buffer-count preference */
+#define MAX_NUM_BUFFER 4
 typedef struct _MetaCompScreen {
   MetaScreen *screen;
+
+  /* Stacking order, top-most first. The links are embedded in the
+     windows so restacking never has to search the list. */
   GList *windows;
-  GHashTable *windows_by_xid;
+  GList *windows_tail;
 
   MetaWindow *focus_window;
 
@@ -140,36 +223,65 @@ typedef struct _MetaCompScreen {
 
   gboolean have_shadows;
   shadow *shadows[LAST_SHADOW_TYPE];
+  MetaShadowSlices *shadow_slices[LAST_SHADOW_TYPE][SHADOW_OPACITY_LEVELS];
+  MetaShadowCache *shadow_cache;
 
   Picture root_picture;
-  Picture root_buffers[NUM_BUFFER];
-  Pixmap root_pixmaps[NUM_BUFFER];
+  Picture root_buffers[MAX_NUM_BUFFER];
+  Pixmap root_pixmaps[MAX_NUM_BUFFER];
   int root_current;
+  int num_buffers;
   Picture black_picture;
   Picture trans_black_picture;
   Picture root_tile;
-  XserverRegion all_damage;
+
+  /* Masks for translucent windows, one per opacity level an A8 picture
+     can hold, shared by all windows with that opacity */
+  Picture alpha_pictures[ALPHA_LEVELS];
+
+  cairo_region_t *all_damage;
 #ifdef HAVE_PRESENT
-  XserverRegion prev_damage;
+  /* Damage of the frames painted last, newest first. A buffer last
+     painted n frames ago is brought up to date by repainting the first
+     n - 1 entries along with the new damage. */
+  cairo_region_t *damage_ring[MAX_NUM_BUFFER - 1];
+  guint64 frame_serial;                  /* frames painted so far */
+  guint64 root_painted[MAX_NUM_BUFFER]; /* frame_serial when each buffer
+                                            was painted, 0 if its
+                                            contents are undefined */
 
   XID present_eid;
   gboolean use_present;
-  gboolean present_pending;
+  int present_pending; /* flips that have not completed yet */
+  guint64 present_msc;
+  guint64 present_ust;
 #endif /* HAVE_PRESENT */
 
   guint overlays;
   gboolean compositor_active;
   gboolean clip_changed;
 
+  /* Fullscreen window currently drawn directly by the X server, if any */
+  struct _MetaCompWindow *unredirected_window;
+
   GSList *dock_windows;
 } MetaCompScreen;
 
+/* How much of a window the frame being painted can show */
+typedef enum {
+  META_COMP_VISIBILITY_OCCLUDED, /* nothing, the window is skipped */
+  META_COMP_VISIBILITY_PARTIAL,
+  META_COMP_VISIBILITY_FULL
+} MetaCompVisibility;
+
 typedef struct _MetaCompWindow {
   MetaScreen *screen;
   MetaWindow *window; /* May be NULL if this window isn't managed by Marco */
   Window id;
   XWindowAttributes attrs;
 
+  GList stack_link; /* in MetaCompScreen.windows, data points back here */
+
   Pixmap back_pixmap;
 
   /* When the window is shaded back_pixmap will be replaced with the pixmap
@@ -188,17 +300,24 @@ typedef struct _MetaCompWindow {
   MetaCompWindowType type;
 
   Damage damage;
-  Picture picture;
-  Picture alpha_pict;
+  Picture picture; /* on the window itself, so it survives remaps and
+                      resizes and is only freed with the window */
 
   gboolean needs_shadow;
   MetaShadowType shadow_type;
   Picture shadow_pict;
 
-  XserverRegion border_size;
-  XserverRegion extents;
+  /* Regions are tracked client side so that painting a frame only has to
+     send the final clip of each window to the X server */
+  cairo_region_t *border_size;
+  cairo_region_t *extents;
+
+  /* Bounding shape relative to the window, fetched while shaped */
+  cairo_region_t *shape_region;
 
   Picture shadow;
+  MetaShadowEntry *shadow_entry;
+  MetaShadowSlices *shadow_slices;
   int shadow_dx;
   int shadow_dy;
   int shadow_width;
@@ -206,7 +325,16 @@ typedef struct _MetaCompWindow {
 
   guint opacity;
 
-  XserverRegion border_clip;
+  cairo_region_t *border_clip;
+  MetaCompVisibility visibility; /* classified by paint_windows () */
+
+  /* Scaled copy for the alt-tab popup, rendered again on the next
+     request once the window has been damaged */
+  cairo_surface_t *thumbnail;
+  int thumbnail_max_width;
+  int thumbnail_max_height;
+  gint64 thumbnail_time; /* when it was last rendered */
+  gboolean thumbnail_dirty;
 
   gboolean updates_frozen;
   gboolean update_pending;
@@ -214,6 +342,9 @@ typedef struct _MetaCompWindow {
 
 #define OPAQUE 0xffffffff
 
+/* A damaged thumbnail younger than this is handed out as it is */
+#define THUMBNAIL_REFRESH_INTERVAL 1000 /* ms */
+
 #define WINDOW_SOLID 0
 #define WINDOW_ARGB 1
 
@@ -270,30 +401,33 @@ static conv *make_gaussian_map(double r) {
   return c;
 }
 
-static void dump_xserver_region(const char *location, MetaDisplay *display,
-                                XserverRegion region) {
+static void dump_region(const char *location, MetaDisplay *display,
+                        cairo_region_t *region) {
   MetaCompositorXRender *compositor = DISPLAY_COMPOSITOR(display);
-  Display *xdisplay = meta_display_get_xdisplay(display);
   int nrects;
-  XRectangle *rects;
-  XRectangle bounds;
 
   if (!compositor->debug) return;
 
   if (region) {
-    rects = XFixesFetchRegionAndBounds(xdisplay, region, &nrects, &bounds);
+    nrects = cairo_region_num_rectangles(region);
     if (nrects > 0) {
+      cairo_rectangle_int_t bounds;
       int i;
-      fprintf(stderr, "%s (XSR): %d rects, bounds: %d,%d (%d,%d)\n", location,
+
+      cairo_region_get_extents(region, &bounds);
+      fprintf(stderr, "%s: %d rects, bounds: %d,%d (%d,%d)\n", location,
               nrects, bounds.x, bounds.y, bounds.width, bounds.height);
-      for (i = 1; i < nrects; i++)
-        fprintf(stderr, "\t%d,%d (%d,%d)\n", rects[i].x, rects[i].y,
-                rects[i].width, rects[i].height);
+      for (i = 0; i < nrects; i++) {
+        cairo_rectangle_int_t rect;
+
+        cairo_region_get_rectangle(region, i, &rect);
+        fprintf(stderr, "\t%d,%d (%d,%d)\n", rect.x, rect.y, rect.width,
+                rect.height);
+      }
     } else
-      fprintf(stderr, "%s (XSR): empty\n", location);
-    XFree(rects);
+      fprintf(stderr, "%s: empty\n", location);
   } else
-    fprintf(stderr, "%s (XSR): null\n", location);
+    fprintf(stderr, "%s: null\n", location);
 }
 
 /*
@@ -435,6 +569,8 @@ static XImage *make_shadow(MetaDisplay *display, MetaScreen *screen,
     return NULL;
   }
 
+  DISPLAY_COMPOSITOR(display)->shadows_created++;
+
   shad = info->shadows[shadow_type];
   msize = shad->gaussian_map->size;
   swidth = width + msize;
@@ -562,15 +698,52 @@ static XserverRegion cairo_region_to_xserver_region(Display *xdisplay,
   return xregion;
 }
 
+/* Clips picture to region, or removes the clip if region is NULL */
+static void set_picture_clip_region(Display *xdisplay, Picture picture,
+                                    cairo_region_t *region) {
+  XRectangle stack_rects[32];
+  XRectangle *rects;
+  int n_rects, i;
+
+  if (region == NULL) {
+    XRenderPictureAttributes pa;
+
+    pa.clip_mask = None;
+    XRenderChangePicture(xdisplay, picture, CPClipMask, &pa);
+    return;
+  }
+
+  n_rects = cairo_region_num_rectangles(region);
+  if (n_rects <= (int)G_N_ELEMENTS(stack_rects))
+    rects = stack_rects;
+  else
+    rects = g_new(XRectangle, n_rects);
+
+  for (i = 0; i < n_rects; i++) {
+    cairo_rectangle_int_t rect;
+
+    cairo_region_get_rectangle(region, i, &rect);
+
+    rects[i].x = rect.x;
+    rects[i].y = rect.y;
+    rects[i].width = rect.width;
+    rects[i].height = rect.height;
+  }
+
+  XRenderSetPictureClipRectangles(xdisplay, picture, 0, 0, rects, n_rects);
+
+  if (rects != stack_rects) g_free(rects);
+}
+
 static void shadow_picture_clip(Display *xdisplay, Picture shadow_picture,
                                 MetaCompWindow *cw, MetaFrameBorders borders,
                                 int width, int height) {
   int shadow_dx;
   int shadow_dy;
   cairo_region_t *visible_region;
-  XRectangle rect;
-  XserverRegion region1;
-  XserverRegion region2;
+  cairo_rectangle_int_t rect;
+  cairo_region_t *clip;
+  cairo_region_t *visible;
 
   if (!cw->window) return;
 
@@ -588,16 +761,16 @@ static void shadow_picture_clip(Display *xdisplay, Picture shadow_picture,
   rect.width = width;
   rect.height = height;
 
-  region1 = XFixesCreateRegion(xdisplay, &rect, 1);
-  region2 = cairo_region_to_xserver_region(xdisplay, visible_region);
+  clip = cairo_region_create_rectangle(&rect);
+  visible = cairo_region_copy(visible_region);
 
-  XFixesTranslateRegion(xdisplay, region2, shadow_dx, shadow_dy);
+  cairo_region_translate(visible, shadow_dx, shadow_dy);
 
-  XFixesSubtractRegion(xdisplay, region1, region1, region2);
-  XFixesSetPictureClipRegion(xdisplay, shadow_picture, 0, 0, region1);
+  cairo_region_subtract(clip, visible);
+  set_picture_clip_region(xdisplay, shadow_picture, clip);
 
-  XFixesDestroyRegion(xdisplay, region1);
-  XFixesDestroyRegion(xdisplay, region2);
+  cairo_region_destroy(clip);
+  cairo_region_destroy(visible);
 }
 
 static Picture shadow_picture(MetaDisplay *display, MetaScreen *screen,
@@ -654,26 +827,333 @@ static Picture shadow_picture(MetaDisplay *display, MetaScreen *screen,
   return shadow_picture;
 }
 
-static MetaCompWindow *find_window_for_screen(MetaScreen *screen,
-                                              Window xwindow) {
+static guint shadow_key_hash(gconstpointer data) {
+  const MetaShadowKey *key = data;
+  guint hash;
+
+  hash = key->shadow_type;
+  hash = hash * 31 + key->opacity;
+  hash = hash * 31 + key->width;
+  hash = hash * 31 + key->height;
+  hash = hash * 31 + key->border_left;
+  hash = hash * 31 + key->border_top;
+
+  if (key->clip) {
+    cairo_rectangle_int_t extents;
+
+    cairo_region_get_extents(key->clip, &extents);
+    hash = hash * 31 + cairo_region_num_rectangles(key->clip);
+    hash = hash * 31 + extents.x;
+    hash = hash * 31 + extents.y;
+    hash = hash * 31 + extents.width;
+    hash = hash * 31 + extents.height;
+  }
+
+  return hash;
+}
+
+static gboolean shadow_key_equal(gconstpointer a, gconstpointer b) {
+  const MetaShadowKey *key_a = a;
+  const MetaShadowKey *key_b = b;
+
+  return key_a->shadow_type == key_b->shadow_type &&
+         key_a->opacity == key_b->opacity && key_a->width == key_b->width &&
+         key_a->height == key_b->height &&
+         key_a->border_left == key_b->border_left &&
+         key_a->border_top == key_b->border_top &&
+         cairo_region_equal(key_a->clip, key_b->clip);
+}
+
+static MetaShadowCache *shadow_cache_new(void) {
+  MetaShadowCache *cache;
+
+  cache = g_new0(MetaShadowCache, 1);
+  cache->entries = g_hash_table_new(shadow_key_hash, shadow_key_equal);
+  g_queue_init(&cache->unused);
+
+  return cache;
+}
+
+static void shadow_entry_free(Display *xdisplay, MetaShadowEntry *entry) {
+  XRenderFreePicture(xdisplay, entry->picture);
+  if (entry->key.clip) cairo_region_destroy(entry->key.clip);
+  g_free(entry);
+}
+
+static void shadow_cache_free(Display *xdisplay, MetaShadowCache *cache) {
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init(&iter, cache->entries);
+  while (g_hash_table_iter_next(&iter, NULL, &value))
+    shadow_entry_free(xdisplay, value);
+
+  g_hash_table_destroy(cache->entries);
+  g_queue_clear(&cache->unused);
+  g_free(cache);
+}
+
+/* Returns a shadow picture shared with every other window of the same
+   geometry, creating it if needed.  Release it with release_shadow(). */
+static Picture get_shadow_picture(MetaDisplay *display, MetaScreen *screen,
+                                  MetaCompWindow *cw, double opacity,
+                                  MetaFrameBorders borders, int width,
+                                  int height, int *wp, int *hp) {
   MetaCompScreen *info = meta_screen_get_compositor_data(screen);
+  MetaShadowCache *cache;
+  MetaShadowEntry *entry;
+  MetaShadowKey key;
+
+  if (info == NULL) return None;
+
+  cache = info->shadow_cache;
+
+  key.shadow_type = cw->shadow_type;
+  key.opacity = cw->opacity;
+  key.width = width;
+  key.height = height;
+  key.border_left = borders.invisible.left;
+  key.border_top = borders.invisible.top;
+  key.clip = cw->window ? meta_window_get_frame_bounds(cw->window) : NULL;
+
+  entry = g_hash_table_lookup(cache->entries, &key);
+  if (entry != NULL) {
+    cache->hits++;
+
+    if (entry->unused_link != NULL) {
+      g_queue_delete_link(&cache->unused, entry->unused_link);
+      entry->unused_link = NULL;
+    }
+  } else {
+    Picture picture;
+    int shadow_width, shadow_height;
+
+    cache->misses++;
+
+    picture = shadow_picture(display, screen, cw, opacity, borders, width,
+                             height, &shadow_width, &shadow_height);
+    if (picture == None) return None;
+
+    entry = g_new0(MetaShadowEntry, 1);
+    entry->key = key;
+    if (key.clip) entry->key.clip = cairo_region_copy(key.clip);
+    entry->picture = picture;
+    entry->width = shadow_width;
+    entry->height = shadow_height;
+
+    g_hash_table_insert(cache->entries, &entry->key, entry);
+
+    if (DISPLAY_COMPOSITOR(display)->debug)
+      fprintf(stderr, "Shadow cache miss %dx%d (%u hits, %u misses)\n",
+              width, height, cache->hits, cache->misses);
+  }
+
+  entry->ref_count++;
+  cw->shadow_entry = entry;
+
+  *wp = entry->width;
+  *hp = entry->height;
+
+  return entry->picture;
+}
+
+static void release_shadow(MetaCompWindow *cw) {
+  MetaDisplay *display = meta_screen_get_display(cw->screen);
+  Display *xdisplay = meta_display_get_xdisplay(display);
+  MetaCompScreen *info = meta_screen_get_compositor_data(cw->screen);
+  MetaShadowEntry *entry = cw->shadow_entry;
+
+  cw->shadow = None;
+  cw->shadow_entry = NULL;
+  cw->shadow_slices = NULL;
+
+  /* Without a screen the cache, and the entry with it, is already gone */
+  if (entry == NULL || info == NULL) return;
+
+  if (--entry->ref_count > 0) return;
+
+  /* Keep it around for the next window of the same size, an
+     interactive resize or a focus change will usually ask for it again */
+  g_queue_push_head(&info->shadow_cache->unused, entry);
+  entry->unused_link = info->shadow_cache->unused.head;
+
+  while (g_queue_get_length(&info->shadow_cache->unused) > SHADOW_CACHE_SIZE) {
+    MetaShadowEntry *old = g_queue_pop_tail(&info->shadow_cache->unused);
+
+    g_hash_table_remove(info->shadow_cache->entries, &old->key);
+    shadow_entry_free(xdisplay, old);
+    info->shadow_cache->evictions++;
+  }
+}
+
+static Picture create_shadow_slice(Display *xdisplay, Window xroot,
+                                   Picture corners, int x, int y, int width,
+                                   int height) {
+  XRenderPictureAttributes pa;
+  Pixmap pixmap;
+  Picture picture;
+
+  pixmap = XCreatePixmap(xdisplay, xroot, width, height, 8);
+  g_return_val_if_fail(pixmap != None, None);
+
+  pa.repeat = TRUE;
+  picture = XRenderCreatePicture(
+      xdisplay, pixmap, XRenderFindStandardFormat(xdisplay, PictStandardA8),
+      CPRepeat, &pa);
+  XFreePixmap(xdisplay, pixmap);
+  g_return_val_if_fail(picture != None, None);
+
+  XRenderComposite(xdisplay, PictOpSrc, corners, None, picture, x, y, 0, 0, 0,
+                   0, width, height);
+
+  return picture;
+}
+
+static void shadow_slices_free(Display *xdisplay, MetaShadowSlices *slices) {
+  if (slices->corners) XRenderFreePicture(xdisplay, slices->corners);
+  if (slices->top) XRenderFreePicture(xdisplay, slices->top);
+  if (slices->bottom) XRenderFreePicture(xdisplay, slices->bottom);
+  if (slices->left) XRenderFreePicture(xdisplay, slices->left);
+  if (slices->right) XRenderFreePicture(xdisplay, slices->right);
+  if (slices->centre) XRenderFreePicture(xdisplay, slices->centre);
+  g_free(slices);
+}
+
+/* Uploads the shadow pieces for a shadow type and opacity once, every
+   window big enough to use them shares them from then on */
+static MetaShadowSlices *get_shadow_slices(MetaDisplay *display,
+                                           MetaScreen *screen,
+                                           MetaShadowType shadow_type,
+                                           double opacity) {
+  MetaCompScreen *info = meta_screen_get_compositor_data(screen);
+  Display *xdisplay = meta_display_get_xdisplay(display);
+  Window xroot = meta_screen_get_xroot(screen);
+  MetaShadowSlices *slices;
+  XImage *shadow_image;
+  Pixmap pixmap;
+  GC gc;
+  int opacity_int = (int)(opacity * 25);
+  int msize;
 
   if (info == NULL) return NULL;
 
-  return g_hash_table_lookup(info->windows_by_xid, (gpointer)xwindow);
+  opacity_int = CLAMP(opacity_int, 0, SHADOW_OPACITY_LEVELS - 1);
+  if (info->shadow_slices[shadow_type][opacity_int])
+    return info->shadow_slices[shadow_type][opacity_int];
+
+  msize = info->shadows[shadow_type]->gaussian_map->size;
+  if (msize <= 0) return NULL;
+
+  shadow_image =
+      make_shadow(display, screen, shadow_type, opacity, msize + 1, msize + 1);
+  if (!shadow_image) return NULL;
+
+  pixmap = XCreatePixmap(xdisplay, xroot, shadow_image->width,
+                         shadow_image->height, 8);
+  if (!pixmap) {
+    XDestroyImage(shadow_image);
+    return NULL;
+  }
+
+  gc = XCreateGC(xdisplay, pixmap, 0, 0);
+  if (!gc) {
+    XDestroyImage(shadow_image);
+    XFreePixmap(xdisplay, pixmap);
+    return NULL;
+  }
+
+  XPutImage(xdisplay, pixmap, gc, shadow_image, 0, 0, 0, 0,
+            shadow_image->width, shadow_image->height);
+  XFreeGC(xdisplay, gc);
+  XDestroyImage(shadow_image);
+
+  slices = g_new0(MetaShadowSlices, 1);
+  slices->msize = msize;
+  slices->corners = XRenderCreatePicture(
+      xdisplay, pixmap, XRenderFindStandardFormat(xdisplay, PictStandardA8), 0,
+      0);
+  XFreePixmap(xdisplay, pixmap);
+
+  if (slices->corners == None) {
+    g_free(slices);
+    return NULL;
+  }
+
+  /* Row/column msize of the template is the middle of every edge */
+  slices->top =
+      create_shadow_slice(xdisplay, xroot, slices->corners, msize, 0, 1, msize);
+  slices->bottom = create_shadow_slice(xdisplay, xroot, slices->corners, msize,
+                                       msize + 1, 1, msize);
+  slices->left =
+      create_shadow_slice(xdisplay, xroot, slices->corners, 0, msize, msize, 1);
+  slices->right = create_shadow_slice(xdisplay, xroot, slices->corners,
+                                      msize + 1, msize, msize, 1);
+  slices->centre =
+      create_shadow_slice(xdisplay, xroot, slices->corners, msize, msize, 1, 1);
+
+  if (!slices->top || !slices->bottom || !slices->left || !slices->right ||
+      !slices->centre) {
+    shadow_slices_free(xdisplay, slices);
+    return NULL;
+  }
+
+  info->shadow_slices[shadow_type][opacity_int] = slices;
+
+  return slices;
+}
+
+/* Windows at least msize wide and high get their shadow assembled from
+   the shared slices, smaller ones need the gaussian summed per pixel */
+static gboolean get_sliced_shadow(MetaDisplay *display, MetaScreen *screen,
+                                  MetaCompWindow *cw, double opacity,
+                                  int width, int height) {
+  MetaCompScreen *info = meta_screen_get_compositor_data(screen);
+  MetaShadowSlices *slices;
+  int msize;
+
+  if (info == NULL) return FALSE;
+
+  msize = info->shadows[cw->shadow_type]->gaussian_map->size;
+  if (width < msize || height < msize) return FALSE;
+
+  slices = get_shadow_slices(display, screen, cw->shadow_type, opacity);
+  if (slices == NULL) return FALSE;
+
+  cw->shadow_slices = slices;
+  cw->shadow_width = width + msize;
+  cw->shadow_height = height + msize;
+
+  return TRUE;
 }
 
 static MetaCompWindow *find_window_in_display(MetaDisplay *display,
                                               Window xwindow) {
-  GSList *index;
+  MetaCompositorXRender *compositor = DISPLAY_COMPOSITOR(display);
 
-  for (index = meta_display_get_screens(display); index; index = index->next) {
-    MetaCompWindow *cw = find_window_for_screen(index->data, xwindow);
+  return g_hash_table_lookup(compositor->windows_by_xid, (gpointer)xwindow);
+}
 
-    if (cw != NULL) return cw;
-  }
+static MetaCompWindow *find_window_for_screen(MetaScreen *screen,
+                                              Window xwindow) {
+  MetaCompWindow *cw;
 
-  return NULL;
+  cw = find_window_in_display(meta_screen_get_display(screen), xwindow);
+  if (cw == NULL || cw->screen != screen) return NULL;
+
+  return cw;
+}
+
+static void stack_unlink(MetaCompScreen *info, MetaCompWindow *cw) {
+  meta_comp_stack_unlink(&info->windows, &info->windows_tail, &cw->stack_link);
+}
+
+/* Stacks cw directly above sibling, or at the bottom if sibling is NULL */
+static void stack_insert_above(MetaCompScreen *info, MetaCompWindow *cw,
+                               MetaCompWindow *sibling) {
+  cw->stack_link.data = cw;
+  meta_comp_stack_insert_above(&info->windows, &info->windows_tail,
+                               &cw->stack_link,
+                               sibling ? &sibling->stack_link : NULL);
 }
 
 static MetaCompWindow *find_window_for_child_window_in_display(
@@ -948,48 +1428,69 @@ static gboolean window_has_shadow(MetaCompWindow *cw) {
   return FALSE;
 }
 
-static XserverRegion win_extents(MetaCompWindow *cw) {
+/* Frame borders of the window and size of the part that casts a shadow */
+static void get_shadow_geometry(MetaCompWindow *cw, MetaFrameBorders *borders,
+                                int *width, int *height) {
+  meta_frame_borders_clear(borders);
+
+  if (cw->window) {
+    MetaFrame *frame = meta_window_get_frame(cw->window);
+
+    if (frame) meta_frame_calc_borders(frame, borders);
+  }
+
+  *width = cw->attrs.width - borders->invisible.left -
+           borders->invisible.right + cw->attrs.border_width * 2;
+  *height = cw->attrs.height - borders->invisible.top -
+            borders->invisible.bottom + cw->attrs.border_width * 2;
+}
+
+static void ensure_shadow(MetaCompWindow *cw) {
   MetaScreen *screen = cw->screen;
   MetaDisplay *display = meta_screen_get_display(screen);
-  Display *xdisplay = meta_display_get_xdisplay(display);
-  XRectangle r;
+  MetaFrameBorders borders;
+  double opacity = SHADOW_OPACITY;
+  int width, height;
+
+  if (!cw->needs_shadow || cw->shadow || cw->shadow_slices) return;
+
+  get_shadow_geometry(cw, &borders, &width, &height);
+
+  if (cw->opacity != (guint)OPAQUE)
+    opacity = opacity * ((double)cw->opacity) / ((double)OPAQUE);
+
+  if (!get_sliced_shadow(display, screen, cw, opacity, width, height))
+    cw->shadow = get_shadow_picture(display, screen, cw, opacity, borders,
+                                    width, height, &cw->shadow_width,
+                                    &cw->shadow_height);
+}
+
+static cairo_region_t *win_extents(MetaCompWindow *cw) {
+  MetaCompScreen *info = meta_screen_get_compositor_data(cw->screen);
+  cairo_rectangle_int_t r;
 
   r.x = cw->attrs.x;
   r.y = cw->attrs.y;
   r.width = cw->attrs.width + cw->attrs.border_width * 2;
   r.height = cw->attrs.height + cw->attrs.border_width * 2;
 
-  if (cw->needs_shadow) {
+  if (cw->needs_shadow && info != NULL) {
     MetaFrameBorders borders;
-    XRectangle sr;
+    cairo_rectangle_int_t sr;
+    int width, height, msize;
 
-    meta_frame_borders_clear(&borders);
-
-    if (cw->window) {
-      MetaFrame *frame = meta_window_get_frame(cw->window);
-
-      if (frame) meta_frame_calc_borders(frame, &borders);
-    }
+    get_shadow_geometry(cw, &borders, &width, &height);
+    msize = info->shadows[cw->shadow_type]->gaussian_map->size;
 
     cw->shadow_dx =
         (int)shadow_offsets_x[cw->shadow_type] + borders.invisible.left;
     cw->shadow_dy =
         (int)shadow_offsets_y[cw->shadow_type] + borders.invisible.top;
 
-    if (!cw->shadow) {
-      double opacity = SHADOW_OPACITY;
-      int invisible_width = borders.invisible.left + borders.invisible.right;
-      int invisible_height = borders.invisible.top + borders.invisible.bottom;
-
-      if (cw->opacity != (guint)OPAQUE)
-        opacity = opacity * ((double)cw->opacity) / ((double)OPAQUE);
-
-      cw->shadow = shadow_picture(
-          display, screen, cw, opacity, borders,
-          cw->attrs.width - invisible_width + cw->attrs.border_width * 2,
-          cw->attrs.height - invisible_height + cw->attrs.border_width * 2,
-          &cw->shadow_width, &cw->shadow_height);
-    }
+    /* The size is known up front, the shadow itself is only rendered
+       once the window is visible, see ensure_shadow () */
+    cw->shadow_width = width + msize;
+    cw->shadow_height = height + msize;
 
     sr.x = cw->attrs.x + cw->shadow_dx;
     sr.y = cw->attrs.y + cw->shadow_dy;
@@ -1011,41 +1512,74 @@ static XserverRegion win_extents(MetaCompWindow *cw) {
     if (sr.y + sr.height > r.y + r.height) r.height = sr.y + sr.height - r.y;
   }
 
-  return XFixesCreateRegion(xdisplay, &r, 1);
+  return cairo_region_create_rectangle(&r);
 }
 
-static XserverRegion border_size(MetaCompWindow *cw) {
-  MetaScreen *screen = cw->screen;
-  MetaDisplay *display = meta_screen_get_display(screen);
+static cairo_region_t *get_shape_region(MetaDisplay *display,
+                                        Window xwindow) {
   Display *xdisplay = meta_display_get_xdisplay(display);
-  cairo_region_t *visible_region;
-  XserverRegion visible = None;
-  XserverRegion border;
+  cairo_region_t *region;
+  XRectangle *rects;
+  int n_rects, ordering, i;
 
-  if (cw->window) {
-    visible_region = meta_window_get_frame_bounds(cw->window);
+  meta_error_trap_push(display);
+  rects = XShapeGetRectangles(xdisplay, xwindow, ShapeBounding, &n_rects,
+                              &ordering);
+  meta_error_trap_pop(display, FALSE);
+
+  region = cairo_region_create();
 
-    if (visible_region != NULL)
-      visible = cairo_region_to_xserver_region(xdisplay, visible_region);
+  for (i = 0; rects != NULL && i < n_rects; i++) {
+    cairo_rectangle_int_t rect;
+
+    rect.x = rects[i].x;
+    rect.y = rects[i].y;
+    rect.width = rects[i].width;
+    rect.height = rects[i].height;
+
+    cairo_region_union_rectangle(region, &rect);
   }
 
-  meta_error_trap_push(display);
-  border = XFixesCreateRegionFromWindow(xdisplay, cw->id, WindowRegionBounding);
-  meta_error_trap_pop(display, FALSE);
+  if (rects) XFree(rects);
 
-  g_return_val_if_fail(border != None, None);
-  XFixesTranslateRegion(xdisplay, border, cw->attrs.x + cw->attrs.border_width,
-                        cw->attrs.y + cw->attrs.border_width);
+  return region;
+}
 
-  if (visible != None) {
-    XFixesTranslateRegion(xdisplay, visible,
-                          cw->attrs.x + cw->attrs.border_width,
-                          cw->attrs.y + cw->attrs.border_width);
+static cairo_region_t *border_size(MetaCompWindow *cw) {
+  MetaScreen *screen = cw->screen;
+  MetaDisplay *display = meta_screen_get_display(screen);
+  cairo_region_t *visible_region;
+  cairo_region_t *border;
+  int x = cw->attrs.x + cw->attrs.border_width;
+  int y = cw->attrs.y + cw->attrs.border_width;
 
-    XFixesIntersectRegion(xdisplay, visible, visible, border);
-    XFixesDestroyRegion(xdisplay, border);
+  /* The bounding shape only costs a round trip when it changes */
+  if (cw->shaped && cw->shape_region == NULL)
+    cw->shape_region = get_shape_region(display, cw->id);
 
-    return visible;
+  if (cw->shaped) {
+    border = cairo_region_copy(cw->shape_region);
+    cairo_region_translate(border, x, y);
+  } else {
+    cairo_rectangle_int_t r;
+
+    r.x = cw->attrs.x;
+    r.y = cw->attrs.y;
+    r.width = cw->attrs.width + cw->attrs.border_width * 2;
+    r.height = cw->attrs.height + cw->attrs.border_width * 2;
+    border = cairo_region_create_rectangle(&r);
+  }
+
+  if (cw->window) {
+    visible_region = meta_window_get_frame_bounds(cw->window);
+
+    if (visible_region != NULL) {
+      cairo_region_t *visible = cairo_region_copy(visible_region);
+
+      cairo_region_translate(visible, x, y);
+      cairo_region_intersect(border, visible);
+      cairo_region_destroy(visible);
+    }
   }
 
   return border;
@@ -1065,26 +1599,44 @@ static XRenderPictFormat *get_window_format(MetaCompWindow *cw) {
   return format;
 }
 
-static Picture get_window_picture(MetaCompWindow *cw) {
-  MetaScreen *screen = cw->screen;
-  MetaDisplay *display = meta_screen_get_display(screen);
+/* Names the storage Composite allocated for the window when it was
+   last mapped or resized. Painting reads the window directly, the
+   pixmap keeps the contents around for get_window_pixmap () once the
+   window is unmapped. */
+static void name_window_pixmap(MetaCompWindow *cw) {
+  MetaDisplay *display = meta_screen_get_display(cw->screen);
   Display *xdisplay = meta_display_get_xdisplay(display);
-  XRenderPictureAttributes pa;
-  XRenderPictFormat *format;
-  Drawable draw;
   int error_code;
 
-  draw = cw->id;
+  if (cw->back_pixmap != None || cw->attrs.map_state != IsViewable ||
+      cw->attrs.class == InputOnly)
+    return;
 
   meta_error_trap_push(display);
-
-  if (cw->back_pixmap == None)
-    cw->back_pixmap = XCompositeNameWindowPixmap(xdisplay, cw->id);
-
+  cw->back_pixmap = XCompositeNameWindowPixmap(xdisplay, cw->id);
   error_code = meta_error_trap_pop_with_return(display, FALSE);
+
   if (error_code != 0) cw->back_pixmap = None;
+}
+
+static Picture get_alpha_picture(MetaScreen *screen, guint opacity) {
+  MetaCompScreen *info = meta_screen_get_compositor_data(screen);
+  guint level = opacity >> 24;
+
+  if (info->alpha_pictures[level] == None)
+    info->alpha_pictures[level] =
+        solid_picture(meta_screen_get_display(screen), screen, FALSE,
+                      (double)level / (ALPHA_LEVELS - 1), 0, 0, 0);
 
-  if (cw->back_pixmap != None) draw = cw->back_pixmap;
+  return info->alpha_pictures[level];
+}
+
+static Picture get_window_picture(MetaCompWindow *cw) {
+  MetaScreen *screen = cw->screen;
+  MetaDisplay *display = meta_screen_get_display(screen);
+  Display *xdisplay = meta_display_get_xdisplay(display);
+  XRenderPictureAttributes pa;
+  XRenderPictFormat *format;
 
   format = get_window_format(cw);
   if (format) {
@@ -1093,7 +1645,7 @@ static Picture get_window_picture(MetaCompWindow *cw) {
     pa.subwindow_mode = IncludeInferiors;
 
     meta_error_trap_push(display);
-    pict = XRenderCreatePicture(xdisplay, draw, format, CPSubwindowMode, &pa);
+    pict = XRenderCreatePicture(xdisplay, cw->id, format, CPSubwindowMode, &pa);
     meta_error_trap_pop(display, FALSE);
 
     return pict;
@@ -1102,8 +1654,71 @@ static Picture get_window_picture(MetaCompWindow *cw) {
   return None;
 }
 
+static void composite_shadow_slice(Display *xdisplay, Picture black,
+                                   Picture mask, Picture root_buffer,
+                                   int mask_x, int mask_y, int x, int y,
+                                   int width, int height) {
+  if (width <= 0 || height <= 0) return;
+
+  XRenderComposite(xdisplay, PictOpOver, black, mask, root_buffer, 0, 0,
+                   mask_x, mask_y, x, y, width, height);
+}
+
+/* The caller has to have set the clip on root_buffer */
+static void paint_shadow(MetaScreen *screen, MetaCompWindow *cw,
+                         Picture root_buffer) {
+  MetaDisplay *display = meta_screen_get_display(screen);
+  Display *xdisplay = meta_display_get_xdisplay(display);
+  MetaCompScreen *info = meta_screen_get_compositor_data(screen);
+  MetaShadowSlices *slices = cw->shadow_slices;
+  Picture black;
+  int x, y, m, mid_width, mid_height;
+
+  if (info == NULL) return;
+
+  black = info->black_picture;
+  x = cw->attrs.x + cw->shadow_dx;
+  y = cw->attrs.y + cw->shadow_dy;
+
+  if (cw->shadow) {
+    XRenderComposite(xdisplay, PictOpOver, black, cw->shadow, root_buffer, 0,
+                     0, 0, 0, x, y, cw->shadow_width, cw->shadow_height);
+    return;
+  }
+
+  if (slices == NULL) return;
+
+  m = slices->msize;
+  mid_width = cw->shadow_width - 2 * m;
+  mid_height = cw->shadow_height - 2 * m;
+
+  /* corners */
+  composite_shadow_slice(xdisplay, black, slices->corners, root_buffer, 0, 0,
+                         x, y, m, m);
+  composite_shadow_slice(xdisplay, black, slices->corners, root_buffer, m + 1,
+                         0, x + m + mid_width, y, m, m);
+  composite_shadow_slice(xdisplay, black, slices->corners, root_buffer, 0,
+                         m + 1, x, y + m + mid_height, m, m);
+  composite_shadow_slice(xdisplay, black, slices->corners, root_buffer, m + 1,
+                         m + 1, x + m + mid_width, y + m + mid_height, m, m);
+
+  /* edges */
+  composite_shadow_slice(xdisplay, black, slices->top, root_buffer, 0, 0,
+                         x + m, y, mid_width, m);
+  composite_shadow_slice(xdisplay, black, slices->bottom, root_buffer, 0, 0,
+                         x + m, y + m + mid_height, mid_width, m);
+  composite_shadow_slice(xdisplay, black, slices->left, root_buffer, 0, 0, x,
+                         y + m, m, mid_height);
+  composite_shadow_slice(xdisplay, black, slices->right, root_buffer, 0, 0,
+                         x + m + mid_width, y + m, m, mid_height);
+
+  /* centre */
+  composite_shadow_slice(xdisplay, black, slices->centre, root_buffer, 0, 0,
+                         x + m, y + m, mid_width, mid_height);
+}
+
 static void paint_dock_shadows(MetaScreen *screen, Picture root_buffer,
-                               XserverRegion region) {
+                               cairo_region_t *region) {
   MetaDisplay *display = meta_screen_get_display(screen);
   Display *xdisplay = meta_display_get_xdisplay(display);
   MetaCompScreen *info = meta_screen_get_compositor_data(screen);
@@ -1115,19 +1730,16 @@ static void paint_dock_shadows(MetaScreen *screen, Picture root_buffer,
 
   for (d = info->dock_windows; d; d = d->next) {
     MetaCompWindow *cw = d->data;
-    XserverRegion shadow_clip;
+    cairo_region_t *shadow_clip;
 
-    if (cw->shadow) {
-      shadow_clip = XFixesCreateRegion(xdisplay, NULL, 0);
-      XFixesIntersectRegion(xdisplay, shadow_clip, cw->border_clip, region);
+    if ((cw->shadow || cw->shadow_slices) && cw->border_clip) {
+      shadow_clip = cairo_region_copy(cw->border_clip);
+      cairo_region_intersect(shadow_clip, region);
 
-      XFixesSetPictureClipRegion(xdisplay, root_buffer, 0, 0, shadow_clip);
+      set_picture_clip_region(xdisplay, root_buffer, shadow_clip);
 
-      XRenderComposite(xdisplay, PictOpOver, info->black_picture, cw->shadow,
-                       root_buffer, 0, 0, 0, 0, cw->attrs.x + cw->shadow_dx,
-                       cw->attrs.y + cw->shadow_dy, cw->shadow_width,
-                       cw->shadow_height);
-      XFixesDestroyRegion(xdisplay, shadow_clip);
+      paint_shadow(screen, cw, root_buffer);
+      cairo_region_destroy(shadow_clip);
     }
   }
 }
@@ -1171,16 +1783,39 @@ static gboolean present_flip(MetaScreen *screen, XserverRegion region,
 }
 #endif /* HAVE_PRESENT */
 
+static MetaCompVisibility classify_window(MetaCompWindow *cw,
+                                          cairo_region_t *paint_region) {
+  cairo_rectangle_int_t extents;
+
+  /* The extents include the shadow */
+  cairo_region_get_extents(cw->extents, &extents);
+
+  switch (cairo_region_contains_rectangle(paint_region, &extents)) {
+    case CAIRO_REGION_OVERLAP_IN:
+      return META_COMP_VISIBILITY_FULL;
+    case CAIRO_REGION_OVERLAP_PART:
+      return META_COMP_VISIBILITY_PARTIAL;
+    case CAIRO_REGION_OVERLAP_OUT:
+    default:
+      return META_COMP_VISIBILITY_OCCLUDED;
+  }
+}
+
 static void paint_windows(MetaScreen *screen, GList *windows,
                           Picture root_buffer, Pixmap root_pixmap,
-                          XserverRegion region) {
+                          cairo_region_t *region) {
   MetaDisplay *display = meta_screen_get_display(screen);
   MetaCompScreen *info = meta_screen_get_compositor_data(screen);
   Display *xdisplay = meta_display_get_xdisplay(display);
   GList *index, *last;
   int screen_width, screen_height;
+  MetaCompositorXRender *compositor = DISPLAY_COMPOSITOR(display);
   MetaCompWindow *cw;
-  XserverRegion paint_region, desktop_region;
+  cairo_region_t *paint_region, *desktop_region;
+  guint painted = 0;
+#ifdef HAVE_PRESENT
+  gboolean flipped = TRUE;
+#endif
 
   if (info == NULL) {
     return;
@@ -1188,19 +1823,18 @@ static void paint_windows(MetaScreen *screen, GList *windows,
 
   meta_screen_get_size(screen, &screen_width, &screen_height);
 
-  if (region == None) {
-    XRectangle r;
+  if (region == NULL) {
+    cairo_rectangle_int_t r;
     r.x = 0;
     r.y = 0;
     r.width = screen_width;
     r.height = screen_height;
-    paint_region = XFixesCreateRegion(xdisplay, &r, 1);
+    paint_region = cairo_region_create_rectangle(&r);
   } else {
-    paint_region = XFixesCreateRegion(xdisplay, NULL, 0);
-    XFixesCopyRegion(xdisplay, paint_region, region);
+    paint_region = cairo_region_copy(region);
   }
 
-  desktop_region = None;
+  desktop_region = NULL;
 
   /*
    * Painting from top to bottom, reducing the clipping area at
@@ -1212,6 +1846,8 @@ static void paint_windows(MetaScreen *screen, GList *windows,
     last = index;
 
     cw = (MetaCompWindow *)index->data;
+    cw->visibility = META_COMP_VISIBILITY_OCCLUDED;
+
     if (!cw->damaged) {
       /* Not damaged */
       continue;
@@ -1229,28 +1865,35 @@ static void paint_windows(MetaScreen *screen, GList *windows,
         }
 #endif
 
-    if (cw->picture == None) cw->picture = get_window_picture(cw);
-
     /* If the clip region of the screen has been changed
        then we need to recreate the extents of the window */
     if (info->clip_changed) {
       if (cw->border_size) {
-        XFixesDestroyRegion(xdisplay, cw->border_size);
-        cw->border_size = None;
+        cairo_region_destroy(cw->border_size);
+        cw->border_size = NULL;
       }
 
 #if 0
           if (cw->extents)
             {
-              XFixesDestroyRegion (xdisplay, cw->extents);
-              cw->extents = None;
+              cairo_region_destroy (cw->extents);
+              cw->extents = NULL;
             }
 #endif
     }
 
-    if (cw->border_size == None) cw->border_size = border_size(cw);
+    if (cw->extents == NULL) cw->extents = win_extents(cw);
+
+    /* Nothing below needs to happen for a window that is covered by
+       opaque windows above it or lies outside the damage */
+    cw->visibility = classify_window(cw, paint_region);
+    if (cw->visibility == META_COMP_VISIBILITY_OCCLUDED) continue;
+
+    if (cw->border_size == NULL) cw->border_size = border_size(cw);
 
-    if (cw->extents == None) cw->extents = win_extents(cw);
+    if (cw->picture == None) cw->picture = get_window_picture(cw);
+
+    ensure_shadow(cw);
 
     if (cw->mode == WINDOW_SOLID) {
       int x, y, wid, hei;
@@ -1260,36 +1903,35 @@ static void paint_windows(MetaScreen *screen, GList *windows,
       wid = cw->attrs.width + cw->attrs.border_width * 2;
       hei = cw->attrs.height + cw->attrs.border_width * 2;
 
-      XFixesSetPictureClipRegion(xdisplay, root_buffer, 0, 0, paint_region);
+      /* Nothing above covers a fully visible window, so its own shape
+         is a tighter clip than what is left of the damage */
+      set_picture_clip_region(
+          xdisplay, root_buffer,
+          cw->visibility == META_COMP_VISIBILITY_FULL ? cw->border_size
+                                                      : paint_region);
       XRenderComposite(xdisplay, PictOpSrc, cw->picture, None, root_buffer, 0,
                        0, 0, 0, x, y, wid, hei);
+      painted++;
 
       if (cw->type == META_COMP_WINDOW_DESKTOP) {
-        if (desktop_region) {
-          XFixesUnionRegion(xdisplay, desktop_region, desktop_region,
-                            paint_region);
-        } else {
-          desktop_region = XFixesCreateRegion(xdisplay, 0, 0);
-          XFixesCopyRegion(xdisplay, desktop_region, paint_region);
-        }
+        if (desktop_region)
+          cairo_region_union(desktop_region, paint_region);
+        else
+          desktop_region = cairo_region_copy(paint_region);
       }
 
-      XFixesSubtractRegion(xdisplay, paint_region, paint_region,
-                           cw->border_size);
+      cairo_region_subtract(paint_region, cw->border_size);
     }
 
-    if (!cw->border_clip) {
-      cw->border_clip = XFixesCreateRegion(xdisplay, 0, 0);
-      XFixesCopyRegion(xdisplay, cw->border_clip, paint_region);
-    }
+    if (!cw->border_clip) cw->border_clip = cairo_region_copy(paint_region);
   }
 
-  XFixesSetPictureClipRegion(xdisplay, root_buffer, 0, 0, paint_region);
+  set_picture_clip_region(xdisplay, root_buffer, paint_region);
   paint_root(screen, root_buffer);
 
   paint_dock_shadows(screen, root_buffer,
-                     desktop_region == None ? paint_region : desktop_region);
-  if (desktop_region != None) XFixesDestroyRegion(xdisplay, desktop_region);
+                     desktop_region == NULL ? paint_region : desktop_region);
+  if (desktop_region != NULL) cairo_region_destroy(desktop_region);
 
   /*
    * Painting from bottom to top, translucent windows and shadows are painted
@@ -1297,132 +1939,375 @@ static void paint_windows(MetaScreen *screen, GList *windows,
   for (index = last; index; index = index->prev) {
     cw = (MetaCompWindow *)index->data;
 
-    if (cw->picture) {
-      if (cw->shadow && cw->type != META_COMP_WINDOW_DOCK) {
-        XserverRegion shadow_clip;
+    /* Only windows that got a clip in the first pass are visible */
+    if (cw->picture && cw->border_clip) {
+      Picture alpha = None;
 
-        shadow_clip = XFixesCreateRegion(xdisplay, NULL, 0);
-        XFixesSubtractRegion(xdisplay, shadow_clip, cw->border_clip,
-                             cw->border_size);
-        XFixesSetPictureClipRegion(xdisplay, root_buffer, 0, 0, shadow_clip);
+      if ((cw->shadow || cw->shadow_slices) &&
+          cw->type != META_COMP_WINDOW_DOCK) {
+        cairo_region_t *shadow_clip;
 
-        XRenderComposite(xdisplay, PictOpOver, info->black_picture, cw->shadow,
-                         root_buffer, 0, 0, 0, 0, cw->attrs.x + cw->shadow_dx,
-                         cw->attrs.y + cw->shadow_dy, cw->shadow_width,
-                         cw->shadow_height);
-        if (shadow_clip) XFixesDestroyRegion(xdisplay, shadow_clip);
-      }
+        /* Leaving out border_size also keeps sliced shadows, which are
+           not clipped to the frame bounds themselves, from darkening
+           translucent parts of the frame */
+        shadow_clip = cairo_region_copy(cw->border_clip);
+        cairo_region_subtract(shadow_clip, cw->border_size);
+        set_picture_clip_region(xdisplay, root_buffer, shadow_clip);
 
-      if ((cw->opacity != (guint)OPAQUE) && !(cw->alpha_pict)) {
-        cw->alpha_pict = solid_picture(display, screen, FALSE,
-                                       (double)cw->opacity / OPAQUE, 0, 0, 0);
+        paint_shadow(screen, cw, root_buffer);
+        cairo_region_destroy(shadow_clip);
       }
 
-      XFixesIntersectRegion(xdisplay, cw->border_clip, cw->border_clip,
-                            cw->border_size);
-      XFixesSetPictureClipRegion(xdisplay, root_buffer, 0, 0, cw->border_clip);
+      if (cw->opacity != (guint)OPAQUE)
+        alpha = get_alpha_picture(screen, cw->opacity);
+
+      cairo_region_intersect(cw->border_clip, cw->border_size);
+      set_picture_clip_region(xdisplay, root_buffer, cw->border_clip);
       if (cw->mode == WINDOW_ARGB) {
         int x, y, wid, hei;
 
-        x = cw->attrs.x;
-        y = cw->attrs.y;
-        wid = cw->attrs.width + cw->attrs.border_width * 2;
-        hei = cw->attrs.height + cw->attrs.border_width * 2;
+        x = cw->attrs.x;
+        y = cw->attrs.y;
+        wid = cw->attrs.width + cw->attrs.border_width * 2;
+        hei = cw->attrs.height + cw->attrs.border_width * 2;
+
+        XRenderComposite(xdisplay, PictOpOver, cw->picture, alpha, root_buffer,
+                         0, 0, 0, 0, x, y, wid, hei);
+        painted++;
+      }
+    }
+
+    if (cw->border_clip) {
+      cairo_region_destroy(cw->border_clip);
+      cw->border_clip = NULL;
+    }
+  }
+
+  set_picture_clip_region(xdisplay, root_buffer, region);
+
+#ifdef HAVE_PRESENT
+  if (info->use_present) {
+    /* Present is the only consumer that still needs a server region */
+    XserverRegion update = None;
+
+    if (region) {
+      update = cairo_region_to_xserver_region(xdisplay, region);
+      compositor->xfixes_requests += 2; /* created and destroyed */
+    }
+
+    if (present_flip(screen, update, root_pixmap))
+      info->present_pending++;
+    else
+      flipped = FALSE;
+
+    if (update) XFixesDestroyRegion(xdisplay, update);
+  }
+
+  if (!info->use_present || !flipped)
+#endif /* HAVE_PRESENT */
+  {
+    XRenderComposite(xdisplay, PictOpSrc, root_buffer, None, info->root_picture,
+                     0, 0, 0, 0, 0, 0, screen_width, screen_height);
+  }
+
+  XFlush(xdisplay);
+  cairo_region_destroy(paint_region);
+
+  compositor->last_windows_painted = painted;
+  compositor->windows_painted += painted;
+}
+
+static void record_frame(MetaCompositorXRender *compositor,
+                         gint64 paint_start) {
+  gint64 now = g_get_monotonic_time();
+
+  compositor->frame_count++;
+  compositor->last_paint_time = now - paint_start;
+  compositor->paint_time += compositor->last_paint_time;
+  compositor->last_frame_latency =
+      compositor->damage_time ? now - compositor->damage_time : 0;
+  compositor->damage_time = 0;
+  compositor->last_frame_time = paint_start;
+
+  if (compositor->debug)
+    fprintf(stderr,
+            "frame %" G_GUINT64_FORMAT ": paint %" G_GINT64_FORMAT
+            " us, latency %" G_GINT64_FORMAT " us, refresh %" G_GINT64_FORMAT
+            " us\n",
+            compositor->frame_count, compositor->last_paint_time,
+            compositor->last_frame_latency, compositor->refresh_interval);
+}
+
+static void record_damage_area(MetaCompositorXRender *compositor,
+                               MetaScreen *screen, cairo_region_t *region) {
+  guint64 area = 0;
+
+  if (region == NULL) {
+    int width, height;
+
+    meta_screen_get_size(screen, &width, &height);
+    area = (guint64)width * height;
+  } else {
+    int i, n_rects = cairo_region_num_rectangles(region);
+
+    for (i = 0; i < n_rects; i++) {
+      cairo_rectangle_int_t rect;
+
+      cairo_region_get_rectangle(region, i, &rect);
+      area += (guint64)rect.width * rect.height;
+    }
+  }
+
+  compositor->last_damage_area = area;
+  compositor->damage_area += area;
+}
+
+static void paint_all(MetaScreen *screen, cairo_region_t *region, int b) {
+  MetaCompScreen *info = meta_screen_get_compositor_data(screen);
+  MetaDisplay *display = meta_screen_get_display(screen);
+  Display *xdisplay = meta_display_get_xdisplay(display);
+  int screen_width, screen_height;
+  gint64 paint_start;
+
+  meta_screen_get_size(screen, &screen_width, &screen_height);
+
+  if (DISPLAY_COMPOSITOR(display)->show_redraw) {
+    Picture overlay;
+
+    dump_region("paint_all", display, region);
+
+    /* Make a random colour overlay */
+    overlay = solid_picture(display, screen, TRUE, 1, /* 0.3, alpha */
+                            ((double)(rand() % 100)) / 100.0,
+                            ((double)(rand() % 100)) / 100.0,
+                            ((double)(rand() % 100)) / 100.0);
+
+    /* Set clipping to the given region */
+    set_picture_clip_region(xdisplay, info->root_picture, region);
+
+    XRenderComposite(xdisplay, PictOpOver, overlay, None, info->root_picture, 0,
+                     0, 0, 0, 0, 0, screen_width, screen_height);
+    XRenderFreePicture(xdisplay, overlay);
+    XFlush(xdisplay);
+    usleep(100 * 1000);
+  }
+
+  if (info->root_pixmaps[b] == None)
+    info->root_pixmaps[b] = create_root_pixmap(screen);
+
+  if (info->root_buffers[b] == None)
+    info->root_buffers[b] = create_root_buffer(screen, info->root_pixmaps[b]);
+
+  record_damage_area(DISPLAY_COMPOSITOR(display), screen, region);
+
+  paint_start = g_get_monotonic_time();
+  paint_windows(screen, info->windows, info->root_buffers[b],
+                info->root_pixmaps[b], region);
+  record_frame(DISPLAY_COMPOSITOR(display), paint_start);
+}
+
+static void show_overlay_window(MetaScreen *screen, Window cow);
+static void hide_overlay_window(MetaScreen *screen, Window cow);
+
+/* An opaque, unshaped window that covers the whole screen */
+static gboolean window_is_fullscreen_opaque(MetaCompWindow *cw) {
+  int screen_width, screen_height;
+  int width, height;
+
+  if (cw->mode != WINDOW_SOLID || cw->shaped) return FALSE;
+
+  meta_screen_get_size(cw->screen, &screen_width, &screen_height);
+  width = cw->attrs.width + cw->attrs.border_width * 2;
+  height = cw->attrs.height + cw->attrs.border_width * 2;
+
+  return (cw->attrs.x <= 0 && cw->attrs.y <= 0 &&
+          cw->attrs.x + width >= screen_width &&
+          cw->attrs.y + height >= screen_height);
+}
+
+static MetaCompWindow *find_unredirect_candidate(MetaScreen *screen) {
+  MetaCompScreen *info = meta_screen_get_compositor_data(screen);
+  GList *index;
+
+  if (info == NULL || !meta_prefs_get_compositing_unredirect_fullscreen())
+    return NULL;
+
+  for (index = info->windows; index; index = index->next) {
+    MetaCompWindow *cw = (MetaCompWindow *)index->data;
+
+    if (cw->attrs.map_state != IsViewable || cw->attrs.class == InputOnly)
+      continue;
+
+    /* Only the top-most visible window may bypass the compositor,
+       anything overlapping it has to be composited on top */
+    return window_is_fullscreen_opaque(cw) ? cw : NULL;
+  }
+
+  return NULL;
+}
+
+static void redirect_win(MetaCompWindow *cw) {
+  MetaDisplay *display = meta_screen_get_display(cw->screen);
+  Display *xdisplay = meta_display_get_xdisplay(display);
+
+  meta_error_trap_push(display);
+  XCompositeRedirectWindow(xdisplay, cw->id, CompositeRedirectManual);
+  meta_error_trap_pop(display, FALSE);
+
+  /* The pixmap named while the window was unredirected no longer
+     receives its contents */
+  if (cw->back_pixmap) {
+    XFreePixmap(xdisplay, cw->back_pixmap);
+    cw->back_pixmap = None;
+  }
+
+  name_window_pixmap(cw);
+}
+
+static void set_unredirected_window(MetaScreen *screen, MetaCompWindow *cw) {
+  MetaDisplay *display = meta_screen_get_display(screen);
+  Display *xdisplay = meta_display_get_xdisplay(display);
+  MetaCompScreen *info = meta_screen_get_compositor_data(screen);
+  MetaCompWindow *old;
+
+  if (info == NULL || info->unredirected_window == cw) return;
+
+  old = info->unredirected_window;
+  info->unredirected_window = NULL;
+
+  if (old != NULL) redirect_win(old);
+
+  if (cw != NULL) {
+    if (DISPLAY_COMPOSITOR(display)->debug)
+      fprintf(stderr, "Unredirecting fullscreen window 0x%lx\n", cw->id);
 
-        XRenderComposite(xdisplay, PictOpOver, cw->picture, cw->alpha_pict,
-                         root_buffer, 0, 0, 0, 0, x, y, wid, hei);
-      }
-    }
+    meta_error_trap_push(display);
+    XCompositeUnredirectWindow(xdisplay, cw->id, CompositeRedirectManual);
+    meta_error_trap_pop(display, FALSE);
 
-    if (cw->border_clip) {
-      XFixesDestroyRegion(xdisplay, cw->border_clip);
-      cw->border_clip = None;
-    }
+    info->unredirected_window = cw;
+
+    /* The overlay window sits above everything, so it has to go away for
+       the X server to show the unredirected window */
+    if (old == NULL) hide_overlay_window(screen, info->output);
+  } else {
+    /* Damages the whole screen so that the next paint is complete */
+    show_overlay_window(screen, info->output);
   }
 
-  XFixesSetPictureClipRegion(xdisplay, root_buffer, 0, 0, region);
+  info->clip_changed = TRUE;
+}
 
 #ifdef HAVE_PRESENT
-  if (info->use_present)
-    info->present_pending = present_flip(screen, region, root_pixmap);
+/* Returns what has to be painted into buffer b to bring it up to date,
+   or NULL if the whole screen has to be painted */
+static cairo_region_t *get_buffer_damage(MetaCompScreen *info, int b) {
+  cairo_region_t *damage;
+  guint64 missed;
+  guint64 i;
+
+  if (info->root_buffers[b] == None || info->root_painted[b] == 0)
+    return NULL;
 
-  if (!info->use_present || !info->present_pending)
-#endif /* HAVE_PRESENT */
-  {
-    XRenderComposite(xdisplay, PictOpSrc, root_buffer, None, info->root_picture,
-                     0, 0, 0, 0, 0, 0, screen_width, screen_height);
-  }
+  missed = info->frame_serial - info->root_painted[b];
+  if (missed > G_N_ELEMENTS(info->damage_ring)) return NULL;
 
-  XFlush(xdisplay);
-  XFixesDestroyRegion(xdisplay, paint_region);
-}
+  damage = cairo_region_copy(info->all_damage);
+  for (i = 0; i < missed; i++) {
+    if (info->damage_ring[i] == NULL) {
+      cairo_region_destroy(damage);
+      return NULL;
+    }
 
-static void paint_all(MetaScreen *screen, XserverRegion region, int b) {
-  MetaCompScreen *info = meta_screen_get_compositor_data(screen);
-  MetaDisplay *display = meta_screen_get_display(screen);
-  Display *xdisplay = meta_display_get_xdisplay(display);
-  int screen_width, screen_height;
+    cairo_region_union(damage, info->damage_ring[i]);
+  }
 
-  meta_screen_get_size(screen, &screen_width, &screen_height);
+  return damage;
+}
 
-  if (DISPLAY_COMPOSITOR(display)->show_redraw) {
-    Picture overlay;
+/* Takes ownership of damage */
+static void push_frame_damage(MetaCompScreen *info, cairo_region_t *damage) {
+  int last = G_N_ELEMENTS(info->damage_ring) - 1;
 
-    dump_xserver_region("paint_all", display, region);
+  if (info->damage_ring[last]) cairo_region_destroy(info->damage_ring[last]);
 
-    /* Make a random colour overlay */
-    overlay = solid_picture(display, screen, TRUE, 1, /* 0.3, alpha */
-                            ((double)(rand() % 100)) / 100.0,
-                            ((double)(rand() % 100)) / 100.0,
-                            ((double)(rand() % 100)) / 100.0);
+  memmove(&info->damage_ring[1], &info->damage_ring[0],
+          last * sizeof(info->damage_ring[0]));
+  info->damage_ring[0] = damage;
+  info->frame_serial++;
+}
 
-    /* Set clipping to the given region */
-    XFixesSetPictureClipRegion(xdisplay, info->root_picture, 0, 0, region);
+static void free_damage_ring(MetaCompScreen *info) {
+  guint i;
 
-    XRenderComposite(xdisplay, PictOpOver, overlay, None, info->root_picture, 0,
-                     0, 0, 0, 0, 0, screen_width, screen_height);
-    XRenderFreePicture(xdisplay, overlay);
-    XFlush(xdisplay);
-    usleep(100 * 1000);
+  for (i = 0; i < G_N_ELEMENTS(info->damage_ring); i++) {
+    if (info->damage_ring[i]) {
+      cairo_region_destroy(info->damage_ring[i]);
+      info->damage_ring[i] = NULL;
+    }
   }
+}
+#endif /* HAVE_PRESENT */
 
-  if (info->root_pixmaps[b] == None)
-    info->root_pixmaps[b] = create_root_pixmap(screen);
-
-  if (info->root_buffers[b] == None)
-    info->root_buffers[b] = create_root_buffer(screen, info->root_pixmaps[b]);
+static void free_root_buffers(MetaScreen *screen) {
+  MetaCompScreen *info = meta_screen_get_compositor_data(screen);
+  Display *xdisplay =
+      meta_display_get_xdisplay(meta_screen_get_display(screen));
+  int b;
 
-  paint_windows(screen, info->windows, info->root_buffers[b],
-                info->root_pixmaps[b], region);
+  for (b = 0; b < MAX_NUM_BUFFER; b++) {
+    if (info->root_buffers[b]) {
+      XRenderFreePicture(xdisplay, info->root_buffers[b]);
+      XFreePixmap(xdisplay, info->root_pixmaps[b]);
+      info->root_buffers[b] = None;
+      info->root_pixmaps[b] = None;
+    }
+#ifdef HAVE_PRESENT
+    info->root_painted[b] = 0;
+#endif
+  }
 }
 
 static void repair_screen(MetaScreen *screen) {
   MetaCompScreen *info = meta_screen_get_compositor_data(screen);
   MetaDisplay *display = meta_screen_get_display(screen);
-  Display *xdisplay = meta_display_get_xdisplay(display);
 
   g_return_if_fail(info != NULL);
 
-  if (info->all_damage != None) {
+  set_unredirected_window(screen, find_unredirect_candidate(screen));
+
+  if (info->unredirected_window != NULL) {
+    /* Nothing of ours is visible, drop the damage instead of painting it */
+    if (info->all_damage != NULL) {
+      cairo_region_destroy(info->all_damage);
+      info->all_damage = NULL;
+    }
+    DISPLAY_COMPOSITOR(display)->damage_time = 0;
+
+    return;
+  }
+
+  if (info->all_damage != NULL) {
 #ifdef HAVE_PRESENT
     if (info->use_present) {
-      if (!info->present_pending) {
-        XserverRegion damage = info->all_damage;
+      /* One buffer is on screen, the others may be painted as long as
+         they are not waiting to be flipped */
+      if (info->present_pending < info->num_buffers - 1) {
+        int b = info->root_current;
+        cairo_region_t *damage;
+
         meta_error_trap_push(display);
-        if (info->prev_damage) {
-          XFixesUnionRegion(xdisplay, info->prev_damage, info->prev_damage,
-                            damage);
-          damage = info->prev_damage;
-        }
+        damage = get_buffer_damage(info, b);
 
-        paint_all(screen, damage, info->root_current);
+        paint_all(screen, damage, b);
 
-        if (++info->root_current >= NUM_BUFFER) info->root_current = 0;
+        if (damage) cairo_region_destroy(damage);
+        push_frame_damage(info, info->all_damage);
+        info->root_painted[b] = info->frame_serial;
 
-        if (info->prev_damage) XFixesDestroyRegion(xdisplay, info->prev_damage);
+        if (++info->root_current >= info->num_buffers) info->root_current = 0;
 
-        info->prev_damage = info->all_damage;
-        info->all_damage = None;
+        info->all_damage = NULL;
         info->clip_changed = FALSE;
         meta_error_trap_pop(display, FALSE);
       }
@@ -1431,8 +2316,8 @@ static void repair_screen(MetaScreen *screen) {
     {
       meta_error_trap_push(display);
       paint_all(screen, info->all_damage, info->root_current);
-      XFixesDestroyRegion(xdisplay, info->all_damage);
-      info->all_damage = None;
+      cairo_region_destroy(info->all_damage);
+      info->all_damage = NULL;
       info->clip_changed = FALSE;
       meta_error_trap_pop(display, FALSE);
     }
@@ -1464,36 +2349,74 @@ static gboolean compositor_idle_cb(gpointer data) {
   return FALSE;
 }
 
+static gint64 get_frame_interval(MetaCompositorXRender *compositor) {
+  int max_frame_rate;
+
+  /* Pace to the display when Present tells us how fast it refreshes */
+  if (compositor->has_present && compositor->refresh_interval > 0)
+    return compositor->refresh_interval;
+
+  /* Otherwise fall back to a timer, if the user asked for one */
+  max_frame_rate = meta_prefs_get_compositing_max_frame_rate();
+  if (max_frame_rate <= 0) return 0;
+
+  return G_USEC_PER_SEC / max_frame_rate;
+}
+
+/* Dispatches at its ready time, to the microsecond */
+static gboolean frame_source_dispatch(GSource *source, GSourceFunc callback,
+                                      gpointer user_data) {
+  return callback(user_data);
+}
+
+static GSourceFuncs frame_source_funcs = {NULL, NULL, frame_source_dispatch,
+                                          NULL};
+
 static void add_repair(MetaDisplay *display) {
   MetaCompositorXRender *compositor = DISPLAY_COMPOSITOR(display);
+  GSource *source;
+  gint64 now, interval, next_frame;
 
   if (compositor->repaint_id > 0) return;
 
-#if 1
-  compositor->repaint_id = g_idle_add_full(
-      G_PRIORITY_HIGH_IDLE, compositor_idle_cb, compositor, NULL);
-#else
-  /* Limit it to 50fps */
-  compositor->repaint_id = g_timeout_add_full(
-      G_PRIORITY_HIGH, 20, compositor_idle_cb, compositor, NULL);
-#endif
+  /* Damage arriving before the next frame is due is collected and
+     painted in one go instead of repainting for every event. Frames
+     start a whole number of intervals after the last one started, so
+     that the time spent painting doesn't lower the frame rate. */
+  now = g_get_monotonic_time();
+  interval = get_frame_interval(compositor);
+  next_frame = compositor->last_frame_time + interval;
+  if (interval > 0 && next_frame < now)
+    next_frame += (now - next_frame + interval - 1) / interval * interval;
+
+  source = g_source_new(&frame_source_funcs, sizeof(GSource));
+  g_source_set_priority(source, G_PRIORITY_HIGH_IDLE);
+  g_source_set_ready_time(source, next_frame);
+  g_source_set_callback(source, compositor_idle_cb, compositor, NULL);
+  compositor->repaint_id = g_source_attach(source, NULL);
+  g_source_unref(source);
 }
 #endif
 
-static void add_damage(MetaScreen *screen, XserverRegion damage) {
+/* Takes ownership of damage */
+static void add_damage(MetaScreen *screen, cairo_region_t *damage) {
   MetaDisplay *display = meta_screen_get_display(screen);
-  Display *xdisplay = meta_display_get_xdisplay(display);
   MetaCompScreen *info = meta_screen_get_compositor_data(screen);
 
-  /*  dump_xserver_region ("add_damage", display, damage); */
+  /*  dump_region ("add_damage", display, damage); */
+
+  if (DISPLAY_COMPOSITOR(display)->damage_time == 0)
+    DISPLAY_COMPOSITOR(display)->damage_time = g_get_monotonic_time();
 
   if (info != NULL) {
     if (info->all_damage) {
-      XFixesUnionRegion(xdisplay, info->all_damage, info->all_damage, damage);
-      XFixesDestroyRegion(xdisplay, damage);
+      cairo_region_union(info->all_damage, damage);
+      cairo_region_destroy(damage);
     } else {
       info->all_damage = damage;
     }
+  } else {
+    cairo_region_destroy(damage);
   }
 
 #ifdef USE_IDLE_REPAINT
@@ -1503,10 +2426,9 @@ static void add_damage(MetaScreen *screen, XserverRegion damage) {
 
 static void damage_screen(MetaScreen *screen) {
   MetaDisplay *display = meta_screen_get_display(screen);
-  Display *xdisplay = meta_display_get_xdisplay(display);
-  XserverRegion region;
+  cairo_region_t *region;
   int width, height;
-  XRectangle r;
+  cairo_rectangle_int_t r;
 
   r.x = 0;
   r.y = 0;
@@ -1514,33 +2436,40 @@ static void damage_screen(MetaScreen *screen) {
   r.width = width;
   r.height = height;
 
-  region = XFixesCreateRegion(xdisplay, &r, 1);
-  dump_xserver_region("damage_screen", display, region);
+  region = cairo_region_create_rectangle(&r);
+  dump_region("damage_screen", display, region);
   add_damage(screen, region);
 }
 
-static void repair_win(MetaCompWindow *cw) {
+/* area is the damaged bounding box reported by the DamageNotify event,
+   relative to the window */
+static void repair_win(MetaCompWindow *cw, XRectangle *area) {
   MetaScreen *screen = cw->screen;
   MetaDisplay *display = meta_screen_get_display(screen);
   Display *xdisplay = meta_display_get_xdisplay(display);
-  XserverRegion parts;
+  cairo_region_t *parts;
 
   meta_error_trap_push(display);
+  XDamageSubtract(xdisplay, cw->damage, None, None);
+  meta_error_trap_pop(display, FALSE);
+
   if (!cw->damaged) {
     parts = win_extents(cw);
-    XDamageSubtract(xdisplay, cw->damage, None, None);
   } else {
-    parts = XFixesCreateRegion(xdisplay, 0, 0);
-    XDamageSubtract(xdisplay, cw->damage, None, parts);
-    XFixesTranslateRegion(xdisplay, parts, cw->attrs.x + cw->attrs.border_width,
-                          cw->attrs.y + cw->attrs.border_width);
-  }
+    cairo_rectangle_int_t r;
 
-  meta_error_trap_pop(display, FALSE);
+    r.x = area->x + cw->attrs.x + cw->attrs.border_width;
+    r.y = area->y + cw->attrs.y + cw->attrs.border_width;
+    r.width = area->width;
+    r.height = area->height;
+    parts = cairo_region_create_rectangle(&r);
+  }
 
-  dump_xserver_region("repair_win", display, parts);
+  dump_region("repair_win", display, parts);
   add_damage(screen, parts);
   cw->damaged = TRUE;
+
+  if (cw->thumbnail) cw->thumbnail_dirty = TRUE;
 }
 
 static void free_win(MetaCompWindow *cw, gboolean destroy) {
@@ -1559,20 +2488,12 @@ static void free_win(MetaCompWindow *cw, gboolean destroy) {
     cw->shaded_back_pixmap = None;
   }
 
-  if (cw->picture) {
+  if (cw->picture && destroy) {
     XRenderFreePicture(xdisplay, cw->picture);
     cw->picture = None;
   }
 
-  if (cw->shadow) {
-    XRenderFreePicture(xdisplay, cw->shadow);
-    cw->shadow = None;
-  }
-
-  if (cw->alpha_pict) {
-    XRenderFreePicture(xdisplay, cw->alpha_pict);
-    cw->alpha_pict = None;
-  }
+  release_shadow(cw);
 
   if (cw->shadow_pict) {
     XRenderFreePicture(xdisplay, cw->shadow_pict);
@@ -1580,21 +2501,31 @@ static void free_win(MetaCompWindow *cw, gboolean destroy) {
   }
 
   if (cw->border_size) {
-    XFixesDestroyRegion(xdisplay, cw->border_size);
-    cw->border_size = None;
+    cairo_region_destroy(cw->border_size);
+    cw->border_size = NULL;
   }
 
   if (cw->border_clip) {
-    XFixesDestroyRegion(xdisplay, cw->border_clip);
-    cw->border_clip = None;
+    cairo_region_destroy(cw->border_clip);
+    cw->border_clip = NULL;
   }
 
   if (cw->extents) {
-    XFixesDestroyRegion(xdisplay, cw->extents);
-    cw->extents = None;
+    cairo_region_destroy(cw->extents);
+    cw->extents = NULL;
   }
 
   if (destroy) {
+    if (cw->thumbnail) {
+      cairo_surface_destroy(cw->thumbnail);
+      cw->thumbnail = NULL;
+    }
+
+    if (cw->shape_region) {
+      cairo_region_destroy(cw->shape_region);
+      cw->shape_region = NULL;
+    }
+
     if (cw->damage != None) {
       meta_error_trap_push(display);
       XDamageDestroy(xdisplay, cw->damage);
@@ -1708,6 +2639,8 @@ static void map_win(MetaDisplay *display, MetaScreen *screen, Window id) {
 
   cw->attrs.map_state = IsViewable;
   cw->damaged = FALSE;
+
+  name_window_pixmap(cw);
 }
 
 static void unmap_win(MetaDisplay *display, MetaScreen *screen, Window id) {
@@ -1720,13 +2653,15 @@ static void unmap_win(MetaDisplay *display, MetaScreen *screen, Window id) {
 
   if (cw->window && cw->window == info->focus_window) info->focus_window = NULL;
 
+  if (cw == info->unredirected_window) set_unredirected_window(screen, NULL);
+
   cw->attrs.map_state = IsUnmapped;
   cw->damaged = FALSE;
 
-  if (cw->extents != None) {
-    dump_xserver_region("unmap_win", display, cw->extents);
+  if (cw->extents != NULL) {
+    dump_region("unmap_win", display, cw->extents);
     add_damage(screen, cw->extents);
-    cw->extents = None;
+    cw->extents = NULL;
   }
 
   free_win(cw, FALSE);
@@ -1738,11 +2673,6 @@ static void determine_mode(MetaDisplay *display, MetaScreen *screen,
   XRenderPictFormat *format;
   Display *xdisplay = meta_display_get_xdisplay(display);
 
-  if (cw->alpha_pict) {
-    XRenderFreePicture(xdisplay, cw->alpha_pict);
-    cw->alpha_pict = None;
-  }
-
   if (cw->shadow_pict) {
     XRenderFreePicture(xdisplay, cw->shadow_pict);
     cw->shadow_pict = None;
@@ -1760,11 +2690,10 @@ static void determine_mode(MetaDisplay *display, MetaScreen *screen,
     cw->mode = WINDOW_SOLID;
 
   if (cw->extents) {
-    XserverRegion damage;
-    damage = XFixesCreateRegion(xdisplay, NULL, 0);
-    XFixesCopyRegion(xdisplay, damage, cw->extents);
+    cairo_region_t *damage;
+    damage = cairo_region_copy(cw->extents);
 
-    dump_xserver_region("determine_mode", display, damage);
+    dump_region("determine_mode", display, damage);
     add_damage(screen, damage);
   }
 }
@@ -1880,13 +2809,15 @@ static void add_win(MetaScreen *screen, MetaWindow *window, Window xwindow) {
   if (cw->attrs.class == InputOnly)
     cw->damage = None;
   else
-    cw->damage = XDamageCreate(xdisplay, xwindow, XDamageReportNonEmpty);
+    cw->damage = XDamageCreate(xdisplay, xwindow, XDamageReportBoundingBox);
 
-  cw->alpha_pict = None;
   cw->shadow_pict = None;
-  cw->border_size = None;
-  cw->extents = None;
+  cw->border_size = NULL;
+  cw->extents = NULL;
+  cw->shape_region = NULL;
   cw->shadow = None;
+  cw->shadow_entry = NULL;
+  cw->shadow_slices = NULL;
   cw->shadow_dx = 0;
   cw->shadow_dy = 0;
   cw->shadow_width = 0;
@@ -1899,7 +2830,7 @@ static void add_win(MetaScreen *screen, MetaWindow *window, Window xwindow) {
 
   cw->opacity = OPAQUE;
 
-  cw->border_clip = None;
+  cw->border_clip = NULL;
 
   determine_mode(display, screen, cw);
   cw->needs_shadow = window_has_shadow(cw);
@@ -1912,8 +2843,9 @@ static void add_win(MetaScreen *screen, MetaWindow *window, Window xwindow) {
 
   /* Add this to the list at the top of the stack
      before it is mapped so that map_win can find it again */
-  info->windows = g_list_prepend(info->windows, cw);
-  g_hash_table_insert(info->windows_by_xid, (gpointer)xwindow, cw);
+  stack_insert_above(info, cw, info->windows ? info->windows->data : NULL);
+  g_hash_table_insert(DISPLAY_COMPOSITOR(display)->windows_by_xid,
+                      (gpointer)xwindow, cw);
 
   if (cw->attrs.map_state == IsViewable) map_win(display, screen, xwindow);
 }
@@ -1929,17 +2861,20 @@ static void destroy_win(MetaDisplay *display, Window xwindow, gboolean gone) {
 
   screen = cw->screen;
 
-  if (cw->extents != None) {
-    dump_xserver_region("destroy_win", display, cw->extents);
+  if (cw->extents != NULL) {
+    dump_region("destroy_win", display, cw->extents);
     add_damage(screen, cw->extents);
-    cw->extents = None;
+    cw->extents = NULL;
   }
 
   info = meta_screen_get_compositor_data(screen);
   if (info != NULL) {
-    info->windows = g_list_remove(info->windows, (gconstpointer)cw);
-    g_hash_table_remove(info->windows_by_xid, (gpointer)xwindow);
+    if (cw == info->unredirected_window) set_unredirected_window(screen, NULL);
+
+    stack_unlink(info, cw);
   }
+  g_hash_table_remove(DISPLAY_COMPOSITOR(display)->windows_by_xid,
+                      (gpointer)xwindow);
 
   free_win(cw, TRUE);
 }
@@ -1947,8 +2882,8 @@ static void destroy_win(MetaDisplay *display, Window xwindow, gboolean gone) {
 static void restack_win(MetaCompWindow *cw, Window above) {
   MetaScreen *screen;
   MetaCompScreen *info;
-  Window previous_above;
-  GList *sibling, *next;
+  MetaCompWindow *sibling;
+  GList *next;
 
   screen = cw->screen;
   info = meta_screen_get_compositor_data(screen);
@@ -1957,34 +2892,25 @@ static void restack_win(MetaCompWindow *cw, Window above) {
     return;
   }
 
-  sibling = g_list_find(info->windows, (gconstpointer)cw);
-  next = g_list_next(sibling);
-  previous_above = None;
-
-  if (next) {
-    MetaCompWindow *ncw = (MetaCompWindow *)next->data;
-    previous_above = ncw->id;
-  }
+  next = cw->stack_link.next;
 
   /* If above is set to None, the window whose state was changed is on
    * the bottom of the stack with respect to sibling.
    */
   if (above == None) {
     /* Insert at bottom of window stack */
-    info->windows = g_list_delete_link(info->windows, sibling);
-    info->windows = g_list_append(info->windows, cw);
-  } else if (previous_above != above) {
-    GList *index;
-
-    for (index = info->windows; index; index = index->next) {
-      MetaCompWindow *cw2 = (MetaCompWindow *)index->data;
-      if (cw2->id == above) break;
-    }
+    if (next == NULL) return;
 
-    if (index != NULL) {
-      info->windows = g_list_delete_link(info->windows, sibling);
-      info->windows = g_list_insert_before(info->windows, index, cw);
-    }
+    stack_unlink(info, cw);
+    stack_insert_above(info, cw, NULL);
+  } else {
+    if (next && ((MetaCompWindow *)next->data)->id == above) return;
+
+    sibling = find_window_for_screen(screen, above);
+    if (sibling == NULL || sibling == cw) return;
+
+    stack_unlink(info, cw);
+    stack_insert_above(info, cw, sibling);
   }
 }
 
@@ -1994,17 +2920,16 @@ static void resize_win(MetaCompWindow *cw, int x, int y, int width, int height,
   MetaDisplay *display = meta_screen_get_display(screen);
   Display *xdisplay = meta_display_get_xdisplay(display);
   MetaCompScreen *info = meta_screen_get_compositor_data(screen);
-  XserverRegion damage;
-  XserverRegion shape;
+  cairo_region_t *damage;
+  cairo_rectangle_int_t shape;
   gboolean debug;
 
   debug = DISPLAY_COMPOSITOR(display)->debug;
 
   if (cw->extents) {
-    damage = XFixesCreateRegion(xdisplay, NULL, 0);
-    XFixesCopyRegion(xdisplay, damage, cw->extents);
+    damage = cairo_region_copy(cw->extents);
   } else {
-    damage = None;
+    damage = NULL;
     if (debug) fprintf(stderr, "no extents to damage !\n");
   }
 
@@ -2041,15 +2966,7 @@ static void resize_win(MetaCompWindow *cw, int x, int y, int width, int height,
       }
     }
 
-    if (cw->picture) {
-      XRenderFreePicture(xdisplay, cw->picture);
-      cw->picture = None;
-    }
-
-    if (cw->shadow) {
-      XRenderFreePicture(xdisplay, cw->shadow);
-      cw->shadow = None;
-    }
+    release_shadow(cw);
   }
 
   cw->attrs.width = width;
@@ -2057,24 +2974,28 @@ static void resize_win(MetaCompWindow *cw, int x, int y, int width, int height,
   cw->attrs.border_width = border_width;
   cw->attrs.override_redirect = override_redirect;
 
-  if (cw->extents) XFixesDestroyRegion(xdisplay, cw->extents);
+  /* Composite allocated new storage if the size changed */
+  name_window_pixmap(cw);
+
+  if (cw->extents) cairo_region_destroy(cw->extents);
 
   cw->extents = win_extents(cw);
 
   if (damage) {
     if (debug) fprintf(stderr, "Inexplicable intersection with new extents!\n");
 
-    XFixesUnionRegion(xdisplay, damage, damage, cw->extents);
+    cairo_region_union(damage, cw->extents);
   } else {
-    damage = XFixesCreateRegion(xdisplay, NULL, 0);
-    XFixesCopyRegion(xdisplay, damage, cw->extents);
+    damage = cairo_region_copy(cw->extents);
   }
 
-  shape = XFixesCreateRegion(xdisplay, &cw->shape_bounds, 1);
-  XFixesUnionRegion(xdisplay, damage, damage, shape);
-  XFixesDestroyRegion(xdisplay, shape);
+  shape.x = cw->shape_bounds.x;
+  shape.y = cw->shape_bounds.y;
+  shape.width = cw->shape_bounds.width;
+  shape.height = cw->shape_bounds.height;
+  cairo_region_union_rectangle(damage, &shape);
 
-  dump_xserver_region("resize_win", display, damage);
+  dump_region("resize_win", display, damage);
   add_damage(screen, damage);
 
   if (info != NULL) {
@@ -2098,7 +3019,7 @@ static void process_circulate_notify(MetaCompositorXRender *compositor,
   screen = cw->screen;
   info = meta_screen_get_compositor_data(screen);
   first = info->windows;
-  top = (MetaCompWindow *)first->data;
+  top = first ? (MetaCompWindow *)first->data : NULL;
 
   if ((event->place == PlaceOnTop) && top)
     above = top->id;
@@ -2142,7 +3063,7 @@ static void process_configure_notify(MetaCompositorXRender *compositor,
     if (compositor->debug) {
       fprintf(stderr, "configure notify %d %d %d\n", cw->damaged, cw->shaped,
               cw->needs_shadow);
-      dump_xserver_region("\textents", display, cw->extents);
+      dump_region("\textents", display, cw->extents);
       fprintf(stderr, "\txy (%d %d), wh (%d %d)\n", event->x, event->y,
               event->width, event->height);
     }
@@ -2159,17 +3080,7 @@ static void process_configure_notify(MetaCompositorXRender *compositor,
     if (screen == NULL) return;
 
     info = meta_screen_get_compositor_data(screen);
-    if (info != NULL) {
-      int b;
-      for (b = 0; b < NUM_BUFFER; b++) {
-        if (info->root_buffers[b]) {
-          XRenderFreePicture(xdisplay, info->root_buffers[b]);
-          XFreePixmap(xdisplay, info->root_pixmaps[b]);
-          info->root_buffers[b] = None;
-          info->root_pixmaps[b] = None;
-        }
-      }
-    }
+    if (info != NULL) free_root_buffers(screen);
 
     damage_screen(screen);
   }
@@ -2234,12 +3145,9 @@ static void process_property_notify(MetaCompositorXRender *compositor,
     determine_mode(display, cw->screen, cw);
     cw->needs_shadow = window_has_shadow(cw);
 
-    if (cw->shadow) {
-      XRenderFreePicture(xdisplay, cw->shadow);
-      cw->shadow = None;
-    }
+    release_shadow(cw);
 
-    if (cw->extents) XFixesDestroyRegion(xdisplay, cw->extents);
+    if (cw->extents) cairo_region_destroy(cw->extents);
     cw->extents = win_extents(cw);
 
     cw->damaged = TRUE;
@@ -2263,12 +3171,21 @@ static void process_property_notify(MetaCompositorXRender *compositor,
 
 static void expose_area(MetaScreen *screen, XRectangle *rects, int nrects) {
   MetaDisplay *display = meta_screen_get_display(screen);
-  Display *xdisplay = meta_display_get_xdisplay(display);
-  XserverRegion region;
+  cairo_region_t *region;
+  int i;
+
+  region = cairo_region_create();
+  for (i = 0; i < nrects; i++) {
+    cairo_rectangle_int_t rect;
 
-  region = XFixesCreateRegion(xdisplay, rects, nrects);
+    rect.x = rects[i].x;
+    rect.y = rects[i].y;
+    rect.width = rects[i].width;
+    rect.height = rects[i].height;
+    cairo_region_union_rectangle(region, &rect);
+  }
 
-  dump_xserver_region("expose_area", display, region);
+  dump_region("expose_area", display, region);
   add_damage(screen, region);
 }
 
@@ -2352,7 +3269,7 @@ static void process_damage(MetaCompositorXRender *compositor,
       find_window_in_display(compositor->display, event->drawable);
   if (cw == NULL) return;
 
-  repair_win(cw);
+  repair_win(cw, &event->area);
 
 #ifdef USE_IDLE_REPAINT
   if (!event->more) add_repair(compositor->display);
@@ -2369,6 +3286,12 @@ static void process_shape(MetaCompositorXRender *compositor,
   if (event->kind == ShapeBounding) {
     if (!event->shaped && cw->shaped) cw->shaped = FALSE;
 
+    /* Fetched again by border_size () when it is next needed */
+    if (cw->shape_region) {
+      cairo_region_destroy(cw->shape_region);
+      cw->shape_region = NULL;
+    }
+
     resize_win(cw, cw->attrs.x, cw->attrs.y, event->width + event->x,
                event->height + event->y, cw->attrs.border_width,
                cw->attrs.override_redirect);
@@ -2393,8 +3316,25 @@ static void process_shape(MetaCompositorXRender *compositor,
 static void xrender_present_complete(MetaScreen *screen,
                                      XPresentCompleteNotifyEvent *ce) {
   MetaCompScreen *info = meta_screen_get_compositor_data(screen);
+  MetaCompositorXRender *compositor =
+      DISPLAY_COMPOSITOR(meta_screen_get_display(screen));
+
+  /* Work out the refresh interval from the vblank counter */
+  if (info->present_msc != 0 && ce->msc > info->present_msc &&
+      ce->ust > info->present_ust)
+    compositor->refresh_interval = (gint64)((ce->ust - info->present_ust) /
+                                            (ce->msc - info->present_msc));
+
+  info->present_msc = ce->msc;
+  info->present_ust = ce->ust;
+  if (info->present_pending > 0) info->present_pending--;
+
+#ifdef USE_IDLE_REPAINT
+  /* A repaint already scheduled by the frame clock will pick up the
+     damage collected while the flip was pending */
+  if (compositor->repaint_id > 0) return;
+#endif
 
-  info->present_pending = False;
   repair_screen(screen);
 }
 #endif /* HAVE_PRESENT */
@@ -2429,6 +3369,35 @@ static int timeout_debug(MetaCompositorXRender *compositor) {
   return FALSE;
 }
 
+static void prefs_changed_callback(MetaPreference pref, gpointer data) {
+  MetaCompositorXRender *compositor = (MetaCompositorXRender *)data;
+
+  /* Let the next repaint pick up or drop the unredirected window */
+  if (pref == META_PREF_COMPOSITING_UNREDIRECT_FULLSCREEN) {
+#ifdef USE_IDLE_REPAINT
+    add_repair(compositor->display);
+#else
+    repair_display(compositor->display);
+#endif
+  } else if (pref == META_PREF_COMPOSITING_BUFFER_COUNT) {
+    GSList *index;
+
+    /* Start over with the new number of buffers */
+    for (index = meta_display_get_screens(compositor->display); index;
+         index = index->next) {
+      MetaScreen *screen = index->data;
+      MetaCompScreen *info = meta_screen_get_compositor_data(screen);
+
+      if (info == NULL) continue;
+
+      free_root_buffers(screen);
+      info->root_current = 0;
+      info->num_buffers = meta_prefs_get_compositing_buffer_count();
+      damage_screen(screen);
+    }
+  }
+}
+
 static void xrender_add_window(MetaCompositor *compositor, MetaWindow *window,
                                Window xwindow, XWindowAttributes *attrs) {
 #ifdef HAVE_COMPOSITE_EXTENSIONS
@@ -2457,6 +3426,7 @@ static void show_overlay_window(MetaScreen *screen, Window cow) {
   XFixesSetWindowShapeRegion(xdisplay, cow, ShapeInput, 0, 0, region);
 
   XFixesDestroyRegion(xdisplay, region);
+  DISPLAY_COMPOSITOR(display)->xfixes_requests += 4;
 
   damage_screen(screen);
 }
@@ -2469,6 +3439,7 @@ static void hide_overlay_window(MetaScreen *screen, Window cow) {
   region = XFixesCreateRegion(xdisplay, NULL, 0);
   XFixesSetWindowShapeRegion(xdisplay, cow, ShapeBounding, 0, 0, region);
   XFixesDestroyRegion(xdisplay, region);
+  DISPLAY_COMPOSITOR(display)->xfixes_requests += 3;
 }
 
 static Window get_output_window(MetaScreen *screen) {
@@ -2533,28 +3504,40 @@ static void xrender_manage_screen(MetaCompositor *compositor,
     return;
   }
 
-  for (b = 0; b < NUM_BUFFER; b++) {
+  for (b = 0; b < MAX_NUM_BUFFER; b++) {
     info->root_buffers[b] = None;
     info->root_pixmaps[b] = None;
+#ifdef HAVE_PRESENT
+    info->root_painted[b] = 0;
+#endif
   }
+  info->root_current = 0;
+  info->num_buffers = meta_prefs_get_compositing_buffer_count();
   info->black_picture = solid_picture(display, screen, TRUE, 1, 0, 0, 0);
 
   info->root_tile = None;
-  info->all_damage = None;
+  for (b = 0; b < ALPHA_LEVELS; b++) info->alpha_pictures[b] = None;
+  info->all_damage = NULL;
+#ifdef HAVE_PRESENT
+  for (b = 0; b < MAX_NUM_BUFFER - 1; b++) info->damage_ring[b] = NULL;
+  info->frame_serial = 0;
+#endif
 
   info->windows = NULL;
-  info->windows_by_xid = g_hash_table_new(g_direct_hash, g_direct_equal);
+  info->windows_tail = NULL;
 
   info->focus_window = meta_display_get_focus_window(display);
 
   info->compositor_active = TRUE;
   info->overlays = 0;
   info->clip_changed = TRUE;
+  info->unredirected_window = NULL;
 
   info->have_shadows = (g_getenv("META_DEBUG_NO_SHADOW") == NULL);
   if (info->have_shadows) {
     meta_verbose("Enabling shadows\n");
     generate_shadows(info);
+    info->shadow_cache = shadow_cache_new();
   } else
     meta_verbose("Disabling shadows\n");
 
@@ -2563,7 +3546,9 @@ static void xrender_manage_screen(MetaCompositor *compositor,
     info->present_eid =
         XPresentSelectInput(xdisplay, info->output, PresentCompleteNotifyMask);
     info->use_present = TRUE;
-    info->present_pending = FALSE;
+    info->present_pending = 0;
+    info->present_msc = 0;
+    info->present_ust = 0;
   } else {
     info->use_present = FALSE;
     g_warning("XPresent not available");
@@ -2587,35 +3572,65 @@ static void xrender_unmanage_screen(MetaCompositor *compositor,
   MetaCompScreen *info;
   Window xroot = meta_screen_get_xroot(screen);
   GList *index;
+  int i;
 
   info = meta_screen_get_compositor_data(screen);
 
   /* This screen isn't managed */
   if (info == NULL) return;
 
+  if (info->unredirected_window != NULL) {
+    redirect_win(info->unredirected_window);
+    info->unredirected_window = NULL;
+  }
+
   hide_overlay_window(screen, info->output);
 
-  /* Destroy the windows */
-  for (index = info->windows; index; index = index->next) {
+  /* Destroy the windows, the links go with them */
+  index = info->windows;
+  while (index) {
     MetaCompWindow *cw = (MetaCompWindow *)index->data;
+
+    index = index->next;
+    g_hash_table_remove(DISPLAY_COMPOSITOR(display)->windows_by_xid,
+                        (gpointer)cw->id);
     free_win(cw, TRUE);
   }
-  g_list_free(info->windows);
-  g_hash_table_destroy(info->windows_by_xid);
+  info->windows = NULL;
+  info->windows_tail = NULL;
 
   if (info->root_picture) XRenderFreePicture(xdisplay, info->root_picture);
 
   if (info->black_picture) XRenderFreePicture(xdisplay, info->black_picture);
 
+  for (i = 0; i < ALPHA_LEVELS; i++) {
+    if (info->alpha_pictures[i])
+      XRenderFreePicture(xdisplay, info->alpha_pictures[i]);
+  }
+
+  if (info->all_damage) cairo_region_destroy(info->all_damage);
+#ifdef HAVE_PRESENT
+  free_damage_ring(info);
+#endif
+
   if (info->have_shadows) {
     MetaShadowType t;
 
     for (t = META_SHADOW_SMALL; t < LAST_SHADOW_TYPE; t++) {
+      int o;
+
+      for (o = 0; o < SHADOW_OPACITY_LEVELS; o++) {
+        if (info->shadow_slices[t][o])
+          shadow_slices_free(xdisplay, info->shadow_slices[t][o]);
+      }
+
       g_free(info->shadows[t]->gaussian_map);
       g_free(info->shadows[t]->shadow_corner);
       g_free(info->shadows[t]->shadow_top);
       g_free(info->shadows[t]);
     }
+
+    shadow_cache_free(xdisplay, info->shadow_cache);
   }
 
   XCompositeUnredirectSubwindows(xdisplay, xroot, CompositeRedirectManual);
@@ -2638,6 +3653,10 @@ static void xrender_set_updates(MetaCompositor *compositor, MetaWindow *window,
 
 static void xrender_destroy(MetaCompositor *compositor) {
 #ifdef HAVE_COMPOSITE_EXTENSIONS
+  MetaCompositorXRender *xrc = (MetaCompositorXRender *)compositor;
+
+  meta_prefs_remove_listener(prefs_changed_callback, compositor);
+  g_hash_table_destroy(xrc->windows_by_xid);
   g_free(compositor);
 #endif
 }
@@ -2779,16 +3798,9 @@ static void xrender_process_event(MetaCompositor *compositor, XEvent *event,
 #endif
 }
 
-static cairo_surface_t *xrender_get_window_surface(MetaCompositor *compositor,
-                                                   MetaWindow *window) {
-#ifdef HAVE_COMPOSITE_EXTENSIONS
+static MetaCompWindow *find_window_for_meta_window(MetaWindow *window) {
   MetaFrame *frame;
   Window xwindow;
-  MetaScreen *screen;
-  MetaCompWindow *cw;
-  MetaCompositorXRender *xrc;
-  Display *display;
-  Pixmap pixmap;
 
   frame = meta_window_get_frame(window);
 
@@ -2797,21 +3809,154 @@ static cairo_surface_t *xrender_get_window_surface(MetaCompositor *compositor,
   else
     xwindow = meta_window_get_xwindow(window);
 
-  screen = meta_window_get_screen(window);
-  cw = find_window_for_screen(screen, xwindow);
+  return find_window_for_screen(meta_window_get_screen(window), xwindow);
+}
+
+static cairo_surface_t *get_window_surface(MetaCompWindow *cw) {
+  Display *xdisplay =
+      meta_display_get_xdisplay(meta_screen_get_display(cw->screen));
+  Pixmap pixmap;
+
+  if (cw->window && meta_window_is_shaded(cw->window))
+    pixmap = cw->shaded_back_pixmap;
+  else
+    pixmap = cw->back_pixmap;
+
+  return cairo_xlib_surface_create(xdisplay, pixmap, cw->attrs.visual,
+                                   cw->attrs.width, cw->attrs.height);
+}
+
+static cairo_surface_t *xrender_get_window_surface(MetaCompositor *compositor,
+                                                   MetaWindow *window) {
+#ifdef HAVE_COMPOSITE_EXTENSIONS
+  MetaCompWindow *cw = find_window_for_meta_window(window);
 
   if (cw == NULL) return NULL;
 
-  xrc = (MetaCompositorXRender *)compositor;
-  display = meta_display_get_xdisplay(xrc->display);
+  return get_window_surface(cw);
+#endif
+}
+
+typedef struct {
+  Display *xdisplay;
+  Pixmap pixmap;
+} ThumbnailPixmap;
+
+static const cairo_user_data_key_t thumbnail_pixmap_key;
+
+static void free_thumbnail_pixmap(void *data) {
+  ThumbnailPixmap *thumbnail = data;
+
+  XFreePixmap(thumbnail->xdisplay, thumbnail->pixmap);
+  g_free(thumbnail);
+}
+
+/* Renders the thumbnail of cw again, scaled so that its longer side
+   fits max_width or max_height. The scaling happens on the server, the
+   returned surface wraps the A8R8G8B8 pixmap holding the result. */
+static gboolean render_thumbnail(MetaCompWindow *cw, int max_width,
+                                 int max_height) {
+  MetaScreen *screen = cw->screen;
+  MetaDisplay *display = meta_screen_get_display(screen);
+  Display *xdisplay = meta_display_get_xdisplay(display);
+  MetaCompositorXRender *compositor = DISPLAY_COMPOSITOR(display);
+  XRenderPictureAttributes pa;
+  ThumbnailPixmap *thumbnail;
+  cairo_surface_t *surface;
+  Picture src;
+  Pixmap pixmap;
+  int width, height;
+  gint64 start;
 
-  if (meta_window_is_shaded(window))
+  if (cw->window && meta_window_is_shaded(cw->window))
     pixmap = cw->shaded_back_pixmap;
   else
     pixmap = cw->back_pixmap;
 
-  return cairo_xlib_surface_create(display, pixmap, cw->attrs.visual,
-                                   cw->attrs.width, cw->attrs.height);
+  if (pixmap == None) return FALSE;
+
+  start = g_get_monotonic_time();
+
+  width = cw->attrs.width;
+  height = cw->attrs.height;
+
+  if (width > height) {
+    height = MAX((int)((double)height * max_width / width), 1);
+    width = max_width;
+  } else {
+    width = MAX((int)((double)width * max_height / height), 1);
+    height = max_height;
+  }
+
+  /* A picture of our own, the scaling changes its transform and filter */
+  pa.subwindow_mode = IncludeInferiors;
+  meta_error_trap_push(display);
+  src = XRenderCreatePicture(xdisplay, pixmap, get_window_format(cw),
+                             CPSubwindowMode, &pa);
+  pixmap = meta_thumbnail_scale(xdisplay, cw->id, src, cw->attrs.width,
+                                cw->attrs.height, width, height);
+  XRenderFreePicture(xdisplay, src);
+  if (meta_error_trap_pop_with_return(display, FALSE) != Success) {
+    if (pixmap != None) XFreePixmap(xdisplay, pixmap);
+    return FALSE;
+  }
+
+  if (pixmap == None) return FALSE;
+
+  surface = cairo_xlib_surface_create_with_xrender_format(
+      xdisplay, pixmap,
+      ScreenOfDisplay(xdisplay, meta_screen_get_screen_number(screen)),
+      XRenderFindStandardFormat(xdisplay, PictStandardARGB32), width, height);
+
+  thumbnail = g_new(ThumbnailPixmap, 1);
+  thumbnail->xdisplay = xdisplay;
+  thumbnail->pixmap = pixmap;
+  cairo_surface_set_user_data(surface, &thumbnail_pixmap_key, thumbnail,
+                              free_thumbnail_pixmap);
+
+  if (cw->thumbnail) cairo_surface_destroy(cw->thumbnail);
+
+  cw->thumbnail = surface;
+  cw->thumbnail_max_width = max_width;
+  cw->thumbnail_max_height = max_height;
+  cw->thumbnail_time = g_get_monotonic_time();
+  cw->thumbnail_dirty = FALSE;
+
+  compositor->thumbnails_rendered++;
+  compositor->thumbnail_render_time += cw->thumbnail_time - start;
+
+  return TRUE;
+}
+
+static cairo_surface_t *xrender_get_window_thumbnail(MetaCompositor *compositor,
+                                                     MetaWindow *window,
+                                                     int max_width,
+                                                     int max_height) {
+#ifdef HAVE_COMPOSITE_EXTENSIONS
+  MetaCompWindow *cw = find_window_for_meta_window(window);
+  gboolean same_size;
+  gint64 age;
+
+  if (cw == NULL || max_width <= 0 || max_height <= 0) return NULL;
+
+  same_size = cw->thumbnail && cw->thumbnail_max_width == max_width &&
+              cw->thumbnail_max_height == max_height;
+
+  if (same_size) {
+    /* A recent thumbnail is good enough even if the window has changed
+       since, so that going through the popup quickly doesn't render
+       the same windows over and over */
+    age = g_get_monotonic_time() - cw->thumbnail_time;
+    if (!cw->thumbnail_dirty || age < THUMBNAIL_REFRESH_INTERVAL * 1000)
+      return cairo_surface_reference(cw->thumbnail);
+  }
+
+  /* Unmapped windows have no pixmap, keep showing their last contents */
+  if (!render_thumbnail(cw, max_width, max_height) && !same_size) return NULL;
+
+  return cairo_surface_reference(cw->thumbnail);
+#else
+  return NULL;
 #endif
 }
 
@@ -2855,7 +4000,7 @@ static void xrender_set_active_window(MetaCompositor *compositor,
   }
 
   if (old_focus) {
-    XserverRegion damage;
+    cairo_region_t *damage;
 
     /* Tear down old shadows */
     old_focus->shadow_type = META_SHADOW_MEDIUM;
@@ -2863,29 +4008,20 @@ static void xrender_set_active_window(MetaCompositor *compositor,
     old_focus->needs_shadow = window_has_shadow(old_focus);
 
     if (old_focus->attrs.map_state == IsViewable) {
-      if (old_focus->shadow) {
-        XRenderFreePicture(xdisplay, old_focus->shadow);
-        old_focus->shadow = None;
-      }
+      release_shadow(old_focus);
 
-      if (old_focus->extents) {
-        damage = XFixesCreateRegion(xdisplay, NULL, 0);
-        XFixesCopyRegion(xdisplay, damage, old_focus->extents);
-        XFixesDestroyRegion(xdisplay, old_focus->extents);
-      } else
-        damage = None;
+      /* The old extents become part of the damage */
+      damage = old_focus->extents;
 
       /* Build new extents */
       old_focus->extents = win_extents(old_focus);
 
       if (damage)
-        XFixesUnionRegion(xdisplay, damage, damage, old_focus->extents);
-      else {
-        damage = XFixesCreateRegion(xdisplay, NULL, 0);
-        XFixesCopyRegion(xdisplay, damage, old_focus->extents);
-      }
+        cairo_region_union(damage, old_focus->extents);
+      else
+        damage = cairo_region_copy(old_focus->extents);
 
-      dump_xserver_region("resize_win", display, damage);
+      dump_region("resize_win", display, damage);
       add_damage(screen, damage);
 
       if (info != NULL) {
@@ -2895,35 +4031,26 @@ static void xrender_set_active_window(MetaCompositor *compositor,
   }
 
   if (new_focus) {
-    XserverRegion damage;
+    cairo_region_t *damage;
 
     new_focus->shadow_type = META_SHADOW_LARGE;
     determine_mode(display, screen, new_focus);
     new_focus->needs_shadow = window_has_shadow(new_focus);
 
-    if (new_focus->shadow) {
-      XRenderFreePicture(xdisplay, new_focus->shadow);
-      new_focus->shadow = None;
-    }
+    release_shadow(new_focus);
 
-    if (new_focus->extents) {
-      damage = XFixesCreateRegion(xdisplay, NULL, 0);
-      XFixesCopyRegion(xdisplay, damage, new_focus->extents);
-      XFixesDestroyRegion(xdisplay, new_focus->extents);
-    } else
-      damage = None;
+    /* The old extents become part of the damage */
+    damage = new_focus->extents;
 
     /* Build new extents */
     new_focus->extents = win_extents(new_focus);
 
     if (damage)
-      XFixesUnionRegion(xdisplay, damage, damage, new_focus->extents);
-    else {
-      damage = XFixesCreateRegion(xdisplay, NULL, 0);
-      XFixesCopyRegion(xdisplay, damage, new_focus->extents);
-    }
+      cairo_region_union(damage, new_focus->extents);
+    else
+      damage = cairo_region_copy(new_focus->extents);
 
-    dump_xserver_region("resize_win", display, damage);
+    dump_region("resize_win", display, damage);
     add_damage(screen, damage);
 
     if (info != NULL) {
@@ -2966,6 +4093,66 @@ static void xrender_unmaximize_window(MetaCompositor *compositor,
 #endif
 }
 
+static char *xrender_get_stats(MetaCompositor *compositor) {
+#ifdef HAVE_COMPOSITE_EXTENSIONS
+  MetaCompositorXRender *xrc = (MetaCompositorXRender *)compositor;
+  guint64 hits = 0, misses = 0, evictions = 0;
+  GString *stats;
+  GSList *index;
+
+  for (index = meta_display_get_screens(xrc->display); index;
+       index = index->next) {
+    MetaCompScreen *info = meta_screen_get_compositor_data(index->data);
+
+    if (info == NULL || info->shadow_cache == NULL) continue;
+
+    hits += info->shadow_cache->hits;
+    misses += info->shadow_cache->misses;
+    evictions += info->shadow_cache->evictions;
+  }
+
+  stats = g_string_new(NULL);
+  g_string_append_printf(stats, "frames=%" G_GUINT64_FORMAT "\n",
+                         xrc->frame_count);
+  g_string_append_printf(stats, "paint-time-us=%" G_GINT64_FORMAT "\n",
+                         xrc->paint_time);
+  g_string_append_printf(stats, "last-paint-time-us=%" G_GINT64_FORMAT "\n",
+                         xrc->last_paint_time);
+  g_string_append_printf(stats, "last-frame-latency-us=%" G_GINT64_FORMAT "\n",
+                         xrc->last_frame_latency);
+  g_string_append_printf(stats, "refresh-interval-us=%" G_GINT64_FORMAT "\n",
+                         xrc->refresh_interval);
+  g_string_append_printf(stats, "damage-area=%" G_GUINT64_FORMAT "\n",
+                         xrc->damage_area);
+  g_string_append_printf(stats, "last-damage-area=%" G_GUINT64_FORMAT "\n",
+                         xrc->last_damage_area);
+  g_string_append_printf(stats, "windows-painted=%" G_GUINT64_FORMAT "\n",
+                         xrc->windows_painted);
+  g_string_append_printf(stats, "last-windows-painted=%u\n",
+                         xrc->last_windows_painted);
+  g_string_append_printf(stats, "shadows-created=%" G_GUINT64_FORMAT "\n",
+                         xrc->shadows_created);
+  g_string_append_printf(stats, "shadow-cache-hits=%" G_GUINT64_FORMAT "\n",
+                         hits);
+  g_string_append_printf(stats, "shadow-cache-misses=%" G_GUINT64_FORMAT "\n",
+                         misses);
+  g_string_append_printf(stats,
+                         "shadow-cache-evictions=%" G_GUINT64_FORMAT "\n",
+                         evictions);
+  g_string_append_printf(stats, "xfixes-requests=%" G_GUINT64_FORMAT "\n",
+                         xrc->xfixes_requests);
+  g_string_append_printf(stats, "thumbnails-rendered=%" G_GUINT64_FORMAT "\n",
+                         xrc->thumbnails_rendered);
+  g_string_append_printf(stats,
+                         "thumbnail-render-time-us=%" G_GINT64_FORMAT "\n",
+                         xrc->thumbnail_render_time);
+
+  return g_string_free(stats, FALSE);
+#else
+  return NULL;
+#endif
+}
+
 static MetaCompositor comp_info = {
     xrender_destroy,           xrender_manage_screen,
     xrender_unmanage_screen,   xrender_add_window,
@@ -2973,6 +4160,7 @@ static MetaCompositor comp_info = {
     xrender_process_event,     xrender_get_window_surface,
     xrender_set_active_window, xrender_free_window,
     xrender_maximize_window,   xrender_unmaximize_window,
+    xrender_get_stats,         xrender_get_window_thumbnail,
 };
 
 MetaCompositor *meta_compositor_xrender_new(MetaDisplay *display) {
@@ -3034,9 +4222,29 @@ MetaCompositor *meta_compositor_xrender_new(MetaDisplay *display) {
   xrc->repaint_id = 0;
 #endif
 
+  xrc->windows_by_xid = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  xrc->damage_time = 0;
+  xrc->last_frame_time = 0;
+  xrc->refresh_interval = 0;
+  xrc->last_paint_time = 0;
+  xrc->last_frame_latency = 0;
+  xrc->frame_count = 0;
+  xrc->paint_time = 0;
+  xrc->damage_area = 0;
+  xrc->last_damage_area = 0;
+  xrc->windows_painted = 0;
+  xrc->last_windows_painted = 0;
+  xrc->shadows_created = 0;
+  xrc->xfixes_requests = 0;
+  xrc->thumbnails_rendered = 0;
+  xrc->thumbnail_render_time = 0;
+
   xrc->enabled = TRUE;
   g_timeout_add(2000, (GSourceFunc)timeout_debug, xrc);
 
+  meta_prefs_add_listener(prefs_changed_callback, xrc);
+
   return compositor;
 #else
   return NULL;
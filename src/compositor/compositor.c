@@ -141,3 +141,28 @@ void meta_compositor_unmaximize_window(MetaCompositor *compositor,
     compositor->unmaximize_window(compositor, window);
 #endif
 }
+
+char *meta_compositor_get_stats(MetaCompositor *compositor) {
+#ifdef HAVE_COMPOSITE_EXTENSIONS
+  if (compositor && compositor->get_stats)
+    return compositor->get_stats(compositor);
+  else
+    return NULL;
+#else
+  return NULL;
+#endif
+}
+
+cairo_surface_t *meta_compositor_get_window_thumbnail(
+    MetaCompositor *compositor, MetaWindow *window, int max_width,
+    int max_height) {
+#ifdef HAVE_COMPOSITE_EXTENSIONS
+  if (compositor && compositor->get_window_thumbnail)
+    return compositor->get_window_thumbnail(compositor, window, max_width,
+                                            max_height);
+  else
+    return NULL;
+#else
+  return NULL;
+#endif
+}
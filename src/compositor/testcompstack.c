@@ -0,0 +1,205 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Compares compositor restacking with the list code it replaced */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include <X11/Xlib.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h> /* To initialize random seed */
+
+#include "comp-stack.h"
+
+#define N_EVENTS 20000
+#define N_ROUNDS 20
+
+typedef struct {
+  Window id;
+  GList stack_link;
+} TestWindow;
+
+typedef struct {
+  Window window;
+  Window above;
+} RestackEvent;
+
+typedef struct {
+  GHashTable *windows_by_xid;
+  GList *windows;
+  GList *windows_tail;
+} TestScreen;
+
+/* What restack_win () in compositor-xrender.c used to do */
+static void restack_list(GList **windows, TestWindow *tw, Window above) {
+  GList *sibling, *next;
+  Window previous_above;
+
+  sibling = g_list_find(*windows, tw);
+  next = g_list_next(sibling);
+  previous_above = None;
+
+  if (next) previous_above = ((TestWindow *)next->data)->id;
+
+  if (above == None) {
+    *windows = g_list_delete_link(*windows, sibling);
+    *windows = g_list_append(*windows, tw);
+  } else if (previous_above != above) {
+    GList *index;
+
+    for (index = *windows; index; index = index->next)
+      if (((TestWindow *)index->data)->id == above) break;
+
+    if (index != NULL) {
+      *windows = g_list_delete_link(*windows, sibling);
+      *windows = g_list_insert_before(*windows, index, tw);
+    }
+  }
+}
+
+/* What restack_win () does now */
+static void restack_stack(TestScreen *screen, TestWindow *tw, Window above) {
+  GList *next = tw->stack_link.next;
+  TestWindow *sibling;
+
+  if (above == None) {
+    if (next == NULL) return;
+
+    meta_comp_stack_unlink(&screen->windows, &screen->windows_tail,
+                           &tw->stack_link);
+    meta_comp_stack_insert_above(&screen->windows, &screen->windows_tail,
+                                 &tw->stack_link, NULL);
+  } else {
+    if (next && ((TestWindow *)next->data)->id == above) return;
+
+    sibling = g_hash_table_lookup(screen->windows_by_xid, (gpointer)above);
+    if (sibling == NULL || sibling == tw) return;
+
+    meta_comp_stack_unlink(&screen->windows, &screen->windows_tail,
+                           &tw->stack_link);
+    meta_comp_stack_insert_above(&screen->windows, &screen->windows_tail,
+                                 &tw->stack_link, &sibling->stack_link);
+  }
+}
+
+static void check_same_order(GList *list, GList *stack) {
+  for (; list && stack; list = list->next, stack = stack->next)
+    g_assert(list->data == stack->data);
+
+  g_assert(list == NULL && stack == NULL);
+}
+
+static void run(int n_windows) {
+  TestWindow *windows;
+  RestackEvent *events;
+  TestScreen screen;
+  GList *list = NULL;
+  GList *saved, *l;
+  gint64 start, list_time, stack_time;
+  int i, round;
+
+  windows = g_new0(TestWindow, n_windows);
+  events = g_new(RestackEvent, N_EVENTS);
+
+  screen.windows_by_xid = g_hash_table_new(g_direct_hash, g_direct_equal);
+  screen.windows = NULL;
+  screen.windows_tail = NULL;
+
+  for (i = 0; i < n_windows; i++) {
+    TestWindow *tw = &windows[i];
+
+    tw->id = 0x400000 + i * 0x10;
+    tw->stack_link.data = tw;
+
+    g_hash_table_insert(screen.windows_by_xid, (gpointer)tw->id, tw);
+    meta_comp_stack_insert_above(&screen.windows, &screen.windows_tail,
+                                 &tw->stack_link, screen.windows);
+    list = g_list_prepend(list, tw);
+  }
+
+  /* Mostly raises above some other window, like an app restacking its
+     transients, with a few lowers to the bottom */
+  for (i = 0; i < N_EVENTS; i++) {
+    events[i].window = windows[rand() % n_windows].id;
+
+    /* The X server never stacks a window relative to itself */
+    do
+      events[i].above =
+          rand() % 8 ? windows[rand() % n_windows].id : (Window)None;
+    while (events[i].above == events[i].window);
+  }
+
+  /* Both are handed the window the same way, looked up by XID */
+  for (i = 0; i < N_EVENTS; i++) {
+    restack_list(&list,
+                 g_hash_table_lookup(screen.windows_by_xid,
+                                     (gpointer)events[i].window),
+                 events[i].above);
+    restack_stack(&screen,
+                  g_hash_table_lookup(screen.windows_by_xid,
+                                      (gpointer)events[i].window),
+                  events[i].above);
+  }
+  check_same_order(list, screen.windows);
+
+  start = g_get_monotonic_time();
+  for (round = 0; round < N_ROUNDS; round++)
+    for (i = 0; i < N_EVENTS; i++)
+      restack_list(&list,
+                   g_hash_table_lookup(screen.windows_by_xid,
+                                       (gpointer)events[i].window),
+                   events[i].above);
+  list_time = g_get_monotonic_time() - start;
+
+  start = g_get_monotonic_time();
+  for (round = 0; round < N_ROUNDS; round++)
+    for (i = 0; i < N_EVENTS; i++)
+      restack_stack(&screen,
+                    g_hash_table_lookup(screen.windows_by_xid,
+                                        (gpointer)events[i].window),
+                    events[i].above);
+  stack_time = g_get_monotonic_time() - start;
+
+  check_same_order(list, screen.windows);
+
+  /* The tail has to be right for lowering to the bottom to work */
+  saved = screen.windows_tail;
+  for (l = screen.windows; l->next; l = l->next)
+    ;
+  g_assert(l == saved);
+
+  printf("%4d windows, ns per restack: list %.1f, stack %.1f\n", n_windows,
+         list_time * 1000.0 / (N_ROUNDS * N_EVENTS),
+         stack_time * 1000.0 / (N_ROUNDS * N_EVENTS));
+
+  g_list_free(list);
+  g_hash_table_destroy(screen.windows_by_xid);
+  g_free(events);
+  g_free(windows);
+}
+
+int main(void) {
+  srand(time(NULL));
+
+  run(10);
+  run(100);
+  run(1000);
+
+  return 0;
+}
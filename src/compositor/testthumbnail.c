@@ -0,0 +1,218 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Compares server-side thumbnail scaling with the cairo path */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <cairo/cairo-xlib-xrender.h>
+#include <cairo/cairo-xlib.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thumbnail.h"
+
+#define ITERATIONS 20
+
+static Display *xdisplay;
+static int screen_number;
+static Window root;
+
+/* Something with fine detail, so that aliasing shows in the results */
+static Pixmap create_source(int width, int height) {
+  cairo_surface_t *surface;
+  cairo_pattern_t *gradient;
+  cairo_t *cr;
+  Pixmap pixmap;
+  int x;
+
+  pixmap = XCreatePixmap(xdisplay, root, width, height,
+                         DefaultDepth(xdisplay, screen_number));
+  surface = cairo_xlib_surface_create(
+      xdisplay, pixmap, DefaultVisual(xdisplay, screen_number), width, height);
+  cr = cairo_create(surface);
+
+  gradient = cairo_pattern_create_linear(0, 0, width, height);
+  cairo_pattern_add_color_stop_rgb(gradient, 0, 0.2, 0.4, 0.8);
+  cairo_pattern_add_color_stop_rgb(gradient, 1, 0.9, 0.6, 0.1);
+  cairo_set_source(cr, gradient);
+  cairo_paint(cr);
+  cairo_pattern_destroy(gradient);
+
+  cairo_set_source_rgb(cr, 0, 0, 0);
+  for (x = 0; x < width; x += 3) cairo_rectangle(cr, x, 0, 1, height);
+  cairo_fill(cr);
+
+  cairo_destroy(cr);
+  cairo_surface_destroy(surface);
+
+  return pixmap;
+}
+
+static void save_png(cairo_surface_t *surface, const char *filename) {
+  if (cairo_surface_write_to_png(surface, filename) == CAIRO_STATUS_SUCCESS)
+    printf("  wrote %s\n", filename);
+}
+
+/* What get_window_surface () in screen.c used to do */
+static cairo_surface_t *scale_with_cairo(Pixmap source, int src_width,
+                                         int src_height, int width,
+                                         int height) {
+  cairo_surface_t *surface, *scaled;
+  cairo_t *cr;
+
+  surface = cairo_xlib_surface_create(xdisplay, source,
+                                      DefaultVisual(xdisplay, screen_number),
+                                      src_width, src_height);
+  scaled = cairo_surface_create_similar(
+      surface, cairo_surface_get_content(surface), width, height);
+
+  cr = cairo_create(scaled);
+  cairo_scale(cr, (double)width / src_width, (double)height / src_height);
+  cairo_set_source_surface(cr, surface, 0, 0);
+  cairo_paint(cr);
+  cairo_destroy(cr);
+
+  cairo_surface_destroy(surface);
+  cairo_surface_flush(scaled);
+
+  return scaled;
+}
+
+static Pixmap scale_with_xrender(Pixmap source, int src_width, int src_height,
+                                 int width, int height) {
+  XRenderPictFormat *format;
+  Picture src;
+  Pixmap pixmap;
+
+  format = XRenderFindVisualFormat(xdisplay,
+                                   DefaultVisual(xdisplay, screen_number));
+  src = XRenderCreatePicture(xdisplay, source, format, 0, NULL);
+  pixmap = meta_thumbnail_scale(xdisplay, root, src, src_width, src_height,
+                                width, height);
+  XRenderFreePicture(xdisplay, src);
+
+  return pixmap;
+}
+
+static void run(Pixmap source, int src_width, int src_height, int width,
+                int height, gboolean save) {
+  cairo_surface_t *surface;
+  Pixmap pixmap;
+  gint64 start, cairo_time, xrender_time;
+  int i;
+
+  printf("%dx%d -> %dx%d\n", src_width, src_height, width, height);
+
+  start = g_get_monotonic_time();
+  for (i = 0; i < ITERATIONS; i++) {
+    surface = scale_with_cairo(source, src_width, src_height, width, height);
+    XSync(xdisplay, False);
+
+    if (save && i == 0) save_png(surface, "thumbnail-cairo.png");
+
+    cairo_surface_destroy(surface);
+  }
+  cairo_time = g_get_monotonic_time() - start;
+
+  start = g_get_monotonic_time();
+  for (i = 0; i < ITERATIONS; i++) {
+    pixmap =
+        scale_with_xrender(source, src_width, src_height, width, height);
+    XSync(xdisplay, False);
+
+    if (pixmap == None) {
+      fprintf(stderr, "XRender scaling failed\n");
+      exit(1);
+    }
+
+    if (save && i == 0) {
+      surface = cairo_xlib_surface_create_with_xrender_format(
+          xdisplay, pixmap, ScreenOfDisplay(xdisplay, screen_number),
+          XRenderFindStandardFormat(xdisplay, PictStandardARGB32), width,
+          height);
+      save_png(surface, "thumbnail-xrender.png");
+      cairo_surface_destroy(surface);
+    }
+
+    XFreePixmap(xdisplay, pixmap);
+  }
+  xrender_time = g_get_monotonic_time() - start;
+
+  printf("  cairo:   %8.3f ms per thumbnail\n",
+         cairo_time / 1000.0 / ITERATIONS);
+  printf("  xrender: %8.3f ms per thumbnail\n",
+         xrender_time / 1000.0 / ITERATIONS);
+}
+
+int main(int argc, char **argv) {
+  static const int sizes[][2] = {
+      {3840, 2160}, {1920, 1080}, {800, 600}, {300, 1200}};
+  gboolean save = FALSE;
+  int max_size = 200;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--save") == 0)
+      save = TRUE;
+    else
+      max_size = atoi(argv[i]);
+  }
+
+  if (max_size <= 0) {
+    fprintf(stderr, "Usage: %s [--save] [MAX_SIZE]\n", argv[0]);
+    return 1;
+  }
+
+  xdisplay = XOpenDisplay(NULL);
+  if (xdisplay == NULL) {
+    fprintf(stderr, "Could not open display\n");
+    return 1;
+  }
+
+  screen_number = DefaultScreen(xdisplay);
+  root = RootWindow(xdisplay, screen_number);
+
+  for (i = 0; i < (int)G_N_ELEMENTS(sizes); i++) {
+    int src_width = sizes[i][0];
+    int src_height = sizes[i][1];
+    int width, height;
+    Pixmap source;
+
+    if (src_width > src_height) {
+      width = max_size;
+      height = MAX(src_height * max_size / src_width, 1);
+    } else {
+      height = max_size;
+      width = MAX(src_width * max_size / src_height, 1);
+    }
+
+    source = create_source(src_width, src_height);
+    run(source, src_width, src_height, width, height, save && i == 0);
+    XFreePixmap(xdisplay, source);
+  }
+
+  XCloseDisplay(xdisplay);
+
+  return 0;
+}
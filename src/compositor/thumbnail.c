@@ -0,0 +1,113 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Server-side window thumbnail scaling */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_COMPOSITE_EXTENSIONS
+
+#include "thumbnail.h"
+
+static Picture create_argb_picture(Display *xdisplay, Drawable drawable,
+                                   int width, int height, Pixmap *pixmap) {
+  XRenderPictFormat *format;
+
+  *pixmap = None;
+
+  format = XRenderFindStandardFormat(xdisplay, PictStandardARGB32);
+  if (format == NULL) return None;
+
+  *pixmap = XCreatePixmap(xdisplay, drawable, width, height, 32);
+  return XRenderCreatePicture(xdisplay, *pixmap, format, 0, NULL);
+}
+
+/* The transform maps the center of destination pixel x to source
+   coordinate 2x + 1 when halving, which is the corner shared by four
+   source pixels, so the bilinear filter averages exactly that 2x2
+   block. */
+static void scale_picture(Display *xdisplay, Picture src, int src_width,
+                          int src_height, Picture dst, int width,
+                          int height) {
+  XTransform transform = {
+      {{XDoubleToFixed((double)src_width / width), 0, 0},
+       {0, XDoubleToFixed((double)src_height / height), 0},
+       {0, 0, XDoubleToFixed(1.0)}}};
+  XRenderPictureAttributes pa;
+
+  /* Keep the edges from blending with transparent black */
+  pa.repeat = RepeatPad;
+  XRenderChangePicture(xdisplay, src, CPRepeat, &pa);
+
+  XRenderSetPictureTransform(xdisplay, src, &transform);
+  XRenderSetPictureFilter(xdisplay, src, FilterBilinear, NULL, 0);
+  XRenderComposite(xdisplay, PictOpSrc, src, None, dst, 0, 0, 0, 0, 0, 0,
+                   width, height);
+}
+
+Pixmap meta_thumbnail_scale(Display *xdisplay, Drawable drawable, Picture src,
+                            int src_width, int src_height, int width,
+                            int height) {
+  Picture current = src;
+  Pixmap current_pixmap = None;
+  int current_width = src_width;
+  int current_height = src_height;
+
+  if (src_width <= 0 || src_height <= 0 || width <= 0 || height <= 0)
+    return None;
+
+  do {
+    Picture next;
+    Pixmap next_pixmap;
+    int next_width = width;
+    int next_height = height;
+
+    if (current_width > 2 * width) next_width = (current_width + 1) / 2;
+    if (current_height > 2 * height) next_height = (current_height + 1) / 2;
+
+    next = create_argb_picture(xdisplay, drawable, next_width, next_height,
+                               &next_pixmap);
+    if (next != None)
+      scale_picture(xdisplay, current, current_width, current_height, next,
+                    next_width, next_height);
+
+    if (current != src) {
+      XRenderFreePicture(xdisplay, current);
+      XFreePixmap(xdisplay, current_pixmap);
+    }
+
+    if (next == None) {
+      if (next_pixmap != None) XFreePixmap(xdisplay, next_pixmap);
+      return None;
+    }
+
+    current = next;
+    current_pixmap = next_pixmap;
+    current_width = next_width;
+    current_height = next_height;
+  } while (current_width != width || current_height != height);
+
+  XRenderFreePicture(xdisplay, current);
+
+  return current_pixmap;
+}
+
+#endif /* HAVE_COMPOSITE_EXTENSIONS */
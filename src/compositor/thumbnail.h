@@ -0,0 +1,40 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Server-side window thumbnail scaling */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef META_THUMBNAIL_H
+#define META_THUMBNAIL_H
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrender.h>
+
+/* Scales the src_width x src_height picture src down to width x height
+ * into a new A8R8G8B8 pixmap without fetching any image data from the
+ * server. Large ratios are reduced in steps of two, each of which
+ * averages 2x2 blocks, before a final bilinear step. The transform,
+ * filter and repeat mode of src are changed.
+ *
+ * Returns None on failure; free the pixmap with XFreePixmap ().
+ */
+Pixmap meta_thumbnail_scale(Display *xdisplay, Drawable drawable, Picture src,
+                            int src_width, int src_height, int width,
+                            int height);
+
+#endif
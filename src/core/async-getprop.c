@@ -571,6 +571,177 @@ AgGetPropertyTask *ag_get_next_completed_task(Display *display) {
   return (AgGetPropertyTask *)dd->completed_tasks;
 }
 
+typedef struct {
+  _XAsyncHandler async;
+
+  XWindowAttributes *attrs;
+  Bool *succeeded;
+  int n_windows;
+
+  /* The GetWindowAttributes and GetGeometry sequences of each window */
+  unsigned long *request_seqs;
+  int next;
+
+  /* The replies received for each window, REPLY_ATTRIBUTES and so on */
+  unsigned char *replies;
+} AgAttributesBatch;
+
+#define REPLY_ATTRIBUTES (1 << 0)
+#define REPLY_GEOMETRY (1 << 1)
+
+static void fill_screen(Display *dpy, XWindowAttributes *attr) {
+  int i;
+
+  attr->screen = NULL;
+  for (i = 0; i < dpy->nscreens; i++) {
+    if (dpy->screens[i].root == attr->root) {
+      attr->screen = &dpy->screens[i];
+      break;
+    }
+  }
+}
+
+static Bool async_get_attributes_handler(Display *dpy, xReply *rep, char *buf,
+                                         int len, XPointer data) {
+  AgAttributesBatch *batch;
+  XWindowAttributes *attr;
+  unsigned long seq;
+  int i;
+
+  batch = (void *)data;
+  seq = dpy->last_request_read;
+
+  /* Replies come in request order, so skip the windows we are done with */
+  while (batch->next < batch->n_windows &&
+         batch->request_seqs[batch->next * 2 + 1] < seq)
+    batch->next += 1;
+
+  if (batch->next == batch->n_windows) return False;
+
+  i = batch->next;
+  if (seq != batch->request_seqs[i * 2] &&
+      seq != batch->request_seqs[i * 2 + 1])
+    return False;
+
+  attr = &batch->attrs[i];
+
+  if (rep->generic.type == X_Error) {
+    xError errbuf;
+
+    /* Eat it, like async_get_property_handler() does. With XCB, errors
+     * don't get here, but go to the error handler instead.
+     */
+    _XGetAsyncReply(dpy, (char *)&errbuf, rep, buf, len,
+                    (SIZEOF(xError) - SIZEOF(xReply)) >> 2, False);
+    return True;
+  }
+
+  if (seq == batch->request_seqs[i * 2]) {
+    xGetWindowAttributesReply replbuf;
+    xGetWindowAttributesReply *reply;
+
+    reply = (xGetWindowAttributesReply *)_XGetAsyncReply(
+        dpy, (char *)&replbuf, rep, buf, len,
+        (SIZEOF(xGetWindowAttributesReply) - SIZEOF(xReply)) >> 2, True);
+
+    attr->class = reply->class;
+    attr->bit_gravity = reply->bitGravity;
+    attr->win_gravity = reply->winGravity;
+    attr->backing_store = reply->backingStore;
+    attr->backing_planes = reply->backingBitPlanes;
+    attr->backing_pixel = reply->backingPixel;
+    attr->save_under = reply->saveUnder;
+    attr->colormap = reply->colormap;
+    attr->map_installed = reply->mapInstalled;
+    attr->map_state = reply->mapState;
+    attr->all_event_masks = reply->allEventMasks;
+    attr->your_event_mask = reply->yourEventMask;
+    attr->do_not_propagate_mask = reply->doNotPropagateMask;
+    attr->override_redirect = reply->override;
+    attr->visual = _XVIDtoVisual(dpy, reply->visualID);
+    batch->replies[i] |= REPLY_ATTRIBUTES;
+  } else {
+    xGetGeometryReply replbuf;
+    xGetGeometryReply *reply;
+
+    reply = (xGetGeometryReply *)_XGetAsyncReply(
+        dpy, (char *)&replbuf, rep, buf, len,
+        (SIZEOF(xGetGeometryReply) - SIZEOF(xReply)) >> 2, True);
+
+    attr->root = reply->root;
+    attr->x = cvtINT16toInt(reply->x);
+    attr->y = cvtINT16toInt(reply->y);
+    attr->width = reply->width;
+    attr->height = reply->height;
+    attr->border_width = reply->borderWidth;
+    attr->depth = reply->depth;
+    fill_screen(dpy, attr);
+    batch->replies[i] |= REPLY_GEOMETRY;
+  }
+
+  return True;
+}
+
+void ag_get_window_attributes(Display *dpy, const Window *windows,
+                              int n_windows, XWindowAttributes *attrs,
+                              Bool *succeeded) {
+  AgAttributesBatch batch;
+  xResourceReq *req;
+  int i;
+
+  if (n_windows <= 0) return;
+
+  batch.request_seqs = Xmalloc(n_windows * 2 * sizeof(unsigned long));
+  batch.replies = Xcalloc(n_windows, 1);
+  if (batch.request_seqs == NULL || batch.replies == NULL) {
+    Xfree(batch.request_seqs);
+    Xfree(batch.replies);
+    for (i = 0; i < n_windows; i++)
+      succeeded[i] = XGetWindowAttributes(dpy, windows[i], &attrs[i]) != 0;
+    return;
+  }
+
+  batch.attrs = attrs;
+  batch.succeeded = succeeded;
+  batch.n_windows = n_windows;
+  batch.next = 0;
+
+  LockDisplay(dpy);
+
+  batch.async.next = dpy->async_handlers;
+  batch.async.handler = async_get_attributes_handler;
+  batch.async.data = (XPointer)&batch;
+  dpy->async_handlers = &batch.async;
+
+  /* XGetWindowAttributes() sends these same two requests, but waits
+   * for both replies before going on to the next window
+   */
+  for (i = 0; i < n_windows; i++) {
+    GetResReq(GetWindowAttributes, windows[i], req);
+    batch.request_seqs[i * 2] = dpy->request;
+
+    GetResReq(GetGeometry, windows[i], req);
+    batch.request_seqs[i * 2 + 1] = dpy->request;
+  }
+
+  UnlockDisplay(dpy);
+
+  /* All the replies are read, by the handler, on the way to this one */
+  XSync(dpy, False);
+
+  LockDisplay(dpy);
+  DeqAsyncHandler(dpy, &batch.async);
+  UnlockDisplay(dpy);
+
+  SyncHandle();
+
+  for (i = 0; i < n_windows; i++)
+    succeeded[i] = batch.replies[i] == (REPLY_ATTRIBUTES | REPLY_GEOMETRY);
+
+  Xfree(batch.request_seqs);
+  Xfree(batch.replies);
+}
+
 void *ag_Xmalloc(unsigned long bytes) { return (void *)Xmalloc(bytes); }
 
 void *ag_Xmalloc0(unsigned long bytes) { return (void *)Xcalloc(bytes, 1); }
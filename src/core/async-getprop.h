@@ -50,6 +50,15 @@ Display *ag_task_get_display(AgGetPropertyTask *task);
 
 AgGetPropertyTask *ag_get_next_completed_task(Display *display);
 
+/* Like XGetWindowAttributes() on each window, but with a single round
+ * trip. succeeded[i] is False where windows[i] is gone. As with
+ * XGetWindowAttributes(), the X error for it may still be raised, so
+ * trap errors around this.
+ */
+void ag_get_window_attributes(Display *display, const Window *windows,
+                              int n_windows, XWindowAttributes *attrs,
+                              Bool *succeeded);
+
 /* so other headers don't have to include internal Xlib goo */
 void *ag_Xmalloc(unsigned long bytes);
 void *ag_Xmalloc0(unsigned long bytes);
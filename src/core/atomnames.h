@@ -58,6 +58,8 @@ item(_MARCO_RESTART_MESSAGE)
 item(_MARCO_RELOAD_THEME_MESSAGE)
 item(_MARCO_SET_KEYBINDINGS_MESSAGE)
 item(_MARCO_TOGGLE_VERBOSE)
+item(_MARCO_COMPOSITOR_STATS_MESSAGE)
+item(_MARCO_COMPOSITOR_STATS)
 item(_GTK_THEME_VARIANT)
 item(_GTK_FRAME_EXTENTS)
 item(_GTK_SHOW_WINDOW_MENU)
@@ -29,6 +29,7 @@
 #include "boxes.h"
 
 #include <X11/Xutil.h> /* Just for the definition of the various gravities */
+#include <string.h>
 
 #include "util.h"
 
@@ -237,6 +238,144 @@ gboolean meta_rectangle_contains_rect(const MetaRectangle *outer_rect,
              outer_rect->y + outer_rect->height;
 }
 
+/* A uniform grid over the bounding box of the rectangles, with cells
+ * about the size of an average rectangle. Each cell lists the
+ * rectangles that overlap it, so a query only tests the rectangles
+ * near it.
+ */
+struct _MetaRectangleGrid {
+  MetaRectangle bounds;
+  int cell_width;
+  int cell_height;
+  int n_columns;
+  int n_rows;
+  int *cell_starts; /* n_columns * n_rows + 1 offsets into rects */
+  MetaRectangle *rects;
+};
+
+#define GRID_MAX_SIDE_CELLS 64
+
+static int get_grid_cells(int length, gint64 total, int n_rects,
+                          int *cell_length) {
+  int average, n_cells;
+
+  average = MAX(1, total / n_rects);
+  n_cells = CLAMP(length / average, 1, GRID_MAX_SIDE_CELLS);
+  *cell_length = (length + n_cells - 1) / n_cells;
+
+  return (length + *cell_length - 1) / *cell_length;
+}
+
+/* rect must be within the bounds of the grid, and not empty */
+static void get_grid_span(const MetaRectangleGrid *grid,
+                          const MetaRectangle *rect, int *first_column,
+                          int *last_column, int *first_row, int *last_row) {
+  *first_column = (rect->x - grid->bounds.x) / grid->cell_width;
+  *last_column = (BOX_RIGHT(*rect) - 1 - grid->bounds.x) / grid->cell_width;
+  *first_row = (rect->y - grid->bounds.y) / grid->cell_height;
+  *last_row = (BOX_BOTTOM(*rect) - 1 - grid->bounds.y) / grid->cell_height;
+}
+
+MetaRectangleGrid *meta_rectangle_grid_new(const MetaRectangle *rects,
+                                           int n_rects) {
+  MetaRectangleGrid *grid;
+  gint64 total_width, total_height;
+  int *cursors;
+  int n_used, n_cells, i;
+
+  grid = g_new0(MetaRectangleGrid, 1);
+
+  n_used = 0;
+  total_width = total_height = 0;
+  for (i = 0; i < n_rects; i++) {
+    /* Empty rectangles never intersect anything */
+    if (rects[i].width <= 0 || rects[i].height <= 0) continue;
+
+    if (n_used == 0)
+      grid->bounds = rects[i];
+    else
+      meta_rectangle_union(&grid->bounds, &rects[i], &grid->bounds);
+
+    total_width += rects[i].width;
+    total_height += rects[i].height;
+    n_used++;
+  }
+
+  if (n_used == 0) return grid;
+
+  grid->n_columns = get_grid_cells(grid->bounds.width, total_width, n_used,
+                                   &grid->cell_width);
+  grid->n_rows = get_grid_cells(grid->bounds.height, total_height, n_used,
+                                &grid->cell_height);
+  n_cells = grid->n_columns * grid->n_rows;
+
+  /* Count the rectangles in each cell, then place them */
+  grid->cell_starts = g_new0(int, n_cells + 1);
+  for (i = 0; i < n_rects; i++) {
+    int first_column, last_column, first_row, last_row, column, row;
+
+    if (rects[i].width <= 0 || rects[i].height <= 0) continue;
+
+    get_grid_span(grid, &rects[i], &first_column, &last_column, &first_row,
+                  &last_row);
+    for (row = first_row; row <= last_row; row++)
+      for (column = first_column; column <= last_column; column++)
+        grid->cell_starts[row * grid->n_columns + column + 1]++;
+  }
+
+  cursors = g_new(int, n_cells);
+  for (i = 0; i < n_cells; i++) {
+    grid->cell_starts[i + 1] += grid->cell_starts[i];
+    cursors[i] = grid->cell_starts[i];
+  }
+
+  grid->rects = g_new(MetaRectangle, grid->cell_starts[n_cells]);
+  for (i = 0; i < n_rects; i++) {
+    int first_column, last_column, first_row, last_row, column, row;
+
+    if (rects[i].width <= 0 || rects[i].height <= 0) continue;
+
+    get_grid_span(grid, &rects[i], &first_column, &last_column, &first_row,
+                  &last_row);
+    for (row = first_row; row <= last_row; row++)
+      for (column = first_column; column <= last_column; column++)
+        grid->rects[cursors[row * grid->n_columns + column]++] = rects[i];
+  }
+  g_free(cursors);
+
+  return grid;
+}
+
+void meta_rectangle_grid_free(MetaRectangleGrid *grid) {
+  g_free(grid->cell_starts);
+  g_free(grid->rects);
+  g_free(grid);
+}
+
+gboolean meta_rectangle_grid_overlaps(const MetaRectangleGrid *grid,
+                                      const MetaRectangle *rect) {
+  MetaRectangle clipped, overlap;
+  int first_column, last_column, first_row, last_row, column, row, i;
+
+  if (grid->rects == NULL ||
+      !meta_rectangle_intersect(rect, &grid->bounds, &clipped))
+    return FALSE;
+
+  get_grid_span(grid, &clipped, &first_column, &last_column, &first_row,
+                &last_row);
+  for (row = first_row; row <= last_row; row++) {
+    for (column = first_column; column <= last_column; column++) {
+      int cell = row * grid->n_columns + column;
+
+      for (i = grid->cell_starts[cell]; i < grid->cell_starts[cell + 1]; i++)
+        if (meta_rectangle_intersect(rect, &grid->rects[i], &overlap))
+          return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
 void meta_rectangle_resize_with_gravity(const MetaRectangle *old_rect,
                                         MetaRectangle *rect, int gravity,
                                         int new_width, int new_height) {
@@ -327,102 +466,102 @@ void meta_rectangle_resize_with_gravity(const MetaRectangle *old_rect,
   rect->height = new_height;
 }
 
+/* Copies each element of array into its own allocation, for the GList
+ * based functions, and frees array
+ */
+static GList *list_from_array(GArray *array) {
+  guint size = g_array_get_element_size(array);
+  GList *ret = NULL;
+  guint i;
+
+  for (i = array->len; i > 0; i--) {
+    gpointer element = g_malloc(size);
+
+    memcpy(element, array->data + (i - 1) * size, size);
+    ret = g_list_prepend(ret, element);
+  }
+  g_array_free(array, TRUE);
+
+  return ret;
+}
+
 /* Not so simple helper function for get_minimal_spanning_set_for_region() */
-static GList *merge_spanning_rects_in_region(GList *region) {
+static void merge_spanning_rects_in_region(GArray *region) {
   /* NOTE FOR ANY OPTIMIZATION PEOPLE OUT THERE: Please see the
    * documentation of get_minimal_spanning_set_for_region() for performance
    * considerations that also apply to this function.
    */
 
-  GList *compare;
-  compare = region;
+  guint compare, other;
 
-  if (region == NULL) {
+  if (region->len == 0) {
     meta_warning(
         "Region to merge was empty!  Either you have a some "
         "pathological STRUT list or there's a bug somewhere!\n");
-    return NULL;
+    return;
   }
 
-  while (compare && compare->next) {
-    MetaRectangle *a = compare->data;
-    GList *other = compare->next;
+  compare = 0;
+  while (compare + 1 < region->len) {
+    MetaRectangle *a = &g_array_index(region, MetaRectangle, compare);
 
     g_assert(a->width > 0 && a->height > 0);
 
-    while (other) {
-      MetaRectangle *b = other->data;
-      GList *delete_me = NULL;
+    other = compare + 1;
+    while (other < region->len) {
+      MetaRectangle *b = &g_array_index(region, MetaRectangle, other);
+      gboolean delete_a = FALSE;
+      gboolean delete_b = FALSE;
 
       g_assert(b->width > 0 && b->height > 0);
 
       /* If a contains b, just remove b */
       if (meta_rectangle_contains_rect(a, b)) {
-        delete_me = other;
+        delete_b = TRUE;
       }
       /* If b contains a, just remove a */
       else if (meta_rectangle_contains_rect(b, a)) {
-        delete_me = compare;
+        delete_a = TRUE;
       }
       /* If a and b might be mergeable horizontally */
       else if (a->y == b->y && a->height == b->height) {
-        /* If a and b overlap */
-        if (meta_rectangle_overlap(a, b)) {
-          int new_x = MIN(a->x, b->x);
-          a->width = MAX(a->x + a->width, b->x + b->width) - new_x;
-          a->x = new_x;
-          delete_me = other;
-        }
-        /* If a and b are adjacent */
-        else if (a->x + a->width == b->x || a->x == b->x + b->width) {
+        /* If a and b overlap or are adjacent */
+        if (meta_rectangle_overlap(a, b) || a->x + a->width == b->x ||
+            a->x == b->x + b->width) {
           int new_x = MIN(a->x, b->x);
           a->width = MAX(a->x + a->width, b->x + b->width) - new_x;
           a->x = new_x;
-          delete_me = other;
+          delete_b = TRUE;
         }
       }
       /* If a and b might be mergeable vertically */
       else if (a->x == b->x && a->width == b->width) {
-        /* If a and b overlap */
-        if (meta_rectangle_overlap(a, b)) {
-          int new_y = MIN(a->y, b->y);
-          a->height = MAX(a->y + a->height, b->y + b->height) - new_y;
-          a->y = new_y;
-          delete_me = other;
-        }
-        /* If a and b are adjacent */
-        else if (a->y + a->height == b->y || a->y == b->y + b->height) {
+        /* If a and b overlap or are adjacent */
+        if (meta_rectangle_overlap(a, b) || a->y + a->height == b->y ||
+            a->y == b->y + b->height) {
           int new_y = MIN(a->y, b->y);
           a->height = MAX(a->y + a->height, b->y + b->height) - new_y;
           a->y = new_y;
-          delete_me = other;
+          delete_b = TRUE;
         }
       }
 
-      other = other->next;
-
-      /* Delete any rectangle in the list that is no longer wanted */
-      if (delete_me != NULL) {
-        /* Deleting the rect we compare others to is a little tricker */
-        if (compare == delete_me) {
-          compare = compare->next;
-          other = compare->next;
-          a = compare->data;
-        }
-
-        /* avoid false positive warning in Clang static analyzer */
-        g_assert(a != delete_me->data);
-
-        /* Okay, we can free it now */
-        g_free(delete_me->data);
-        region = g_list_delete_link(region, delete_me);
+      /* Delete any rectangle that is no longer wanted, keeping the order
+       * of the others.  If it's a, compare the next one to the rest.
+       */
+      if (delete_a) {
+        g_array_remove_index(region, compare);
+        a = &g_array_index(region, MetaRectangle, compare);
+        other = compare + 1;
+      } else if (delete_b) {
+        g_array_remove_index(region, other);
+      } else {
+        other++;
       }
     }
 
-    compare = compare->next;
+    compare++;
   }
-
-  return region;
 }
 
 /* Simple helper function for get_minimal_spanning_set_for_region()... */
@@ -449,12 +588,10 @@ static gint compare_rect_areas(gconstpointer a, gconstpointer b) {
  * the region if and only if it is contained within at least one of the
  * rectangles.
  *
- * The GList* returned will be a list of (allocated) MetaRectangles.
- * The list will need to be freed by calling
- * meta_rectangle_free_spanning_set() on it (or by manually
- * implementing that function...)
+ * The GArray* returned holds the MetaRectangles; the rectangles are split
+ * and merged in place there rather than each being allocated separately.
  */
-GList *meta_rectangle_get_minimal_spanning_set_for_region(
+GArray *meta_rectangle_get_minimal_spanning_array_for_region(
     const MetaRectangle *basic_rect, const GSList *all_struts,
     gboolean skip_middle_struts)
 
@@ -462,19 +599,17 @@ GList *meta_rectangle_get_minimal_spanning_set_for_region(
   /* NOTE FOR OPTIMIZERS: This function *might* be somewhat slow,
    * especially due to the call to merge_spanning_rects_in_region() (which
    * is O(n^2) where n is the size of the list generated in this function).
-   * This is made more onerous due to the fact that it involves a fair
-   * number of memory allocation and deallocation calls.  However, n is 1
-   * for default installations of Mate (because partial struts aren't used
-   * by default and only partial struts increase the size of the spanning
-   * set generated).  With one partial strut, n will be 2 or 3.  With 2
-   * partial struts, n will probably be 4 or 5.  So, n probably isn't large
-   * enough to make this worth bothering.  Further, it is only called from
-   * workspace.c:ensure_work_areas_validated (at least as of the time of
-   * writing this comment), which in turn should only be called if the
-   * strut list changes or the screen or xinerama size changes.  If it ever
-   * does show up on profiles (most likely because people start using
-   * ridiculously huge numbers of partial struts), possible optimizations
-   * include:
+   * However, n is 1 for default installations of Mate (because partial
+   * struts aren't used by default and only partial struts increase the
+   * size of the spanning set generated).  With one partial strut, n will
+   * be 2 or 3.  With 2 partial struts, n will probably be 4 or 5.  So, n
+   * probably isn't large enough to make this worth bothering.  Further,
+   * it is only called from workspace.c:ensure_work_areas_validated (at
+   * least as of the time of writing this comment), which in turn should
+   * only be called if the strut list changes or the screen or xinerama
+   * size changes.  If it ever does show up on profiles (most likely
+   * because people start using ridiculously huge numbers of partial
+   * struts), possible optimizations include:
    *
    * (1) rewrite merge_spanning_rects_in_region() to be O(n) or O(nlogn).
    *     I'm not totally sure it's possible, but with a couple copies of
@@ -495,10 +630,12 @@ GList *meta_rectangle_get_minimal_spanning_set_for_region(
    *     URL splitting.)
    */
 
-  GList *ret;
-  GList *tmp_list;
+  GArray *ret;
+  GArray *pieces;
+  GArray *temp;
   const GSList *strut_iter;
-  MetaRectangle *temp_rect;
+  MetaRectangle temp_rect;
+  int i;
 
   /* The algorithm is basically as follows:
    *   Initialize rectangle_set to basic_rect
@@ -511,12 +648,11 @@ GList *meta_rectangle_get_minimal_spanning_set_for_region(
    *         splitting
    */
 
-  temp_rect = g_new(MetaRectangle, 1);
-  *temp_rect = *basic_rect;
-  ret = g_list_prepend(NULL, temp_rect);
+  ret = g_array_new(FALSE, FALSE, sizeof(MetaRectangle));
+  pieces = g_array_new(FALSE, FALSE, sizeof(MetaRectangle));
+  g_array_append_val(ret, *basic_rect);
 
   for (strut_iter = all_struts; strut_iter; strut_iter = strut_iter->next) {
-    GList *rect_iter;
     MetaStrut *strut = (MetaStrut *)strut_iter->data;
     MetaRectangle *strut_rect = &strut->rect;
 
@@ -531,64 +667,69 @@ GList *meta_rectangle_get_minimal_spanning_set_for_region(
       }
     }
 
-    tmp_list = ret;
-    ret = NULL;
-    rect_iter = tmp_list;
-    while (rect_iter) {
-      MetaRectangle *rect = (MetaRectangle *)rect_iter->data;
-      if (!meta_rectangle_overlap(rect, strut_rect))
-        ret = g_list_prepend(ret, rect);
-      else {
-        /* If there is area in rect left of strut */
-        if (BOX_LEFT(*rect) < BOX_LEFT(*strut_rect)) {
-          temp_rect = g_new(MetaRectangle, 1);
-          *temp_rect = *rect;
-          temp_rect->width = BOX_LEFT(*strut_rect) - BOX_LEFT(*rect);
-          ret = g_list_prepend(ret, temp_rect);
-        }
-        /* If there is area in rect right of strut */
-        if (BOX_RIGHT(*rect) > BOX_RIGHT(*strut_rect)) {
-          int new_x;
-          temp_rect = g_new(MetaRectangle, 1);
-          *temp_rect = *rect;
-          new_x = BOX_RIGHT(*strut_rect);
-          temp_rect->width = BOX_RIGHT(*rect) - new_x;
-          temp_rect->x = new_x;
-          ret = g_list_prepend(ret, temp_rect);
-        }
-        /* If there is area in rect above strut */
-        if (BOX_TOP(*rect) < BOX_TOP(*strut_rect)) {
-          temp_rect = g_new(MetaRectangle, 1);
-          *temp_rect = *rect;
-          temp_rect->height = BOX_TOP(*strut_rect) - BOX_TOP(*rect);
-          ret = g_list_prepend(ret, temp_rect);
-        }
-        /* If there is area in rect below strut */
-        if (BOX_BOTTOM(*rect) > BOX_BOTTOM(*strut_rect)) {
-          int new_y;
-          temp_rect = g_new(MetaRectangle, 1);
-          *temp_rect = *rect;
-          new_y = BOX_BOTTOM(*strut_rect);
-          temp_rect->height = BOX_BOTTOM(*rect) - new_y;
-          temp_rect->y = new_y;
-          ret = g_list_prepend(ret, temp_rect);
-        }
-        g_free(rect);
+    /* A strut outside of basic_rect can't split anything */
+    if (!meta_rectangle_overlap(basic_rect, strut_rect)) continue;
+
+    /* The new rectangles are collected from the last to the first,
+     * which decides the order of equal-area rectangles after sorting.
+     */
+    g_array_set_size(pieces, 0);
+    for (i = (int)ret->len - 1; i >= 0; i--) {
+      MetaRectangle rect = g_array_index(ret, MetaRectangle, i);
+      if (!meta_rectangle_overlap(&rect, strut_rect)) {
+        g_array_append_val(pieces, rect);
+        continue;
+      }
+      /* If there is area in rect below strut */
+      if (BOX_BOTTOM(rect) > BOX_BOTTOM(*strut_rect)) {
+        temp_rect = rect;
+        temp_rect.y = BOX_BOTTOM(*strut_rect);
+        temp_rect.height = BOX_BOTTOM(rect) - temp_rect.y;
+        g_array_append_val(pieces, temp_rect);
+      }
+      /* If there is area in rect above strut */
+      if (BOX_TOP(rect) < BOX_TOP(*strut_rect)) {
+        temp_rect = rect;
+        temp_rect.height = BOX_TOP(*strut_rect) - BOX_TOP(rect);
+        g_array_append_val(pieces, temp_rect);
+      }
+      /* If there is area in rect right of strut */
+      if (BOX_RIGHT(rect) > BOX_RIGHT(*strut_rect)) {
+        temp_rect = rect;
+        temp_rect.x = BOX_RIGHT(*strut_rect);
+        temp_rect.width = BOX_RIGHT(rect) - temp_rect.x;
+        g_array_append_val(pieces, temp_rect);
+      }
+      /* If there is area in rect left of strut */
+      if (BOX_LEFT(rect) < BOX_LEFT(*strut_rect)) {
+        temp_rect = rect;
+        temp_rect.width = BOX_LEFT(*strut_rect) - BOX_LEFT(rect);
+        g_array_append_val(pieces, temp_rect);
       }
-      rect_iter = rect_iter->next;
     }
-    g_list_free(tmp_list);
+
+    temp = ret;
+    ret = pieces;
+    pieces = temp;
   }
+  g_array_free(pieces, TRUE);
 
   /* Sort by maximal area, just because I feel like it... */
-  ret = g_list_sort(ret, compare_rect_areas);
+  g_array_sort(ret, compare_rect_areas);
 
   /* Merge rectangles if possible so that the list really is minimal */
-  ret = merge_spanning_rects_in_region(ret);
+  merge_spanning_rects_in_region(ret);
 
   return ret;
 }
 
+GList *meta_rectangle_get_minimal_spanning_set_for_region(
+    const MetaRectangle *basic_rect, const GSList *all_struts,
+    gboolean skip_middle_struts) {
+  return list_from_array(meta_rectangle_get_minimal_spanning_array_for_region(
+      basic_rect, all_struts, skip_middle_struts));
+}
+
 GList *meta_rectangle_expand_region(GList *region, const int left_expand,
                                     const int right_expand,
                                     const int top_expand,
@@ -1020,70 +1161,43 @@ gboolean meta_rectangle_edge_aligns(const MetaRectangle *rect,
   }
 }
 
-static GList *get_rect_minus_overlap(const GList *rect_in_list,
-                                     MetaRectangle *overlap) {
-  MetaRectangle *temp;
-  MetaRectangle *rect = rect_in_list->data;
-  GList *ret = NULL;
+/* Appends the parts of rect outside of overlap to ret, last first */
+static void get_rect_minus_overlap(const MetaRectangle *rect,
+                                   const MetaRectangle *overlap, GArray *ret) {
+  MetaRectangle temp;
 
-  if (BOX_LEFT(*rect) < BOX_LEFT(*overlap)) {
-    temp = g_new(MetaRectangle, 1);
-    *temp = *rect;
-    temp->width = BOX_LEFT(*overlap) - BOX_LEFT(*rect);
-    ret = g_list_prepend(ret, temp);
-  }
-  if (BOX_RIGHT(*rect) > BOX_RIGHT(*overlap)) {
-    temp = g_new(MetaRectangle, 1);
-    *temp = *rect;
-    temp->x = BOX_RIGHT(*overlap);
-    temp->width = BOX_RIGHT(*rect) - BOX_RIGHT(*overlap);
-    ret = g_list_prepend(ret, temp);
+  if (BOX_BOTTOM(*rect) > BOX_BOTTOM(*overlap)) {
+    temp.x = overlap->x;
+    temp.width = overlap->width;
+    temp.y = BOX_BOTTOM(*overlap);
+    temp.height = BOX_BOTTOM(*rect) - BOX_BOTTOM(*overlap);
+    g_array_append_val(ret, temp);
   }
   if (BOX_TOP(*rect) < BOX_TOP(*overlap)) {
-    temp = g_new(MetaRectangle, 1);
-    temp->x = overlap->x;
-    temp->width = overlap->width;
-    temp->y = BOX_TOP(*rect);
-    temp->height = BOX_TOP(*overlap) - BOX_TOP(*rect);
-    ret = g_list_prepend(ret, temp);
+    temp.x = overlap->x;
+    temp.width = overlap->width;
+    temp.y = BOX_TOP(*rect);
+    temp.height = BOX_TOP(*overlap) - BOX_TOP(*rect);
+    g_array_append_val(ret, temp);
   }
-  if (BOX_BOTTOM(*rect) > BOX_BOTTOM(*overlap)) {
-    temp = g_new(MetaRectangle, 1);
-    temp->x = overlap->x;
-    temp->width = overlap->width;
-    temp->y = BOX_BOTTOM(*overlap);
-    temp->height = BOX_BOTTOM(*rect) - BOX_BOTTOM(*overlap);
-    ret = g_list_prepend(ret, temp);
+  if (BOX_RIGHT(*rect) > BOX_RIGHT(*overlap)) {
+    temp = *rect;
+    temp.x = BOX_RIGHT(*overlap);
+    temp.width = BOX_RIGHT(*rect) - BOX_RIGHT(*overlap);
+    g_array_append_val(ret, temp);
   }
-
-  return ret;
-}
-
-static GList *replace_rect_with_list(GList *old_element, GList *new_list) {
-  GList *ret;
-  g_assert(old_element != NULL);
-
-  if (!new_list) {
-    /* If there is no new list, just remove the old_element */
-    ret = g_list_remove_link(old_element, old_element);
-  } else {
-    /* Fix up the prev and next pointers everywhere */
-    ret = new_list;
-    if (old_element->prev) {
-      old_element->prev->next = new_list;
-      new_list->prev = old_element->prev;
-    }
-    if (old_element->next) {
-      GList *tmp = g_list_last(new_list);
-      old_element->next->prev = tmp;
-      tmp->next = old_element->next;
-    }
+  if (BOX_LEFT(*rect) < BOX_LEFT(*overlap)) {
+    temp = *rect;
+    temp.width = BOX_LEFT(*overlap) - BOX_LEFT(*rect);
+    g_array_append_val(ret, temp);
   }
+}
 
-  /* Free the old_element and return the appropriate "next" point */
-  g_free(old_element->data);
-  g_list_free_1(old_element);
-  return ret;
+static void replace_rect_with_array(GArray *rects, guint index,
+                                    const GArray *new_rects) {
+  g_array_remove_index(rects, index);
+  if (new_rects->len > 0)
+    g_array_insert_vals(rects, index, new_rects->data, new_rects->len);
 }
 
 /* Make a copy of the strut list, make sure that copy only contains parts
@@ -1092,21 +1206,21 @@ static GList *replace_rect_with_list(GList *old_element, GList *new_list) {
  * that aren't disjoint in a way that the overlapping part is only included
  * once, so it's not really magic...).
  */
-static GList *get_disjoint_strut_rect_list_in_region(
+static GArray *get_disjoint_strut_rect_array_in_region(
     const GSList *old_struts, const MetaRectangle *region) {
-  GList *strut_rects;
-  GList *tmp;
+  GArray *strut_rects;
+  GArray *cur_leftover;
+  GArray *comp_leftover;
+  guint tmp, compare;
 
-  /* First, copy the list */
-  strut_rects = NULL;
+  /* First, copy the list, last strut first */
+  strut_rects = g_array_new(FALSE, FALSE, sizeof(MetaRectangle));
   while (old_struts) {
     MetaRectangle *cur = &((MetaStrut *)old_struts->data)->rect;
-    MetaRectangle *copy = g_new(MetaRectangle, 1);
-    *copy = *cur;
-    if (meta_rectangle_intersect(copy, region, copy))
-      strut_rects = g_list_prepend(strut_rects, copy);
-    else
-      g_free(copy);
+    MetaRectangle copy;
+
+    if (meta_rectangle_intersect(cur, region, &copy))
+      g_array_prepend_val(strut_rects, copy);
 
     old_struts = old_struts->next;
   }
@@ -1114,47 +1228,36 @@ static GList *get_disjoint_strut_rect_list_in_region(
   /* Now, loop over the list and check for intersections, fixing things up
    * where they do intersect.
    */
-  tmp = strut_rects;
-  while (tmp) {
-    GList *compare;
-
-    MetaRectangle *cur = tmp->data;
-
-    compare = tmp->next;
-    while (compare) {
-      MetaRectangle *comp = compare->data;
+  cur_leftover = g_array_new(FALSE, FALSE, sizeof(MetaRectangle));
+  comp_leftover = g_array_new(FALSE, FALSE, sizeof(MetaRectangle));
+  for (tmp = 0; tmp < strut_rects->len; tmp++) {
+    for (compare = tmp + 1; compare < strut_rects->len; compare++) {
+      MetaRectangle cur = g_array_index(strut_rects, MetaRectangle, tmp);
+      MetaRectangle comp = g_array_index(strut_rects, MetaRectangle, compare);
       MetaRectangle overlap;
 
-      if (meta_rectangle_intersect(cur, comp, &overlap)) {
-        /* Get a list of rectangles for each strut that don't overlap
-         * the intersection region.
-         */
-        GList *cur_leftover = get_rect_minus_overlap(tmp, &overlap);
-        GList *comp_leftover = get_rect_minus_overlap(compare, &overlap);
-
-        /* Add the intersection region to cur_leftover */
-        MetaRectangle *overlap_allocated = g_new(MetaRectangle, 1);
-        *overlap_allocated = overlap;
-        cur_leftover = g_list_prepend(cur_leftover, overlap_allocated);
-
-        /* Fix up tmp, compare, and cur -- maybe struts too */
-        if (strut_rects == tmp) {
-          strut_rects = replace_rect_with_list(tmp, cur_leftover);
-          tmp = strut_rects;
-        } else
-          tmp = replace_rect_with_list(tmp, cur_leftover);
-        compare = replace_rect_with_list(compare, comp_leftover);
-
-        if (compare == NULL) break;
+      if (!meta_rectangle_intersect(&cur, &comp, &overlap)) continue;
 
-        cur = tmp->data;
-      }
-
-      compare = compare->next;
+      /* Get the rectangles for each strut that don't overlap the
+       * intersection region, putting the intersection region first
+       * among cur's.
+       */
+      g_array_set_size(cur_leftover, 0);
+      g_array_append_val(cur_leftover, overlap);
+      get_rect_minus_overlap(&cur, &overlap, cur_leftover);
+      g_array_set_size(comp_leftover, 0);
+      get_rect_minus_overlap(&comp, &overlap, comp_leftover);
+
+      /* Replace both; tmp then indexes the intersection region, and the
+       * loop goes on after whatever took the place of comp.
+       */
+      replace_rect_with_array(strut_rects, tmp, cur_leftover);
+      compare += cur_leftover->len - 1;
+      replace_rect_with_array(strut_rects, compare, comp_leftover);
     }
-
-    tmp = tmp->next;
   }
+  g_array_free(cur_leftover, TRUE);
+  g_array_free(comp_leftover, TRUE);
 
   return strut_rects;
 }
@@ -1298,107 +1401,117 @@ static gboolean rectangle_and_edge_intersection(const MetaRectangle *rect,
   return intersect;
 }
 
-/* Add all edges of the given rect to cur_edges and return the result.  If
+/* Add all edges of the given rect to cur_edges, bottom edge first.  If
  * rect_is_internal is false, the side types are switched (LEFT<->RIGHT and
  * TOP<->BOTTOM).
  */
-static GList *add_edges(GList *cur_edges, const MetaRectangle *rect,
-                        gboolean rect_is_internal) {
-  MetaEdge *temp_edge;
+static void add_edges(GArray *cur_edges, const MetaRectangle *rect,
+                      gboolean rect_is_internal) {
+  MetaEdge temp_edge;
   int i;
 
-  for (i = 0; i < 4; i++) {
-    temp_edge = g_new(MetaEdge, 1);
-    temp_edge->rect = *rect;
+  for (i = 3; i >= 0; i--) {
+    temp_edge.rect = *rect;
     switch (i) {
       case 0:
-        temp_edge->side_type =
+        temp_edge.side_type =
             rect_is_internal ? META_SIDE_LEFT : META_SIDE_RIGHT;
-        temp_edge->rect.width = 0;
+        temp_edge.rect.width = 0;
         break;
       case 1:
-        temp_edge->side_type =
+        temp_edge.side_type =
             rect_is_internal ? META_SIDE_RIGHT : META_SIDE_LEFT;
-        temp_edge->rect.x += temp_edge->rect.width;
-        temp_edge->rect.width = 0;
+        temp_edge.rect.x += temp_edge.rect.width;
+        temp_edge.rect.width = 0;
         break;
       case 2:
-        temp_edge->side_type =
+        temp_edge.side_type =
             rect_is_internal ? META_SIDE_TOP : META_SIDE_BOTTOM;
-        temp_edge->rect.height = 0;
+        temp_edge.rect.height = 0;
         break;
       case 3:
-        temp_edge->side_type =
+        temp_edge.side_type =
             rect_is_internal ? META_SIDE_BOTTOM : META_SIDE_TOP;
-        temp_edge->rect.y += temp_edge->rect.height;
-        temp_edge->rect.height = 0;
+        temp_edge.rect.y += temp_edge.rect.height;
+        temp_edge.rect.height = 0;
         break;
     }
-    temp_edge->edge_type = META_EDGE_SCREEN;
-    cur_edges = g_list_prepend(cur_edges, temp_edge);
+    temp_edge.edge_type = META_EDGE_SCREEN;
+    g_array_append_val(cur_edges, temp_edge);
   }
-
-  return cur_edges;
 }
 
-/* Remove any part of old_edge that intersects remove and add any resulting
- * edges to cur_list.  Return cur_list when finished.
+/* Remove any part of old_edge that intersects remove and append any
+ * resulting edges to pieces.
  */
-static GList *split_edge(GList *cur_list, const MetaEdge *old_edge,
-                         const MetaEdge *remove) {
-  MetaEdge *temp_edge;
+static void split_edge(GArray *pieces, const MetaEdge *old_edge,
+                       const MetaEdge *remove) {
+  MetaEdge temp_edge;
   switch (old_edge->side_type) {
     case META_SIDE_LEFT:
     case META_SIDE_RIGHT:
       g_assert(meta_rectangle_vert_overlap(&old_edge->rect, &remove->rect));
       if (BOX_TOP(old_edge->rect) < BOX_TOP(remove->rect)) {
-        temp_edge = g_new(MetaEdge, 1);
-        *temp_edge = *old_edge;
-        temp_edge->rect.height =
-            BOX_TOP(remove->rect) - BOX_TOP(old_edge->rect);
-        cur_list = g_list_prepend(cur_list, temp_edge);
+        temp_edge = *old_edge;
+        temp_edge.rect.height = BOX_TOP(remove->rect) - BOX_TOP(old_edge->rect);
+        g_array_append_val(pieces, temp_edge);
       }
       if (BOX_BOTTOM(old_edge->rect) > BOX_BOTTOM(remove->rect)) {
-        temp_edge = g_new(MetaEdge, 1);
-        *temp_edge = *old_edge;
-        temp_edge->rect.y = BOX_BOTTOM(remove->rect);
-        temp_edge->rect.height =
+        temp_edge = *old_edge;
+        temp_edge.rect.y = BOX_BOTTOM(remove->rect);
+        temp_edge.rect.height =
             BOX_BOTTOM(old_edge->rect) - BOX_BOTTOM(remove->rect);
-        cur_list = g_list_prepend(cur_list, temp_edge);
+        g_array_append_val(pieces, temp_edge);
       }
       break;
     case META_SIDE_TOP:
     case META_SIDE_BOTTOM:
       g_assert(meta_rectangle_horiz_overlap(&old_edge->rect, &remove->rect));
       if (BOX_LEFT(old_edge->rect) < BOX_LEFT(remove->rect)) {
-        temp_edge = g_new(MetaEdge, 1);
-        *temp_edge = *old_edge;
-        temp_edge->rect.width =
+        temp_edge = *old_edge;
+        temp_edge.rect.width =
             BOX_LEFT(remove->rect) - BOX_LEFT(old_edge->rect);
-        cur_list = g_list_prepend(cur_list, temp_edge);
+        g_array_append_val(pieces, temp_edge);
       }
       if (BOX_RIGHT(old_edge->rect) > BOX_RIGHT(remove->rect)) {
-        temp_edge = g_new(MetaEdge, 1);
-        *temp_edge = *old_edge;
-        temp_edge->rect.x = BOX_RIGHT(remove->rect);
-        temp_edge->rect.width =
+        temp_edge = *old_edge;
+        temp_edge.rect.x = BOX_RIGHT(remove->rect);
+        temp_edge.rect.width =
             BOX_RIGHT(old_edge->rect) - BOX_RIGHT(remove->rect);
-        cur_list = g_list_prepend(cur_list, temp_edge);
+        g_array_append_val(pieces, temp_edge);
       }
       break;
     default:
       g_assert_not_reached();
   }
+}
+
+/* Moves pieces to the start of edges, last piece first, and empties
+ * pieces
+ */
+static void prepend_pieces(GArray *edges, GArray *pieces) {
+  guint i;
+
+  if (pieces->len == 0) return;
+
+  for (i = 0; i < pieces->len / 2; i++) {
+    MetaEdge *a = &g_array_index(pieces, MetaEdge, i);
+    MetaEdge *b = &g_array_index(pieces, MetaEdge, pieces->len - 1 - i);
+    MetaEdge temp = *a;
 
-  return cur_list;
+    *a = *b;
+    *b = temp;
+  }
+  g_array_prepend_vals(edges, pieces->data, pieces->len);
+  g_array_set_size(pieces, 0);
 }
 
 /* Split up edge and remove preliminary edges from strut_edges depending on
- * if and how rect and edge intersect.
+ * if and how rect and edge intersect.  pieces is just scratch space.
  */
 static void fix_up_edges(MetaRectangle *rect, MetaEdge *edge,
-                         GList **strut_edges, GList **edge_splits,
-                         gboolean *edge_needs_removal) {
+                         GArray *strut_edges, GArray *edge_splits,
+                         GArray *pieces, gboolean *edge_needs_removal) {
   MetaEdge overlap;
   int handle_type;
 
@@ -1407,51 +1520,54 @@ static void fix_up_edges(MetaRectangle *rect, MetaEdge *edge,
 
   if (handle_type == 0 || handle_type == 1) {
     /* Put the result of removing overlap from edge into edge_splits */
-    *edge_splits = split_edge(*edge_splits, edge, &overlap);
+    split_edge(edge_splits, edge, &overlap);
     *edge_needs_removal = TRUE;
   }
 
   if (handle_type == -1 || handle_type == 1) {
     /* Remove the overlap from strut_edges */
+    guint i, n_kept;
+
     /* First, loop over the edges of the strut */
-    GList *tmp = *strut_edges;
-    while (tmp) {
-      MetaEdge *cur = tmp->data;
+    n_kept = 0;
+    for (i = 0; i < strut_edges->len; i++) {
+      MetaEdge *cur = &g_array_index(strut_edges, MetaEdge, i);
+
       /* If this is the edge that overlaps, then we need to split it */
-      if (edges_overlap(cur, &overlap)) {
-        GList *delete_me = tmp;
-
-        /* Split this edge into some new ones */
-        *strut_edges = split_edge(*strut_edges, cur, &overlap);
-
-        /* Delete the old one */
-        tmp = tmp->next;
-        g_free(cur);
-        *strut_edges = g_list_delete_link(*strut_edges, delete_me);
-      } else
-        tmp = tmp->next;
+      if (edges_overlap(cur, &overlap))
+        split_edge(pieces, cur, &overlap);
+      else
+        g_array_index(strut_edges, MetaEdge, n_kept++) = *cur;
     }
+    g_array_set_size(strut_edges, n_kept);
+
+    /* The new ones go first */
+    prepend_pieces(strut_edges, pieces);
   }
 }
 
 /* This function removes intersections of edges with the rectangles from the
- * list of edges.
+ * array of edges.
  */
-GList *meta_rectangle_remove_intersections_with_boxes_from_edges(
-    GList *edges, const GSList *rectangles) {
+void meta_rectangle_remove_intersections_with_boxes_from_edge_array(
+    GArray *edges, const GSList *rectangles) {
   const GSList *rect_iter;
+  GArray *pieces;
   const int opposing = 1;
 
+  pieces = g_array_new(FALSE, FALSE, sizeof(MetaEdge));
+
   /* Now remove all intersections of rectangles with the edge list */
   rect_iter = rectangles;
   while (rect_iter) {
     MetaRectangle *rect = rect_iter->data;
-    GList *edge_iter = edges;
-    while (edge_iter) {
-      MetaEdge *edge = edge_iter->data;
+    guint i, n_kept;
+
+    n_kept = 0;
+    for (i = 0; i < edges->len; i++) {
+      MetaEdge *edge = &g_array_index(edges, MetaEdge, i);
       MetaEdge overlap;
       int handle;
-      gboolean edge_iter_advanced = FALSE;
 
       /* If this edge overlaps with this rect... */
       if (rectangle_and_edge_intersection(rect, edge, &overlap, &handle)) {
@@ -1468,36 +1584,50 @@ GList *meta_rectangle_remove_intersections_with_boxes_from_edges(
          * edge should be split.
          */
         if (handle != opposing) {
-          /* Keep track of this edge so we can delete it below */
-          GList *delete_me = edge_iter;
-          edge_iter = edge_iter->next;
-          edge_iter_advanced = TRUE;
-
-          /* Split the edge and add the result to beginning of edges */
-          edges = split_edge(edges, edge, &overlap);
-
-          /* Now free the edge... */
-          g_free(edge);
-          edges = g_list_delete_link(edges, delete_me);
+          /* Split the edge, dropping it */
+          split_edge(pieces, edge, &overlap);
+          continue;
         }
       }
 
-      if (!edge_iter_advanced) edge_iter = edge_iter->next;
+      g_array_index(edges, MetaEdge, n_kept++) = *edge;
     }
+    g_array_set_size(edges, n_kept);
+
+    /* Add the result of the splits to the beginning of edges */
+    prepend_pieces(edges, pieces);
 
     rect_iter = rect_iter->next;
   }
 
-  return edges;
+  g_array_free(pieces, TRUE);
+}
+
+GList *meta_rectangle_remove_intersections_with_boxes_from_edges(
+    GList *edges, const GSList *rectangles) {
+  GArray *array;
+  GList *tmp;
+
+  array = g_array_new(FALSE, FALSE, sizeof(MetaEdge));
+  for (tmp = edges; tmp != NULL; tmp = tmp->next)
+    g_array_append_vals(array, tmp->data, 1);
+  g_list_free_full(edges, g_free);
+
+  meta_rectangle_remove_intersections_with_boxes_from_edge_array(array,
+                                                                 rectangles);
+
+  return list_from_array(array);
 }
 
 /* This function is trying to find all the edges of an onscreen region. */
-GList *meta_rectangle_find_onscreen_edges(const MetaRectangle *basic_rect,
-                                          const GSList *all_struts) {
-  GList *ret;
-  GList *fixed_strut_rects;
-  GList *edge_iter;
-  const GList *strut_rect_iter;
+GArray *meta_rectangle_find_onscreen_edge_array(const MetaRectangle *basic_rect,
+                                                const GSList *all_struts) {
+  GArray *ret;
+  GArray *fixed_strut_rects;
+  GArray *new_strut_edges;
+  GArray *splits;
+  GArray *pieces;
+  guint i, j, n_kept;
 
   /* The algorithm is basically as follows:
    *   Make sure the struts are disjoint
@@ -1516,57 +1646,61 @@ GList *meta_rectangle_find_onscreen_edges(const MetaRectangle *basic_rect,
 
   /* Make sure the struts are disjoint */
   fixed_strut_rects =
-      get_disjoint_strut_rect_list_in_region(all_struts, basic_rect);
+      get_disjoint_strut_rect_array_in_region(all_struts, basic_rect);
 
   /* Start off the list with the edges of basic_rect */
-  ret = add_edges(NULL, basic_rect, TRUE);
+  ret = g_array_new(FALSE, FALSE, sizeof(MetaEdge));
+  add_edges(ret, basic_rect, TRUE);
+
+  new_strut_edges = g_array_new(FALSE, FALSE, sizeof(MetaEdge));
+  splits = g_array_new(FALSE, FALSE, sizeof(MetaEdge));
+  pieces = g_array_new(FALSE, FALSE, sizeof(MetaEdge));
 
-  strut_rect_iter = fixed_strut_rects;
-  while (strut_rect_iter) {
-    MetaRectangle *strut_rect = (MetaRectangle *)strut_rect_iter->data;
+  for (i = 0; i < fixed_strut_rects->len; i++) {
+    MetaRectangle *strut_rect =
+        &g_array_index(fixed_strut_rects, MetaRectangle, i);
 
     /* Get the new possible edges we may need to add from the strut */
-    GList *new_strut_edges = add_edges(NULL, strut_rect, FALSE);
+    g_array_set_size(new_strut_edges, 0);
+    add_edges(new_strut_edges, strut_rect, FALSE);
 
-    edge_iter = ret;
-    while (edge_iter) {
-      MetaEdge *cur_edge = edge_iter->data;
-      GList *splits_of_cur_edge = NULL;
+    n_kept = 0;
+    for (j = 0; j < ret->len; j++) {
+      MetaEdge *cur_edge = &g_array_index(ret, MetaEdge, j);
       gboolean edge_needs_removal = FALSE;
 
-      fix_up_edges(strut_rect, cur_edge, &new_strut_edges, &splits_of_cur_edge,
+      fix_up_edges(strut_rect, cur_edge, new_strut_edges, splits, pieces,
                    &edge_needs_removal);
 
-      if (edge_needs_removal) {
-        /* Delete the old edge */
-        GList *delete_me = edge_iter;
-        edge_iter = edge_iter->next;
-        g_free(cur_edge);
-        ret = g_list_delete_link(ret, delete_me);
-
-        /* Add the new split parts of the edge */
-        ret = g_list_concat(splits_of_cur_edge, ret);
-      } else {
-        edge_iter = edge_iter->next;
-      }
-
-      /* edge_iter was already advanced above */
+      /* Drop the old edge if it was split */
+      if (!edge_needs_removal)
+        g_array_index(ret, MetaEdge, n_kept++) = *cur_edge;
     }
+    g_array_set_size(ret, n_kept);
 
-    ret = g_list_concat(new_strut_edges, ret);
-    strut_rect_iter = strut_rect_iter->next;
+    /* Add the new split parts of the edges, and then the strut's edges */
+    prepend_pieces(ret, splits);
+    g_array_prepend_vals(ret, new_strut_edges->data, new_strut_edges->len);
   }
 
   /* Sort the list */
-  ret = g_list_sort(ret, meta_rectangle_edge_cmp);
+  g_array_sort(ret, meta_rectangle_edge_cmp);
 
-  /* Free the fixed struts list */
-  g_list_free_full(fixed_strut_rects, g_free);
+  g_array_free(pieces, TRUE);
+  g_array_free(splits, TRUE);
+  g_array_free(new_strut_edges, TRUE);
+  g_array_free(fixed_strut_rects, TRUE);
 
   return ret;
 }
 
-GList *meta_rectangle_find_nonintersected_xinerama_edges(
+GList *meta_rectangle_find_onscreen_edges(const MetaRectangle *basic_rect,
+                                          const GSList *all_struts) {
+  return list_from_array(
+      meta_rectangle_find_onscreen_edge_array(basic_rect, all_struts));
+}
+
+GArray *meta_rectangle_find_nonintersected_xinerama_edge_array(
     const MetaRectangle *screen_rect, const GList *xinerama_rects,
     const GSList *all_struts) {
   /* This function cannot easily be merged with
@@ -1574,12 +1708,14 @@ GList *meta_rectangle_find_nonintersected_xinerama_edges(
    * and strut edges both are of the type "there ain't anything
    * immediately on the other side"; xinerama edges are different.
    */
-  GList *ret;
+  GArray *ret;
+  GArray *new_edges;
   const GList *cur;
   GSList *temp_rects;
 
   /* Initialize the return list to be empty */
-  ret = NULL;
+  ret = g_array_new(FALSE, FALSE, sizeof(MetaEdge));
+  new_edges = g_array_new(FALSE, FALSE, sizeof(MetaEdge));
 
   /* start of ret with all the edges of xineramas that are adjacent to
    * another xinerama.
@@ -1587,52 +1723,57 @@ GList *meta_rectangle_find_nonintersected_xinerama_edges(
   cur = xinerama_rects;
   while (cur) {
     MetaRectangle *cur_rect = cur->data;
-    MetaEdge *new_edge;
+    MetaEdge new_edge;
     if (BOX_LEFT(*cur_rect) != BOX_LEFT(*screen_rect)) {
-      new_edge = g_new(MetaEdge, 1);
-      new_edge->rect = meta_rect(BOX_LEFT(*cur_rect), BOX_TOP(*cur_rect), 0,
-                                 cur_rect->height);
-      new_edge->side_type = META_SIDE_LEFT;
-      new_edge->edge_type = META_EDGE_XINERAMA;
-      ret = g_list_prepend(ret, new_edge);
+      new_edge.rect = meta_rect(BOX_LEFT(*cur_rect), BOX_TOP(*cur_rect), 0,
+                                cur_rect->height);
+      new_edge.side_type = META_SIDE_LEFT;
+      new_edge.edge_type = META_EDGE_XINERAMA;
+      g_array_append_val(new_edges, new_edge);
     }
     if (BOX_RIGHT(*cur_rect) != BOX_RIGHT(*screen_rect)) {
-      new_edge = g_new(MetaEdge, 1);
-      new_edge->rect = meta_rect(BOX_RIGHT(*cur_rect), BOX_TOP(*cur_rect), 0,
-                                 cur_rect->height);
-      new_edge->side_type = META_SIDE_RIGHT;
-      new_edge->edge_type = META_EDGE_XINERAMA;
-      ret = g_list_prepend(ret, new_edge);
+      new_edge.rect = meta_rect(BOX_RIGHT(*cur_rect), BOX_TOP(*cur_rect), 0,
+                                cur_rect->height);
+      new_edge.side_type = META_SIDE_RIGHT;
+      new_edge.edge_type = META_EDGE_XINERAMA;
+      g_array_append_val(new_edges, new_edge);
     }
     if (BOX_TOP(*cur_rect) != BOX_TOP(*screen_rect)) {
-      new_edge = g_new(MetaEdge, 1);
-      new_edge->rect = meta_rect(BOX_LEFT(*cur_rect), BOX_TOP(*cur_rect),
-                                 cur_rect->width, 0);
-      new_edge->side_type = META_SIDE_TOP;
-      new_edge->edge_type = META_EDGE_XINERAMA;
-      ret = g_list_prepend(ret, new_edge);
+      new_edge.rect = meta_rect(BOX_LEFT(*cur_rect), BOX_TOP(*cur_rect),
+                                cur_rect->width, 0);
+      new_edge.side_type = META_SIDE_TOP;
+      new_edge.edge_type = META_EDGE_XINERAMA;
+      g_array_append_val(new_edges, new_edge);
     }
     if (BOX_BOTTOM(*cur_rect) != BOX_BOTTOM(*screen_rect)) {
-      new_edge = g_new(MetaEdge, 1);
-      new_edge->rect = meta_rect(BOX_LEFT(*cur_rect), BOX_BOTTOM(*cur_rect),
-                                 cur_rect->width, 0);
-      new_edge->side_type = META_SIDE_BOTTOM;
-      new_edge->edge_type = META_EDGE_XINERAMA;
-      ret = g_list_prepend(ret, new_edge);
+      new_edge.rect = meta_rect(BOX_LEFT(*cur_rect), BOX_BOTTOM(*cur_rect),
+                                cur_rect->width, 0);
+      new_edge.side_type = META_SIDE_BOTTOM;
+      new_edge.edge_type = META_EDGE_XINERAMA;
+      g_array_append_val(new_edges, new_edge);
     }
     cur = cur->next;
   }
+  prepend_pieces(ret, new_edges);
+  g_array_free(new_edges, TRUE);
 
   temp_rects = NULL;
   for (; all_struts; all_struts = all_struts->next)
     temp_rects =
         g_slist_prepend(temp_rects, &((MetaStrut *)all_struts->data)->rect);
-  ret = meta_rectangle_remove_intersections_with_boxes_from_edges(ret,
-                                                                  temp_rects);
+  meta_rectangle_remove_intersections_with_boxes_from_edge_array(ret,
+                                                                 temp_rects);
   g_slist_free(temp_rects);
 
   /* Sort the list */
-  ret = g_list_sort(ret, meta_rectangle_edge_cmp);
+  g_array_sort(ret, meta_rectangle_edge_cmp);
 
   return ret;
 }
+
+GList *meta_rectangle_find_nonintersected_xinerama_edges(
+    const MetaRectangle *screen_rect, const GList *xinerama_rects,
+    const GSList *all_struts) {
+  return list_from_array(meta_rectangle_find_nonintersected_xinerama_edge_array(
+      screen_rect, xinerama_rects, all_struts));
+}
@@ -36,6 +36,7 @@
 #include "common.h"
 #include "display.h"
 #include "eventqueue.h"
+#include "keybinding-index.h"
 
 #ifdef HAVE_STARTUP_NOTIFICATION
 #include <libsn/sn.h>
@@ -53,6 +54,7 @@ typedef struct _MetaWorkspace MetaWorkspace;
 typedef struct _MetaGroupPropHooks MetaGroupPropHooks;
 
 typedef struct MetaEdgeResistanceData MetaEdgeResistanceData;
+typedef struct MetaWindowEdgeCache MetaWindowEdgeCache;
 
 typedef void (*MetaWindowPingFunc)(MetaDisplay *display, Window xwindow,
                                    guint32 timestamp, gpointer user_data);
@@ -193,6 +195,7 @@ struct _MetaDisplay {
   int grab_wireframe_last_display_height;
   GList *grab_old_window_stacking;
   MetaEdgeResistanceData *grab_edge_resistance_data;
+  MetaWindowEdgeCache *window_edge_cache;
 
   /* we use property updates as sentinels for certain window focus events
    * to avoid some race conditions on EnterNotify events
@@ -214,6 +217,7 @@ struct _MetaDisplay {
   /* Keybindings stuff */
   MetaKeyBinding *key_bindings;
   int n_key_bindings;
+  MetaKeyBindingIndex *key_bindings_index;
   int min_keycode;
   int max_keycode;
   KeySym *keymap;
@@ -259,6 +263,9 @@ struct _MetaDisplay {
   /* Managed by group-props.c */
   MetaGroupPropHooks *group_prop_hooks;
 
+  /* Managed by xprops.c; Window -> properties fetched ahead of use */
+  GHashTable *prefetched_props;
+
   /* Managed by compositor.c */
   MetaCompositor *compositor;
 
@@ -403,8 +410,9 @@ void meta_display_grab_focus_window_button(MetaDisplay *display,
 void meta_display_ungrab_focus_window_button(MetaDisplay *display,
                                              MetaWindow *window);
 
-/* Next two functions are defined in edge-resistance.c */
+/* These functions are defined in edge-resistance.c */
 void meta_display_cleanup_edges(MetaDisplay *display);
+void meta_display_free_window_edge_cache(MetaDisplay *display);
 
 /* make a request to ensure the event serial has changed */
 void meta_display_increment_event_serial(MetaDisplay *display);
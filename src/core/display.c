@@ -277,6 +277,22 @@ static void disable_compositor(MetaDisplay *display) {
   display->compositor = NULL;
 }
 
+/* Answers marco-message compositor-stats by storing the statistics on
+   the root window the request was sent to */
+static void publish_compositor_stats(MetaDisplay *display, Window xroot) {
+  char *stats = NULL;
+
+  if (display->compositor)
+    stats = meta_compositor_get_stats(display->compositor);
+
+  /* An empty value tells marco-message that nothing is composited */
+  meta_prop_set_utf8_string_hint(display, xroot,
+                                 display->atom__MARCO_COMPOSITOR_STATS,
+                                 stats ? stats : "");
+
+  g_free(stats);
+}
+
 /**
  * Opens a new display, sets it up, initialises all the X extensions
  * we will need, and adds it to the list of displays.
@@ -374,6 +390,7 @@ gboolean meta_display_open(void) {
   meta_display_init_window_prop_hooks(the_display);
   the_display->group_prop_hooks = NULL;
   meta_display_init_group_prop_hooks(the_display);
+  the_display->prefetched_props = NULL;
 
   /* Offscreen unmapped window used for _NET_SUPPORTING_WM_CHECK,
    * created in screen_new
@@ -430,6 +447,7 @@ gboolean meta_display_open(void) {
   the_display->grab_tile_monitor_number = -1;
 
   the_display->grab_edge_resistance_data = NULL;
+  the_display->window_edge_cache = NULL;
 
 #ifdef HAVE_XSYNC
   {
@@ -834,6 +852,10 @@ void meta_display_close(MetaDisplay *display, guint32 timestamp) {
 
   meta_display_free_window_prop_hooks(display);
   meta_display_free_group_prop_hooks(display);
+  meta_prop_forget_prefetched(display, None);
+
+  meta_display_cleanup_edges(display);
+  meta_display_free_window_edge_cache(display);
 
   g_free(display->name);
 
@@ -2258,6 +2280,10 @@ static gboolean event_callback(XEvent *event, gpointer data) {
                      display->atom__MARCO_TOGGLE_VERBOSE) {
             meta_verbose("Received toggle verbose message\n");
             meta_set_verbose(!meta_is_verbose());
+          } else if (event->xclient.message_type ==
+                     display->atom__MARCO_COMPOSITOR_STATS_MESSAGE) {
+            meta_verbose("Received compositor stats request\n");
+            publish_compositor_stats(display, event->xclient.window);
           } else if (event->xclient.message_type ==
                      display->atom_WM_PROTOCOLS) {
             meta_verbose("Received WM_PROTOCOLS message\n");
@@ -26,6 +26,9 @@
 #endif
 
 #include "edge-resistance.h"
+
+#include <stdlib.h>
+
 #include "boxes.h"
 #include "display-private.h"
 #include "workspace.h"
@@ -545,55 +548,12 @@ static gboolean apply_edge_resistance_to_each_side(
 }
 
 void meta_display_cleanup_edges(MetaDisplay *display) {
-  guint i, j;
   MetaEdgeResistanceData *edge_data = display->grab_edge_resistance_data;
-  GHashTable *edges_to_be_freed;
 
   if (edge_data == NULL) /* Not currently cached */
     return;
 
-  /* We first need to clean out any window edges */
-  edges_to_be_freed =
-      g_hash_table_new_full(g_direct_hash, g_direct_equal, g_free, NULL);
-  for (i = 0; i < 4; i++) {
-    GArray *tmp = NULL;
-    MetaSide side;
-    switch (i) {
-      case 0:
-        tmp = edge_data->left_edges;
-        side = META_SIDE_LEFT;
-        break;
-      case 1:
-        tmp = edge_data->right_edges;
-        side = META_SIDE_RIGHT;
-        break;
-      case 2:
-        tmp = edge_data->top_edges;
-        side = META_SIDE_TOP;
-        break;
-      case 3:
-        tmp = edge_data->bottom_edges;
-        side = META_SIDE_BOTTOM;
-        break;
-      default:
-        g_assert_not_reached();
-    }
-
-    for (j = 0; j < tmp->len; j++) {
-      MetaEdge *edge = g_array_index(tmp, MetaEdge *, j);
-      if (edge->edge_type == META_EDGE_WINDOW && edge->side_type == side) {
-        /* The same edge will appear in two arrays, and we can't free
-         * it yet we still need to compare edge->side_type for the other
-         * array that it is in.  So store it in a hash table for later
-         * freeing.  Could also do this in a simple linked list.
-         */
-        g_hash_table_insert(edges_to_be_freed, edge, edge);
-      }
-    }
-  }
-
-  /* Now free all the window edges (the key destroy function is g_free) */
-  g_hash_table_destroy(edges_to_be_freed);
+  /* The window edges belong to display->window_edge_cache */
 
   /* Now free the arrays and data */
   g_array_free(edge_data->left_edges, TRUE);
@@ -786,176 +746,305 @@ static void initialize_grab_edge_resistance_data(MetaDisplay *display) {
   edge_data->bottom_data.keyboard_buildup = 0;
 }
 
-static void compute_resistance_and_snapping_edges(MetaDisplay *display) {
-  GList *stacked_windows;
-  GList *cur_window_iter;
+/* A window whose edges, or whose area, matter to the grab */
+typedef struct {
+  MetaRectangle rect;
+  gboolean is_dock;
+} StackedRect;
+
+/* The window edges only depend on the stacked rectangles and the screen
+ * size, so they are reused until one of those changes; most grabs start
+ * with the other windows where the previous grab left them.
+ */
+struct MetaWindowEdgeCache {
+  MetaRectangle screen_rect;
+  GArray *rects; /* of StackedRect, bottom to top */
   GList *edges;
-  /* Lists of window positions (rects) and their relative stacking positions */
-  int stack_position;
-  GSList *obscuring_windows, *window_stacking;
-  /* The portions of the above lists that still remain at the stacking position
-   * in the layer that we are working on
-   */
-  GSList *rem_windows, *rem_win_stacking;
+};
 
-  g_assert(display->grab_window != NULL);
-  meta_topic(META_DEBUG_WINDOW_OPS,
-             "Computing edges to resist-movement or snap-to for %s.\n",
-             display->grab_window->desc);
+/* Interval tree over the horizontal extents of the rects that may hide
+ * parts of edges. The items are sorted by left side; each subtree is a
+ * range of them rooted at its middle item, whose max_right is the
+ * largest right side in that subtree.
+ */
+typedef struct {
+  int left;
+  int right;
+  int max_right;
+  int rect; /* index in the stacked rects */
+} ObscuringItem;
+
+static GArray *get_stacked_rects(MetaDisplay *display) {
+  GList *stacked_windows;
+  GList *cur_window_iter;
+  GArray *rects;
 
-  /*
-   * 1st: Get the list of relevant windows, from bottom to top
-   */
   stacked_windows = meta_stack_list_windows(
       display->grab_screen->stack, display->grab_screen->active_workspace);
 
-  /*
-   * 2nd: we need to separate that stacked list into a list of windows that
-   * can obscure other edges.  To make sure we only have windows obscuring
-   * those below it instead of going both ways, we also need to keep a
-   * counter list.  Messy, I know.
-   */
-  obscuring_windows = window_stacking = NULL;
-  cur_window_iter = stacked_windows;
-  stack_position = 0;
-  while (cur_window_iter != NULL) {
+  rects = g_array_new(FALSE, FALSE, sizeof(StackedRect));
+  for (cur_window_iter = stacked_windows; cur_window_iter != NULL;
+       cur_window_iter = cur_window_iter->next) {
     MetaWindow *cur_window = cur_window_iter->data;
-    if (WINDOW_EDGES_RELEVANT(cur_window, display)) {
-      MetaRectangle *new_rect;
-      new_rect = g_new(MetaRectangle, 1);
-      meta_window_get_outer_rect(cur_window, new_rect);
-      obscuring_windows = g_slist_prepend(obscuring_windows, new_rect);
-      window_stacking =
-          g_slist_prepend(window_stacking, GINT_TO_POINTER(stack_position));
-    }
+    StackedRect stacked;
+
+    if (!(WINDOW_EDGES_RELEVANT(cur_window, display))) continue;
 
-    stack_position++;
-    cur_window_iter = cur_window_iter->next;
+    meta_window_get_outer_rect(cur_window, &stacked.rect);
+    stacked.is_dock = cur_window->type == META_WINDOW_DOCK;
+    g_array_append_val(rects, stacked);
   }
-  /* Put 'em in bottom to top order */
-  rem_windows = obscuring_windows = g_slist_reverse(obscuring_windows);
-  rem_win_stacking = window_stacking = g_slist_reverse(window_stacking);
 
-  /*
-   * 3rd: loop over the windows again, this time getting the edges from
-   * them and removing intersections with the relevant obscuring_windows &
-   * obscuring_docks.
-   */
+  g_list_free(stacked_windows);
+
+  return rects;
+}
+
+static gboolean same_stacked_rects(const GArray *a, const GArray *b) {
+  guint i;
+
+  if (a->len != b->len) return FALSE;
+
+  for (i = 0; i < a->len; i++) {
+    const StackedRect *a_rect = &g_array_index(a, StackedRect, i);
+    const StackedRect *b_rect = &g_array_index(b, StackedRect, i);
+
+    if (!meta_rectangle_equal(&a_rect->rect, &b_rect->rect) ||
+        a_rect->is_dock != b_rect->is_dock)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static int compare_obscuring_items(const void *a, const void *b) {
+  const ObscuringItem *a_item = a;
+  const ObscuringItem *b_item = b;
+
+  if (a_item->left != b_item->left)
+    return a_item->left < b_item->left ? -1 : 1;
+
+  return a_item->rect - b_item->rect;
+}
+
+static int set_max_right(ObscuringItem *items, int lo, int hi) {
+  int mid, max_right;
+
+  if (lo >= hi) return G_MININT;
+
+  mid = lo + (hi - lo) / 2;
+  max_right = MAX(items[mid].right, set_max_right(items, lo, mid));
+  max_right = MAX(max_right, set_max_right(items, mid + 1, hi));
+  items[mid].max_right = max_right;
+
+  return max_right;
+}
+
+/* Appends the rects whose extents meet [left, right], sides included */
+static void find_obscuring(const ObscuringItem *items, int lo, int hi,
+                           int left, int right, GArray *found) {
+  int mid;
+
+  if (lo >= hi) return;
+
+  mid = lo + (hi - lo) / 2;
+  if (items[mid].max_right < left) return;
+
+  find_obscuring(items, lo, mid, left, right, found);
+
+  /* Nothing from here on starts early enough */
+  if (items[mid].left > right) return;
+
+  if (items[mid].right >= left) g_array_append_val(found, items[mid].rect);
+
+  find_obscuring(items, mid + 1, hi, left, right, found);
+}
+
+static int compare_ints(const void *a, const void *b) {
+  return *(const int *)a - *(const int *)b;
+}
+
+static GList *compute_window_edges(const GArray *rects,
+                                   const MetaRectangle *screen_rect) {
+  ObscuringItem *items;
+  GArray *found;
+  GList *edges;
+  guint i, j;
+
+  items = g_new(ObscuringItem, rects->len);
+  for (i = 0; i < rects->len; i++) {
+    const MetaRectangle *rect = &g_array_index(rects, StackedRect, i).rect;
+
+    items[i].left = BOX_LEFT(*rect);
+    items[i].right = BOX_RIGHT(*rect);
+    items[i].rect = i;
+  }
+  qsort(items, rects->len, sizeof(ObscuringItem), compare_obscuring_items);
+  set_max_right(items, 0, rects->len);
+
+  found = g_array_new(FALSE, FALSE, sizeof(int));
+
   edges = NULL;
-  stack_position = 0;
-  cur_window_iter = stacked_windows;
-  while (cur_window_iter != NULL) {
-    MetaRectangle cur_rect;
-    MetaWindow *cur_window = cur_window_iter->data;
-    meta_window_get_outer_rect(cur_window, &cur_rect);
+  for (i = 0; i < rects->len; i++) {
+    const StackedRect *cur = &g_array_index(rects, StackedRect, i);
+    GSList *obscuring;
+    GList *new_edges;
+    MetaEdge *new_edge;
+    MetaRectangle reduced;
+
+    /* Dock edges are considered screen edges, which are handled
+     * separately; docks only hide the edges of windows below them.
+     */
+    if (cur->is_dock) continue;
 
-    /* Check if we want to use this window's edges for edge
-     * resistance (note that dock edges are considered screen edges
-     * which are handled separately
+    /* We don't care about snapping to any portion of the window that
+     * is offscreen (we also don't care about parts of edges covered
+     * by other windows or DOCKS, but that's handled below).
      */
-    if (WINDOW_EDGES_RELEVANT(cur_window, display) &&
-        cur_window->type != META_WINDOW_DOCK) {
-      GList *new_edges;
-      MetaEdge *new_edge;
-      MetaRectangle reduced;
-
-      /* We don't care about snapping to any portion of the window that
-       * is offscreen (we also don't care about parts of edges covered
-       * by other windows or DOCKS, but that's handled below).
-       */
-      meta_rectangle_intersect(&cur_rect, &display->grab_screen->rect,
-                               &reduced);
+    meta_rectangle_intersect(&cur->rect, screen_rect, &reduced);
 
-      new_edges = NULL;
+    new_edges = NULL;
 
-      /* Left side of this window is resistance for the right edge of
-       * the window being moved.
-       */
-      new_edge = g_new(MetaEdge, 1);
-      new_edge->rect = reduced;
-      new_edge->rect.width = 0;
-      new_edge->side_type = META_SIDE_RIGHT;
-      new_edge->edge_type = META_EDGE_WINDOW;
-      new_edges = g_list_prepend(new_edges, new_edge);
-
-      /* Right side of this window is resistance for the left edge of
-       * the window being moved.
-       */
-      new_edge = g_new(MetaEdge, 1);
-      new_edge->rect = reduced;
-      new_edge->rect.x += new_edge->rect.width;
-      new_edge->rect.width = 0;
-      new_edge->side_type = META_SIDE_LEFT;
-      new_edge->edge_type = META_EDGE_WINDOW;
-      new_edges = g_list_prepend(new_edges, new_edge);
-
-      /* Top side of this window is resistance for the bottom edge of
-       * the window being moved.
-       */
-      new_edge = g_new(MetaEdge, 1);
-      new_edge->rect = reduced;
-      new_edge->rect.height = 0;
-      new_edge->side_type = META_SIDE_BOTTOM;
-      new_edge->edge_type = META_EDGE_WINDOW;
-      new_edges = g_list_prepend(new_edges, new_edge);
-
-      /* Top side of this window is resistance for the bottom edge of
-       * the window being moved.
-       */
-      new_edge = g_new(MetaEdge, 1);
-      new_edge->rect = reduced;
-      new_edge->rect.y += new_edge->rect.height;
-      new_edge->rect.height = 0;
-      new_edge->side_type = META_SIDE_TOP;
-      new_edge->edge_type = META_EDGE_WINDOW;
-      new_edges = g_list_prepend(new_edges, new_edge);
-
-      /* Update the remaining windows to only those at a higher
-       * stacking position than this one.
-       */
-      while (rem_win_stacking &&
-             stack_position >= GPOINTER_TO_INT(rem_win_stacking->data)) {
-        rem_windows = rem_windows->next;
-        rem_win_stacking = rem_win_stacking->next;
-      }
+    /* Left side of this window is resistance for the right edge of
+     * the window being moved.
+     */
+    new_edge = g_new(MetaEdge, 1);
+    new_edge->rect = reduced;
+    new_edge->rect.width = 0;
+    new_edge->side_type = META_SIDE_RIGHT;
+    new_edge->edge_type = META_EDGE_WINDOW;
+    new_edges = g_list_prepend(new_edges, new_edge);
+
+    /* Right side of this window is resistance for the left edge of
+     * the window being moved.
+     */
+    new_edge = g_new(MetaEdge, 1);
+    new_edge->rect = reduced;
+    new_edge->rect.x += new_edge->rect.width;
+    new_edge->rect.width = 0;
+    new_edge->side_type = META_SIDE_LEFT;
+    new_edge->edge_type = META_EDGE_WINDOW;
+    new_edges = g_list_prepend(new_edges, new_edge);
+
+    /* Top side of this window is resistance for the bottom edge of
+     * the window being moved.
+     */
+    new_edge = g_new(MetaEdge, 1);
+    new_edge->rect = reduced;
+    new_edge->rect.height = 0;
+    new_edge->side_type = META_SIDE_BOTTOM;
+    new_edge->edge_type = META_EDGE_WINDOW;
+    new_edges = g_list_prepend(new_edges, new_edge);
+
+    /* Top side of this window is resistance for the bottom edge of
+     * the window being moved.
+     */
+    new_edge = g_new(MetaEdge, 1);
+    new_edge->rect = reduced;
+    new_edge->rect.y += new_edge->rect.height;
+    new_edge->rect.height = 0;
+    new_edge->side_type = META_SIDE_TOP;
+    new_edge->edge_type = META_EDGE_WINDOW;
+    new_edges = g_list_prepend(new_edges, new_edge);
+
+    /* Only windows stacked above this one, and touching it, can hide
+     * parts of its edges
+     */
+    g_array_set_size(found, 0);
+    find_obscuring(items, 0, rects->len, BOX_LEFT(reduced), BOX_RIGHT(reduced),
+                   found);
+    qsort(found->data, found->len, sizeof(int), compare_ints);
+
+    obscuring = NULL;
+    for (j = found->len; j > 0; j--) {
+      int above = g_array_index(found, int, j - 1);
+      MetaRectangle *rect = &g_array_index(rects, StackedRect, above).rect;
 
-      /* Remove edge portions overlapped by rem_windows and rem_docks */
-      new_edges = meta_rectangle_remove_intersections_with_boxes_from_edges(
-          new_edges, rem_windows);
+      if (above <= (int)i) break;
 
-      /* Save the new edges */
-      edges = g_list_concat(new_edges, edges);
+      if (BOX_TOP(*rect) <= BOX_BOTTOM(reduced) &&
+          BOX_TOP(reduced) <= BOX_BOTTOM(*rect))
+        obscuring = g_slist_prepend(obscuring, rect);
     }
 
-    stack_position++;
-    cur_window_iter = cur_window_iter->next;
+    /* Remove edge portions overlapped by windows and docks above */
+    new_edges = meta_rectangle_remove_intersections_with_boxes_from_edges(
+        new_edges, obscuring);
+    g_slist_free(obscuring);
+
+    /* Save the new edges */
+    edges = g_list_concat(new_edges, edges);
   }
 
-  /*
-   * 4th: Free the extra memory not needed and sort the list
-   */
-  g_list_free(stacked_windows);
-  /* Free the memory used by the obscuring windows/docks lists */
-  g_slist_free(window_stacking);
-  g_slist_free_full(obscuring_windows, g_free);
+  g_array_free(found, TRUE);
+  g_free(items);
 
   /* Sort the list.  FIXME: Should I bother with this sorting?  I just
    * sort again later in cache_edges() anyway...
    */
-  edges = g_list_sort(edges, meta_rectangle_edge_cmp);
+  return g_list_sort(edges, meta_rectangle_edge_cmp);
+}
+
+void meta_display_free_window_edge_cache(MetaDisplay *display) {
+  MetaWindowEdgeCache *cache = display->window_edge_cache;
+
+  if (cache == NULL) return;
+
+  /* meta_display_cleanup_edges() must have dropped the grab's copies */
+  g_assert(display->grab_edge_resistance_data == NULL);
+
+  g_array_free(cache->rects, TRUE);
+  g_list_free_full(cache->edges, g_free);
+  g_free(cache);
+  display->window_edge_cache = NULL;
+}
+
+static void compute_resistance_and_snapping_edges(MetaDisplay *display) {
+  MetaWindowEdgeCache *cache;
+  const MetaRectangle *screen_rect;
+  GArray *rects;
+
+  g_assert(display->grab_window != NULL);
+  meta_topic(META_DEBUG_WINDOW_OPS,
+             "Computing edges to resist-movement or snap-to for %s.\n",
+             display->grab_window->desc);
+
+  /*
+   * 1st: Get the relevant windows, from bottom to top
+   */
+  rects = get_stacked_rects(display);
+  screen_rect = &display->grab_screen->rect;
+
+  /*
+   * 2nd: Get their edges, less the parts that windows above them hide,
+   * unless nothing changed since the last time
+   */
+  cache = display->window_edge_cache;
+  if (cache != NULL && meta_rectangle_equal(&cache->screen_rect, screen_rect) &&
+      same_stacked_rects(cache->rects, rects)) {
+    meta_topic(META_DEBUG_EDGE_RESISTANCE,
+               "Reusing the edges of %u windows\n", rects->len);
+    g_array_free(rects, TRUE);
+  } else {
+    meta_display_free_window_edge_cache(display);
+
+    cache = g_new(MetaWindowEdgeCache, 1);
+    cache->screen_rect = *screen_rect;
+    cache->rects = rects;
+    cache->edges = compute_window_edges(rects, screen_rect);
+    display->window_edge_cache = cache;
+  }
 
   /*
-   * 5th: Cache the combination of these edges with the onscreen and
-   * xinerama edges in an array for quick access.  Free the edges since
-   * they've been cached elsewhere.
+   * 3rd: Cache the combination of these edges with the onscreen and
+   * xinerama edges in an array for quick access.
    */
-  cache_edges(display, edges,
+  cache_edges(display, cache->edges,
               display->grab_screen->active_workspace->xinerama_edges,
               display->grab_screen->active_workspace->screen_edges);
-  g_list_free(edges);
 
   /*
-   * 6th: Initialize the resistance timeouts and buildups
+   * 4th: Initialize the resistance timeouts and buildups
    */
   initialize_grab_edge_resistance_data(display);
 }
@@ -0,0 +1,94 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Marco key binding lookup */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "keybinding-index.h"
+
+struct _MetaKeyBindingIndex {
+  /* Key of the combo -> 1 + the binding, so that 0 means none */
+  GHashTable *all;
+  GHashTable *global;
+};
+
+/* Keycodes and the real modifiers both fit in 8 bits; anything else
+ * can never match an event
+ */
+static gboolean get_key(unsigned int keycode, unsigned int mask,
+                        guint *key_p) {
+  if (keycode == 0 || keycode > 0xff || mask > 0xff) return FALSE;
+
+  *key_p = (keycode << 8) | mask;
+  return TRUE;
+}
+
+MetaKeyBindingIndex *meta_key_binding_index_new(void) {
+  MetaKeyBindingIndex *key_index;
+
+  key_index = g_new(MetaKeyBindingIndex, 1);
+  key_index->all = g_hash_table_new(NULL, NULL);
+  key_index->global = g_hash_table_new(NULL, NULL);
+
+  return key_index;
+}
+
+void meta_key_binding_index_free(MetaKeyBindingIndex *key_index) {
+  g_hash_table_destroy(key_index->all);
+  g_hash_table_destroy(key_index->global);
+  g_free(key_index);
+}
+
+static void add_first(GHashTable *table, guint key, int binding) {
+  if (!g_hash_table_contains(table, GUINT_TO_POINTER(key)))
+    g_hash_table_insert(table, GUINT_TO_POINTER(key),
+                        GINT_TO_POINTER(binding + 1));
+}
+
+void meta_key_binding_index_add(MetaKeyBindingIndex *key_index,
+                                unsigned int keycode, unsigned int mask,
+                                gboolean per_window, int binding) {
+  guint key;
+
+  if (!get_key(keycode, mask, &key)) return;
+
+  add_first(key_index->all, key, binding);
+  if (!per_window) add_first(key_index->global, key, binding);
+}
+
+int meta_key_binding_index_lookup(const MetaKeyBindingIndex *key_index,
+                                  const XKeyEvent *event,
+                                  unsigned int ignored_modifier_mask,
+                                  gboolean on_window) {
+  GHashTable *table;
+  guint key;
+
+  if (event->type != KeyPress ||
+      !get_key(event->keycode, event->state & 0xff & ~ignored_modifier_mask,
+               &key))
+    return -1;
+
+  table = on_window ? key_index->all : key_index->global;
+
+  return GPOINTER_TO_INT(g_hash_table_lookup(table, GUINT_TO_POINTER(key))) -
+         1;
+}
@@ -0,0 +1,50 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Marco key binding lookup */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef META_KEYBINDING_INDEX_H
+#define META_KEYBINDING_INDEX_H
+
+#include <X11/Xlib.h>
+#include <glib.h>
+
+/* Maps a keycode and modifier mask to a position in a binding table */
+typedef struct _MetaKeyBindingIndex MetaKeyBindingIndex;
+
+MetaKeyBindingIndex *meta_key_binding_index_new(void);
+void meta_key_binding_index_free(MetaKeyBindingIndex *key_index);
+
+/* Add the bindings in table order: as with a scan of the table, a
+ * lookup finds the first one added for a keycode and mask.
+ */
+void meta_key_binding_index_add(MetaKeyBindingIndex *key_index,
+                                unsigned int keycode, unsigned int mask,
+                                gboolean per_window, int binding);
+
+/* Returns the binding for a KeyPress, whose state is masked the way
+ * marco grabs keys, or -1. Per-window bindings are only found when
+ * on_window.
+ */
+int meta_key_binding_index_lookup(const MetaKeyBindingIndex *key_index,
+                                  const XKeyEvent *event,
+                                  unsigned int ignored_modifier_mask,
+                                  gboolean on_window);
+
+#endif
@@ -361,6 +361,27 @@ static void rebuild_binding_table(MetaDisplay *display,
   meta_topic(META_DEBUG_KEYBINDINGS, " %d bindings in table\n", *n_bindings_p);
 }
 
+/* Must follow any change to the keycodes or masks of the bindings */
+static void rebuild_key_binding_index(MetaDisplay *display) {
+  int i;
+
+  if (display->key_bindings_index)
+    meta_key_binding_index_free(display->key_bindings_index);
+
+  display->key_bindings_index = meta_key_binding_index_new();
+
+  for (i = 0; i < display->n_key_bindings; i++) {
+    const MetaKeyBinding *binding = &display->key_bindings[i];
+    gboolean per_window;
+
+    per_window =
+        binding->handler && (binding->handler->flags & BINDING_PER_WINDOW);
+
+    meta_key_binding_index_add(display->key_bindings_index, binding->keycode,
+                               binding->mask, per_window, i);
+  }
+}
+
 static void rebuild_key_binding_table(MetaDisplay *display) {
   const MetaKeyPref *prefs;
   int n_prefs;
@@ -464,6 +485,7 @@ void meta_display_process_mapping_event(MetaDisplay *display, XEvent *event) {
     if (keymap_changed) reload_keycodes(display);
 
     reload_modifiers(display);
+    rebuild_key_binding_index(display);
 
     regrab_key_bindings(display);
   }
@@ -479,6 +501,7 @@ static void bindings_changed_callback(MetaPreference pref, void *data) {
       rebuild_key_binding_table(display);
       reload_keycodes(display);
       reload_modifiers(display);
+      rebuild_key_binding_index(display);
       regrab_key_bindings(display);
       break;
     default:
@@ -501,6 +524,7 @@ void meta_display_init_keys(MetaDisplay *display) {
   display->meta_mask = 0;
   display->key_bindings = NULL;
   display->n_key_bindings = 0;
+  display->key_bindings_index = NULL;
 
   XDisplayKeycodes(display->xdisplay, &display->min_keycode,
                    &display->max_keycode);
@@ -515,6 +539,7 @@ void meta_display_init_keys(MetaDisplay *display) {
 
   reload_keycodes(display);
   reload_modifiers(display);
+  rebuild_key_binding_index(display);
 
   /* Keys are actually grabbed in meta_screen_grab_keys() */
 
@@ -538,6 +563,8 @@ void meta_display_shutdown_keys(MetaDisplay *display) {
 
   if (display->modmap) XFreeModifiermap(display->modmap);
   g_free(display->key_bindings);
+  if (display->key_bindings_index)
+    meta_key_binding_index_free(display->key_bindings_index);
 }
 
 static const char *keysym_name(int keysym) {
@@ -974,61 +1001,56 @@ static gboolean primary_modifier_still_pressed(
 }
 
 /* now called from only one place, may be worth merging */
-static gboolean process_event(MetaKeyBinding *bindings, int n_bindings,
-                              MetaDisplay *display, MetaScreen *screen,
+static gboolean process_event(MetaDisplay *display, MetaScreen *screen,
                               MetaWindow *window, XEvent *event,
                               gboolean on_window) {
+  MetaKeyBinding *binding;
+  const MetaKeyHandler *handler;
   int i;
 
   /* we used to have release-based bindings but no longer. */
   if (event->type == KeyRelease) return FALSE;
 
-  /*
-   * TODO: This would be better done with a hash table;
-   * it doesn't suit to use O(n) for such a common operation.
-   */
-  for (i = 0; i < n_bindings; i++) {
-    const MetaKeyHandler *handler = bindings[i].handler;
+  i = meta_key_binding_index_lookup(display->key_bindings_index, &event->xkey,
+                                    display->ignored_modifier_mask, on_window);
+  if (i < 0) {
+    meta_topic(META_DEBUG_KEYBINDINGS,
+               "No handler found for this event in this binding table\n");
+    return FALSE;
+  }
 
-    if ((!on_window && handler->flags & BINDING_PER_WINDOW) ||
-        event->type != KeyPress || bindings[i].keycode != event->xkey.keycode ||
-        ((event->xkey.state & 0xff & ~(display->ignored_modifier_mask)) !=
-         bindings[i].mask))
-      continue;
+  binding = &display->key_bindings[i];
+  handler = binding->handler;
 
-    /*
-     * window must be non-NULL for on_window to be true,
-     * and so also window must be non-NULL if we get here and
-     * this is a BINDING_PER_WINDOW binding.
-     */
+  /*
+   * window must be non-NULL for on_window to be true,
+   * and so also window must be non-NULL if we get here and
+   * this is a BINDING_PER_WINDOW binding.
+   */
 
-    meta_topic(META_DEBUG_KEYBINDINGS,
-               "Binding keycode 0x%x mask 0x%x matches event 0x%x state 0x%x\n",
-               bindings[i].keycode, bindings[i].mask, event->xkey.keycode,
-               event->xkey.state);
+  meta_topic(META_DEBUG_KEYBINDINGS,
+             "Binding keycode 0x%x mask 0x%x matches event 0x%x state 0x%x\n",
+             binding->keycode, binding->mask, event->xkey.keycode,
+             event->xkey.state);
 
-    if (handler == NULL)
-      meta_bug("Binding %s has no handler\n", bindings[i].name);
-    else
-      meta_topic(META_DEBUG_KEYBINDINGS, "Running handler for %s\n",
-                 bindings[i].name);
+  if (handler == NULL) {
+    meta_bug("Binding %s has no handler\n", binding->name);
+    return FALSE;
+  }
 
-    /* Global keybindings count as a let-the-terminal-lose-focus
-     * due to new window mapping until the user starts
-     * interacting with the terminal again.
-     */
-    display->allow_terminal_deactivation = TRUE;
+  meta_topic(META_DEBUG_KEYBINDINGS, "Running handler for %s\n",
+             binding->name);
 
-    (*handler->func)(
-        display, screen,
-        bindings[i].handler->flags & BINDING_PER_WINDOW ? window : NULL, event,
-        &bindings[i]);
-    return TRUE;
-  }
+  /* Global keybindings count as a let-the-terminal-lose-focus
+   * due to new window mapping until the user starts
+   * interacting with the terminal again.
+   */
+  display->allow_terminal_deactivation = TRUE;
 
-  meta_topic(META_DEBUG_KEYBINDINGS,
-             "No handler found for this event in this binding table\n");
-  return FALSE;
+  (*handler->func)(display, screen,
+                   handler->flags & BINDING_PER_WINDOW ? window : NULL, event,
+                   binding);
+  return TRUE;
 }
 
 /* Handle a key event. May be called recursively: some key events cause
@@ -1178,8 +1200,7 @@ void meta_display_process_key_event(MetaDisplay *display, MetaWindow *window,
     }
   }
   /* Do the normal keybindings */
-  process_event(display->key_bindings, display->n_key_bindings, display, screen,
-                window, event, !all_keys_grabbed && window);
+  process_event(display, screen, window, event, !all_keys_grabbed && window);
 }
 
 static gboolean process_mouse_move_resize_grab(MetaDisplay *display,
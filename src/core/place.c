@@ -357,10 +357,16 @@ static void avoid_being_obscured_as_second_modal_dialog(
   }
 }
 
-static gboolean rectangle_overlaps_some_window(MetaRectangle *rect,
-                                               GList *windows) {
+/* Indexes the windows that new windows should not be placed over, so
+ * that each candidate position doesn't have to be tested against all
+ * of them
+ */
+static MetaRectangleGrid *get_obstacles(GList *windows) {
+  MetaRectangleGrid *obstacles;
+  GArray *rects;
   GList *tmp;
-  MetaRectangle dest;
+
+  rects = g_array_new(FALSE, FALSE, sizeof(MetaRectangle));
 
   tmp = windows;
   while (tmp != NULL) {
@@ -380,15 +386,17 @@ static gboolean rectangle_overlaps_some_window(MetaRectangle *rect,
       case META_WINDOW_TOOLBAR:
       case META_WINDOW_MENU:
         meta_window_get_outer_rect(other, &other_rect);
-
-        if (meta_rectangle_intersect(rect, &other_rect, &dest)) return TRUE;
+        g_array_append_val(rects, other_rect);
         break;
     }
 
     tmp = tmp->next;
   }
 
-  return FALSE;
+  obstacles = meta_rectangle_grid_new((MetaRectangle *)rects->data, rects->len);
+  g_array_free(rects, TRUE);
+
+  return obstacles;
 }
 
 static gint leftmost_cmp(gconstpointer a, gconstpointer b) {
@@ -487,11 +495,14 @@ static gboolean find_first_fit(MetaWindow *window, MetaFrameBorders *borders,
   GList *below_sorted;
   GList *right_sorted;
   GList *tmp;
+  MetaRectangleGrid *obstacles;
   MetaRectangle rect;
   MetaRectangle work_area;
 
   retval = FALSE;
 
+  obstacles = get_obstacles(windows);
+
   /* Below each window */
   below_sorted = g_list_copy(windows);
   below_sorted = g_list_sort(below_sorted, leftmost_cmp);
@@ -529,7 +540,7 @@ static gboolean find_first_fit(MetaWindow *window, MetaFrameBorders *borders,
 
   if (meta_rectangle_contains_rect(&work_area, &rect) &&
       (meta_prefs_get_center_new_windows() ||
-       !rectangle_overlaps_some_window(&rect, windows))) {
+       !meta_rectangle_grid_overlaps(obstacles, &rect))) {
     *new_x = rect.x;
     *new_y = rect.y;
     if (borders) {
@@ -554,7 +565,7 @@ static gboolean find_first_fit(MetaWindow *window, MetaFrameBorders *borders,
     rect.y = outer_rect.y + outer_rect.height;
 
     if (meta_rectangle_contains_rect(&work_area, &rect) &&
-        !rectangle_overlaps_some_window(&rect, below_sorted)) {
+        !meta_rectangle_grid_overlaps(obstacles, &rect)) {
       *new_x = rect.x;
       *new_y = rect.y;
       if (borders) {
@@ -582,7 +593,7 @@ static gboolean find_first_fit(MetaWindow *window, MetaFrameBorders *borders,
     rect.y = outer_rect.y;
 
     if (meta_rectangle_contains_rect(&work_area, &rect) &&
-        !rectangle_overlaps_some_window(&rect, right_sorted)) {
+        !meta_rectangle_grid_overlaps(obstacles, &rect)) {
       *new_x = rect.x;
       *new_y = rect.y;
       if (borders) {
@@ -600,6 +611,7 @@ static gboolean find_first_fit(MetaWindow *window, MetaFrameBorders *borders,
 
 out:
 
+  meta_rectangle_grid_free(obstacles);
   g_list_free(below_sorted);
   g_list_free(right_sorted);
   return retval;
@@ -134,6 +134,10 @@ static gboolean use_force_compositor_manager = FALSE;
 static gboolean force_compositor_manager = FALSE;
 static gboolean compositing_manager = FALSE;
 static gboolean compositing_fast_alt_tab = FALSE;
+static gboolean compositing_unredirect_fullscreen = FALSE;
+static int compositing_max_frame_rate = 0;
+static int compositing_buffer_count = 2;
+static int draw_cache_size = 8192;
 static gboolean resize_with_right_button = FALSE;
 static gboolean show_tab_border = FALSE;
 static gboolean center_new_windows = FALSE;
@@ -437,6 +441,13 @@ static MetaBoolPreference preferences_bool[] = {
         &compositing_fast_alt_tab,
         FALSE,
     },
+    {
+        "compositing-unredirect-fullscreen",
+        KEY_GENERAL_SCHEMA,
+        META_PREF_COMPOSITING_UNREDIRECT_FULLSCREEN,
+        &compositing_unredirect_fullscreen,
+        FALSE,
+    },
     {
         "resize-with-right-button",
         KEY_GENERAL_SCHEMA,
@@ -588,6 +599,33 @@ static MetaIntPreference preferences_int[] = {
         META_MAX_ALT_TAB_MAX_COLUMNS,
         META_DEFAULT_ALT_TAB_MAX_COLUMNS,
     },
+    {
+        "compositing-max-frame-rate",
+        KEY_GENERAL_SCHEMA,
+        META_PREF_COMPOSITING_MAX_FRAME_RATE,
+        &compositing_max_frame_rate,
+        0,
+        1000,
+        0,
+    },
+    {
+        "compositing-buffer-count",
+        KEY_GENERAL_SCHEMA,
+        META_PREF_COMPOSITING_BUFFER_COUNT,
+        &compositing_buffer_count,
+        2,
+        4,
+        2,
+    },
+    {
+        "draw-cache-size",
+        KEY_GENERAL_SCHEMA,
+        META_PREF_DRAW_CACHE_SIZE,
+        &draw_cache_size,
+        0,
+        1048576,
+        8192,
+    },
     {
         NULL,
         NULL,
@@ -1564,6 +1602,18 @@ const char *meta_preference_to_string(MetaPreference pref) {
     case META_PREF_COMPOSITING_FAST_ALT_TAB:
       return "COMPOSITING_FAST_ALT_TAB";
 
+    case META_PREF_COMPOSITING_UNREDIRECT_FULLSCREEN:
+      return "COMPOSITING_UNREDIRECT_FULLSCREEN";
+
+    case META_PREF_COMPOSITING_MAX_FRAME_RATE:
+      return "COMPOSITING_MAX_FRAME_RATE";
+
+    case META_PREF_COMPOSITING_BUFFER_COUNT:
+      return "COMPOSITING_BUFFER_COUNT";
+
+    case META_PREF_DRAW_CACHE_SIZE:
+      return "DRAW_CACHE_SIZE";
+
     case META_PREF_CENTER_NEW_WINDOWS:
       return "CENTER_NEW_WINDOWS";
 
@@ -2098,6 +2148,20 @@ gboolean meta_prefs_get_compositing_fast_alt_tab(void) {
   return compositing_fast_alt_tab;
 }
 
+gboolean meta_prefs_get_compositing_unredirect_fullscreen(void) {
+  return compositing_unredirect_fullscreen;
+}
+
+int meta_prefs_get_compositing_max_frame_rate(void) {
+  return compositing_max_frame_rate;
+}
+
+int meta_prefs_get_compositing_buffer_count(void) {
+  return compositing_buffer_count;
+}
+
+int meta_prefs_get_draw_cache_size(void) { return draw_cache_size; }
+
 gboolean meta_prefs_get_center_new_windows(void) { return center_new_windows; }
 
 gboolean meta_prefs_get_allow_tiling() { return allow_tiling; }
@@ -122,6 +122,9 @@ struct _MetaScreen {
 
   guint work_area_idle;
 
+  /* Memoized workspace regions, see workspace.c:get_spanning_set() */
+  GHashTable *spanning_sets;
+
   int rows_of_workspaces;
   int columns_of_workspaces;
   MetaScreenCorner starting_corner;
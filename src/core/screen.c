@@ -32,6 +32,7 @@
 
 #include <glib/gi18n-lib.h>
 
+#include "async-getprop.h"
 #include "compositor.h"
 #include "errors.h"
 #include "frame-private.h"
@@ -484,6 +485,7 @@ MetaScreen *meta_screen_new(MetaDisplay *display, int number,
   screen->xinerama_infos = NULL;
   screen->n_xinerama_infos = 0;
   screen->last_xinerama_index = 0;
+  screen->spanning_sets = NULL;
 
   reload_xinerama_infos(screen);
 
@@ -624,6 +626,8 @@ void meta_screen_free(MetaScreen *screen, guint32 timestamp) {
 
   if (screen->xinerama_infos) g_free(screen->xinerama_infos);
 
+  if (screen->spanning_sets) g_hash_table_destroy(screen->spanning_sets);
+
   if (screen->tile_preview_timeout_id)
     g_source_remove(screen->tile_preview_timeout_id);
 
@@ -645,33 +649,82 @@ static GList *list_windows(MetaScreen *screen) {
   Window ignored1, ignored2;
   Window *children;
   guint n_children, i;
+  XWindowAttributes *attrs;
+  Bool *succeeded;
   GList *result;
 
   XQueryTree(screen->display->xdisplay, screen->xroot, &ignored1, &ignored2,
              &children, &n_children);
 
+  /* One round trip for all of them, rather than one per window. Any of
+   * them may be destroyed meanwhile.
+   */
+  attrs = g_new(XWindowAttributes, n_children);
+  succeeded = g_new(Bool, n_children);
+  meta_error_trap_push(screen->display);
+  ag_get_window_attributes(screen->display->xdisplay, children, n_children,
+                           attrs, succeeded);
+  meta_error_trap_pop(screen->display, TRUE);
+
   result = NULL;
   for (i = 0; i < n_children; ++i) {
-    WindowInfo *info = g_new0(WindowInfo, 1);
-
-    meta_error_trap_push(screen->display);
+    WindowInfo *info;
 
-    XGetWindowAttributes(screen->display->xdisplay, children[i], &info->attrs);
-
-    if (meta_error_trap_pop_with_return(screen->display, TRUE)) {
+    if (!succeeded[i]) {
       meta_verbose("Failed to get attributes for window 0x%lx\n", children[i]);
-      g_free(info);
-    } else {
-      info->xwindow = children[i];
-      result = g_list_prepend(result, info);
+      continue;
     }
+
+    info = g_new0(WindowInfo, 1);
+    info->xwindow = children[i];
+    info->attrs = attrs[i];
+    result = g_list_prepend(result, info);
   }
 
+  g_free(attrs);
+  g_free(succeeded);
   if (children) XFree(children);
 
   return g_list_reverse(result);
 }
 
+static gboolean is_our_own_window(MetaScreen *screen, Window xwindow) {
+  gboolean test_window_owner;
+
+  test_window_owner = xwindow == screen->no_focus_window ||
+                      xwindow == screen->flash_window ||
+                      xwindow == screen->wm_sn_selection_window;
+
+#ifdef HAVE_COMPOSITE_EXTENSIONS
+  test_window_owner =
+      test_window_owner || xwindow == screen->wm_cm_selection_window;
+#endif
+
+  return test_window_owner;
+}
+
+/* Fetches the properties of the windows we may manage, all at once */
+static void prefetch_properties(MetaScreen *screen, GList *windows) {
+  Window *xwindows;
+  int n_xwindows;
+  GList *list;
+
+  xwindows = g_new(Window, g_list_length(windows));
+  n_xwindows = 0;
+
+  for (list = windows; list != NULL; list = list->next) {
+    WindowInfo *info = list->data;
+
+    if (!info->attrs.override_redirect &&
+        !is_our_own_window(screen, info->xwindow))
+      xwindows[n_xwindows++] = info->xwindow;
+  }
+
+  meta_window_prefetch_properties(screen->display, xwindows, n_xwindows);
+
+  g_free(xwindows);
+}
+
 void meta_screen_manage_all_windows(MetaScreen *screen) {
   GList *windows;
   GList *list;
@@ -680,23 +733,23 @@ void meta_screen_manage_all_windows(MetaScreen *screen) {
 
   windows = list_windows(screen);
 
+  /* The server is grabbed until all of these are managed, so the
+   * prefetched values stay current
+   */
+  prefetch_properties(screen, windows);
+
   meta_stack_freeze(screen->stack);
   for (list = windows; list != NULL; list = list->next) {
     WindowInfo *info = list->data;
     MetaWindow *window;
-    gboolean test_window_owner;
 
     window = meta_window_new_with_attrs(screen->display, info->xwindow, TRUE,
                                         &info->attrs);
-    test_window_owner = info->xwindow == screen->no_focus_window ||
-                        info->xwindow == screen->flash_window ||
-                        info->xwindow == screen->wm_sn_selection_window;
 
-#ifdef HAVE_COMPOSITE_EXTENSIONS
-    test_window_owner =
-        test_window_owner || info->xwindow == screen->wm_cm_selection_window;
-#endif
-    if (test_window_owner) {
+    /* We may write its properties from now on */
+    meta_prop_forget_prefetched(screen->display, info->xwindow);
+
+    if (is_our_own_window(screen, info->xwindow)) {
       meta_verbose("Not managing our own windows\n");
       continue;
     }
@@ -709,6 +762,9 @@ void meta_screen_manage_all_windows(MetaScreen *screen) {
 
   g_list_free_full(windows, g_free);
 
+  /* Windows that were never managed, and the values they didn't use */
+  meta_prop_forget_prefetched(screen->display, None);
+
   meta_display_ungrab(screen->display);
 }
 
@@ -1044,57 +1100,25 @@ void meta_screen_update_cursor(MetaScreen *screen) {
 #define MAX_PREVIEW_SCREEN_FRACTION 0.33
 #define MAX_PREVIEW_SIZE 300.0
 
+/* The compositor keeps the thumbnail and only renders it again when the
+   window has changed since, so opening the popup again is cheap */
 static cairo_surface_t *get_window_surface(MetaWindow *window) {
-  cairo_surface_t *surface, *scaled;
-  cairo_t *cr;
   const MetaXineramaScreenInfo *current;
-  int width, height, max_columns;
-  double max_size;
-  double ratio;
-
-  surface =
-      meta_compositor_get_window_surface(window->display->compositor, window);
-
-  if (surface == NULL) return NULL;
-
-  width = cairo_xlib_surface_get_width(surface);
-  height = cairo_xlib_surface_get_height(surface);
+  double max_columns;
+  int max_width, max_height;
 
   current = meta_screen_get_current_xinerama(window->screen);
   max_columns = meta_prefs_get_alt_tab_max_columns();
 
   /* Scale surface to fit current screen */
-  if (width > height) {
-    max_size = MIN(MAX_PREVIEW_SIZE, MAX_PREVIEW_SCREEN_FRACTION *
-                                         ((double)current->rect.width) /
-                                         ((double)max_columns));
-    ratio = ((double)width) / max_size;
-    width = (int)max_size;
-    height = (int)(((double)height) / ratio);
-  } else {
-    max_size = MIN(MAX_PREVIEW_SIZE, MAX_PREVIEW_SCREEN_FRACTION *
-                                         ((double)current->rect.height) /
-                                         ((double)max_columns));
-    ratio = ((double)height) / max_size;
-    height = (int)max_size;
-    width = (int)(((double)width) / ratio);
-  }
-
-  meta_error_trap_push(window->display);
-  scaled = cairo_surface_create_similar(
-      surface, cairo_surface_get_content(surface), width, height);
-  if (meta_error_trap_pop_with_return(window->display, FALSE) != Success)
-    return NULL;
-
-  cr = cairo_create(scaled);
-  cairo_scale(cr, 1 / ratio, 1 / ratio);
-  cairo_set_source_surface(cr, surface, 0, 0);
-  cairo_paint(cr);
-
-  cairo_destroy(cr);
-  cairo_surface_destroy(surface);
+  max_width = (int)MIN(MAX_PREVIEW_SIZE, MAX_PREVIEW_SCREEN_FRACTION *
+                                             current->rect.width / max_columns);
+  max_height = (int)MIN(MAX_PREVIEW_SIZE, MAX_PREVIEW_SCREEN_FRACTION *
+                                              current->rect.height /
+                                              max_columns);
 
-  return scaled;
+  return meta_compositor_get_window_thumbnail(window->display->compositor,
+                                              window, max_width, max_height);
 }
 
 void meta_screen_ensure_tab_popup(MetaScreen *screen, MetaTabList list_type,
@@ -1140,7 +1164,7 @@ void meta_screen_ensure_tab_popup(MetaScreen *screen, MetaTabList list_type,
 
     /* Only get the window thumbnail surface if the user has a compositor
      * enabled and does NOT have compositing-fast-alt-tab-set to true in
-     * GSettings. There is an obvious lag when the surface is retrieved. */
+     * GSettings. */
     if (meta_prefs_get_compositing_manager() &&
         !meta_prefs_get_compositing_fast_alt_tab()) {
       cairo_surface_t *win_surface;
@@ -199,6 +199,7 @@ static Bool try_get_reply(Display *xdisplay, AgGetPropertyTask *task) {
 }
 
 static void run_speed_comparison(Display *xdisplay, Window window);
+static void run_attributes_comparison(Display *xdisplay);
 
 int main(int argc, char **argv) {
   Display *xdisplay;
@@ -300,6 +301,7 @@ int main(int argc, char **argv) {
   }
 
   run_speed_comparison(xdisplay, window);
+  run_attributes_comparison(xdisplay);
 
   return 0;
 }
@@ -407,3 +409,89 @@ static void run_speed_comparison(Display *xdisplay, Window window) {
 
   printf("Sync time:  %gms\n", ELAPSED(start, end));
 }
+
+static gboolean same_attributes(const XWindowAttributes *a,
+                                const XWindowAttributes *b) {
+  return a->x == b->x && a->y == b->y && a->width == b->width &&
+         a->height == b->height && a->border_width == b->border_width &&
+         a->depth == b->depth && a->visual == b->visual &&
+         a->root == b->root && a->class == b->class &&
+         a->bit_gravity == b->bit_gravity && a->win_gravity == b->win_gravity &&
+         a->backing_store == b->backing_store &&
+         a->backing_planes == b->backing_planes &&
+         a->backing_pixel == b->backing_pixel &&
+         a->save_under == b->save_under && a->colormap == b->colormap &&
+         a->map_installed == b->map_installed &&
+         a->map_state == b->map_state &&
+         a->all_event_masks == b->all_event_masks &&
+         a->your_event_mask == b->your_event_mask &&
+         a->do_not_propagate_mask == b->do_not_propagate_mask &&
+         a->override_redirect == b->override_redirect &&
+         a->screen == b->screen;
+}
+
+/* Checks ag_get_window_attributes() against XGetWindowAttributes() on
+ * the children of the root window, and times both
+ */
+static void run_attributes_comparison(Display *xdisplay) {
+  Window ignored1, ignored2;
+  Window *children;
+  unsigned int n_children, i;
+  XWindowAttributes *attrs;
+  XWindowAttributes sync_attrs;
+  Bool *succeeded;
+  struct timeval start, end;
+  int n_mismatched;
+
+  if (!XQueryTree(xdisplay, DefaultRootWindow(xdisplay), &ignored1, &ignored2,
+                  &children, &n_children) ||
+      n_children == 0)
+    return;
+
+  printf("Timing with %u windows\n", n_children);
+
+  attrs = g_new(XWindowAttributes, n_children);
+  succeeded = g_new(Bool, n_children);
+
+  gettimeofday(&start, NULL);
+
+  error_trap_push(xdisplay);
+  ag_get_window_attributes(xdisplay, children, n_children, attrs, succeeded);
+  error_trap_pop(xdisplay);
+
+  gettimeofday(&end, NULL);
+
+  printf("Batched attributes time: %gms\n", ELAPSED(start, end));
+
+  gettimeofday(&start, NULL);
+
+  n_mismatched = 0;
+
+  error_trap_push(xdisplay);
+
+  for (i = 0; i < n_children; i++) {
+    Bool ok;
+
+    ok = XGetWindowAttributes(xdisplay, children[i], &sync_attrs) != 0;
+
+    /* A window may come or go between the two, but not many */
+    if (ok != succeeded[i] ||
+        (ok && !same_attributes(&attrs[i], &sync_attrs))) {
+      fprintf(stderr, "Attributes of 0x%lx differ\n", children[i]);
+      n_mismatched += 1;
+    }
+  }
+
+  error_trap_pop(xdisplay);
+
+  gettimeofday(&end, NULL);
+
+  printf("Sync attributes time:    %gms\n", ELAPSED(start, end));
+
+  if (n_mismatched > 0)
+    fprintf(stderr, "%d of %u windows differ\n", n_mismatched, n_children);
+
+  g_free(succeeded);
+  g_free(attrs);
+  XFree(children);
+}
@@ -203,6 +203,105 @@ static void test_basic_fitting(void) {
   printf("%s passed.\n", G_STRFUNC);
 }
 
+static gboolean overlaps_any(const MetaRectangle *rect,
+                             const MetaRectangle *rects, int n_rects) {
+  MetaRectangle overlap;
+  int i;
+
+  for (i = 0; i < n_rects; i++)
+    if (meta_rectangle_intersect(rect, &rects[i], &overlap)) return TRUE;
+
+  return FALSE;
+}
+
+static void get_random_window_rect(MetaRectangle *rect) {
+  rect->x = rand() % 2000 - 200;
+  rect->y = rand() % 1400 - 200;
+  rect->width = rand() % 400;
+  rect->height = rand() % 300;
+}
+
+static void test_rectangle_grid(void) {
+  MetaRectangleGrid *grid;
+  MetaRectangle rects[64];
+  MetaRectangle query;
+  int i, j, n_rects;
+
+  for (i = 0; i < NUM_RANDOM_RUNS; i++) {
+    n_rects = rand() % G_N_ELEMENTS(rects);
+    for (j = 0; j < n_rects; j++) get_random_window_rect(&rects[j]);
+
+    grid = meta_rectangle_grid_new(rects, n_rects);
+
+    for (j = 0; j < 8; j++) {
+      get_random_window_rect(&query);
+      g_assert(meta_rectangle_grid_overlaps(grid, &query) ==
+               overlaps_any(&query, rects, n_rects));
+    }
+
+    meta_rectangle_grid_free(grid);
+  }
+
+  /* Touching isn't overlapping */
+  rects[0] = meta_rect(0, 0, 10, 10);
+  rects[1] = meta_rect(20, 0, 10, 10);
+  grid = meta_rectangle_grid_new(rects, 2);
+  query = meta_rect(10, 0, 10, 10);
+  g_assert(!meta_rectangle_grid_overlaps(grid, &query));
+  query = meta_rect(9, 9, 12, 1);
+  g_assert(meta_rectangle_grid_overlaps(grid, &query));
+  meta_rectangle_grid_free(grid);
+
+  printf("%s passed.\n", G_STRFUNC);
+}
+
+/* Times the candidate tests of find_first_fit () in place.c: one below
+ * and one to the right of each of 500 windows spread over a wall of
+ * 4x4 1920x1080 monitors, so that some candidates fit
+ */
+static void time_placement(void) {
+  MetaRectangle windows[500];
+  MetaRectangle *candidates;
+  MetaRectangleGrid *grid;
+  gint64 start, scan_time, grid_time;
+  int i, n_candidates, n_scan_fits, n_grid_fits;
+
+  for (i = 0; i < (int)G_N_ELEMENTS(windows); i++)
+    windows[i] =
+        meta_rect(rand() % 7680, rand() % 4320, rand() % 300 + 100,
+                  rand() % 200 + 100);
+
+  n_candidates = 2 * G_N_ELEMENTS(windows);
+  candidates = g_new(MetaRectangle, n_candidates);
+  for (i = 0; i < (int)G_N_ELEMENTS(windows); i++) {
+    candidates[2 * i] = meta_rect(BOX_LEFT(windows[i]),
+                                  BOX_BOTTOM(windows[i]), 400, 300);
+    candidates[2 * i + 1] = meta_rect(BOX_RIGHT(windows[i]),
+                                      BOX_TOP(windows[i]), 400, 300);
+  }
+
+  start = g_get_monotonic_time();
+  n_scan_fits = 0;
+  for (i = 0; i < n_candidates; i++)
+    if (!overlaps_any(&candidates[i], windows, G_N_ELEMENTS(windows)))
+      n_scan_fits++;
+  scan_time = g_get_monotonic_time() - start;
+
+  start = g_get_monotonic_time();
+  grid = meta_rectangle_grid_new(windows, G_N_ELEMENTS(windows));
+  n_grid_fits = 0;
+  for (i = 0; i < n_candidates; i++)
+    if (!meta_rectangle_grid_overlaps(grid, &candidates[i])) n_grid_fits++;
+  meta_rectangle_grid_free(grid);
+  grid_time = g_get_monotonic_time() - start;
+
+  g_assert(n_scan_fits == n_grid_fits);
+  g_free(candidates);
+
+  printf("Placement candidates for %d windows: scan %ldus, grid %ldus\n",
+         (int)G_N_ELEMENTS(windows), (long)scan_time, (long)grid_time);
+}
+
 static void free_strut_list(GSList *struts) {
   GSList *tmp = struts;
   while (tmp) {
@@ -1266,6 +1365,7 @@ int main(void) {
   test_equal();
   test_overlap_funcs();
   test_basic_fitting();
+  test_rectangle_grid();
 
   test_regions_okay();
   test_region_fitting();
@@ -1282,6 +1382,8 @@ int main(void) {
   test_gravity_resize();
   test_find_closest_point_to_line();
 
+  time_placement();
+
   printf("All tests passed.\n");
   return 0;
 }
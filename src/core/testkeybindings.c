@@ -0,0 +1,154 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Marco key binding lookup testing program */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#include <X11/Xlib.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h> /* To initialize random seed */
+
+#include "keybinding-index.h"
+
+#define N_BINDINGS 400
+#define N_EVENTS 4096
+#define N_ROUNDS 200
+
+/* Lock and Mod2, as NumLock usually is */
+#define IGNORED_MASK (LockMask | Mod2Mask)
+
+typedef struct {
+  unsigned int keycode;
+  unsigned int mask;
+  gboolean per_window;
+} Binding;
+
+static const unsigned int masks[] = {
+    0,
+    ControlMask,
+    Mod1Mask,
+    Mod4Mask,
+    ControlMask | Mod1Mask,
+    ShiftMask | Mod1Mask,
+    ShiftMask | ControlMask | Mod1Mask,
+    Mod4Mask | ShiftMask};
+
+static unsigned int random_mask(void) {
+  return masks[rand() % G_N_ELEMENTS(masks)];
+}
+
+/* What process_event () used to do */
+static int scan(const Binding *bindings, int n_bindings,
+                const XKeyEvent *event, gboolean on_window) {
+  int i;
+
+  for (i = 0; i < n_bindings; i++) {
+    if ((!on_window && bindings[i].per_window) || event->type != KeyPress ||
+        bindings[i].keycode != event->keycode ||
+        (event->state & 0xff & ~IGNORED_MASK) != bindings[i].mask)
+      continue;
+
+    return i;
+  }
+
+  return -1;
+}
+
+static void make_events(const Binding *bindings, XKeyEvent *events) {
+  int i;
+
+  for (i = 0; i < N_EVENTS; i++) {
+    XKeyEvent *event = &events[i];
+
+    event->type = rand() % 8 ? KeyPress : KeyRelease;
+
+    /* Half of them match a binding, like a user pressing shortcuts */
+    if (rand() % 2) {
+      const Binding *binding = &bindings[rand() % N_BINDINGS];
+
+      event->keycode = binding->keycode;
+      event->state = binding->mask;
+    } else {
+      event->keycode = 8 + rand() % 248;
+      event->state = random_mask();
+    }
+
+    if (rand() % 4 == 0) event->state |= LockMask;
+    if (rand() % 2) event->state |= Mod2Mask;
+  }
+}
+
+int main(void) {
+  Binding bindings[N_BINDINGS];
+  XKeyEvent events[N_EVENTS];
+  MetaKeyBindingIndex *key_index;
+  gint64 start, scan_time, index_time;
+  int i, round, sum;
+
+  srand(time(NULL));
+
+  key_index = meta_key_binding_index_new();
+
+  /* Few enough keycodes that some combos are bound twice */
+  for (i = 0; i < N_BINDINGS; i++) {
+    bindings[i].keycode = 8 + rand() % 120;
+    bindings[i].mask = random_mask();
+    bindings[i].per_window = rand() % 2;
+
+    meta_key_binding_index_add(key_index, bindings[i].keycode,
+                               bindings[i].mask, bindings[i].per_window, i);
+  }
+
+  make_events(bindings, events);
+
+  for (i = 0; i < N_EVENTS; i++) {
+    g_assert(meta_key_binding_index_lookup(key_index, &events[i], IGNORED_MASK,
+                                           TRUE) ==
+             scan(bindings, N_BINDINGS, &events[i], TRUE));
+    g_assert(meta_key_binding_index_lookup(key_index, &events[i], IGNORED_MASK,
+                                           FALSE) ==
+             scan(bindings, N_BINDINGS, &events[i], FALSE));
+  }
+
+  /* The sums keep the loops from being optimized away */
+  sum = 0;
+  start = g_get_monotonic_time();
+  for (round = 0; round < N_ROUNDS; round++)
+    for (i = 0; i < N_EVENTS; i++)
+      sum += scan(bindings, N_BINDINGS, &events[i], i % 2);
+  scan_time = g_get_monotonic_time() - start;
+
+  start = g_get_monotonic_time();
+  for (round = 0; round < N_ROUNDS; round++)
+    for (i = 0; i < N_EVENTS; i++)
+      sum -= meta_key_binding_index_lookup(key_index, &events[i], IGNORED_MASK,
+                                           i % 2);
+  index_time = g_get_monotonic_time() - start;
+
+  g_assert(sum == 0);
+
+  printf("%d bindings, ns per event: scan %.1f, index %.1f\n", N_BINDINGS,
+         scan_time * 1000.0 / (N_ROUNDS * N_EVENTS),
+         index_time * 1000.0 / (N_ROUNDS * N_EVENTS));
+
+  meta_key_binding_index_free(key_index);
+
+  return 0;
+}
@@ -453,6 +453,11 @@ MetaWindow *meta_window_new(MetaDisplay *display, Window xwindow,
 MetaWindow *meta_window_new_with_attrs(MetaDisplay *display, Window xwindow,
                                        gboolean must_be_viewable,
                                        XWindowAttributes *attrs);
+/* Fetches, in one go, the properties meta_window_new_with_attrs() reads
+ * from each window; only while the server is grabbed
+ */
+void meta_window_prefetch_properties(MetaDisplay *display,
+                                     const Window *xwindows, int n_xwindows);
 void meta_window_free(MetaWindow *window, guint32 timestamp);
 void meta_window_calc_showing(MetaWindow *window);
 void meta_window_queue(MetaWindow *window, guint queuebits);
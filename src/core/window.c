@@ -217,6 +217,64 @@ MetaWindow *meta_window_new(MetaDisplay *display, Window xwindow,
   return window;
 }
 
+#define N_INITIAL_PROPS 20
+
+/* Fill these in the order we want them to be gotten.  we want to
+ * get window name and class first so we can use them in error
+ * messages and such.  However, name is modified depending on
+ * wm_client_machine, so push it slightly sooner.
+ */
+static void get_initial_props(MetaDisplay *display,
+                              Atom props[N_INITIAL_PROPS]) {
+  int i;
+
+  i = 0;
+  props[i++] = display->atom_WM_CLIENT_MACHINE;
+  props[i++] = display->atom__NET_WM_PID;
+  props[i++] = display->atom__NET_WM_NAME;
+  props[i++] = XA_WM_CLASS;
+  props[i++] = XA_WM_NAME;
+  props[i++] = display->atom__NET_WM_ICON_NAME;
+  props[i++] = XA_WM_ICON_NAME;
+  props[i++] = display->atom__NET_WM_DESKTOP;
+  props[i++] = display->atom__NET_STARTUP_ID;
+  props[i++] = display->atom__NET_WM_SYNC_REQUEST_COUNTER;
+  props[i++] = XA_WM_NORMAL_HINTS;
+  props[i++] = display->atom_WM_PROTOCOLS;
+  props[i++] = XA_WM_HINTS;
+  props[i++] = display->atom__NET_WM_USER_TIME;
+  props[i++] = display->atom__NET_WM_STATE;
+  props[i++] = display->atom__MOTIF_WM_HINTS;
+  props[i++] = XA_WM_TRANSIENT_FOR;
+  props[i++] = display->atom__NET_WM_USER_TIME_WINDOW;
+  props[i++] = display->atom__NET_WM_FULLSCREEN_MONITORS;
+  props[i++] = display->atom__GTK_THEME_VARIANT;
+  g_assert(N_INITIAL_PROPS == i);
+}
+
+/* The properties meta_window_new_with_attrs() reads one by one, after
+ * the initial ones
+ */
+#define N_LATER_PROPS 5
+
+void meta_window_prefetch_properties(MetaDisplay *display,
+                                     const Window *xwindows, int n_xwindows) {
+  Atom props[N_INITIAL_PROPS + N_LATER_PROPS];
+  int i;
+
+  get_initial_props(display, props);
+
+  i = N_INITIAL_PROPS;
+  props[i++] = display->atom_WM_STATE;
+  props[i++] = display->atom_WM_CLIENT_LEADER;
+  props[i++] = display->atom_SM_CLIENT_ID;
+  props[i++] = display->atom_WM_WINDOW_ROLE;
+  props[i++] = display->atom__NET_WM_WINDOW_TYPE;
+  g_assert((int)G_N_ELEMENTS(props) == i);
+
+  meta_prop_prefetch(display, xwindows, n_xwindows, props, i);
+}
+
 MetaWindow *meta_window_new_with_attrs(MetaDisplay *display, Window xwindow,
                                        gboolean must_be_viewable,
                                        XWindowAttributes *attrs) {
@@ -226,13 +284,10 @@ MetaWindow *meta_window_new_with_attrs(MetaDisplay *display, Window xwindow,
   gulong existing_wm_state;
   gulong event_mask;
   MetaMoveResizeFlags flags;
-#define N_INITIAL_PROPS 20
   Atom initial_props[N_INITIAL_PROPS];
-  int i;
   gboolean has_shape;
 
   g_assert(attrs != NULL);
-  g_assert(N_INITIAL_PROPS == (int)G_N_ELEMENTS(initial_props));
 
   meta_verbose("Attempting to manage 0x%lx\n", xwindow);
 
@@ -539,33 +594,7 @@ MetaWindow *meta_window_new_with_attrs(MetaDisplay *display, Window xwindow,
   window->xgroup_leader = None;
   meta_window_compute_group(window);
 
-  /* Fill these in the order we want them to be gotten.  we want to
-   * get window name and class first so we can use them in error
-   * messages and such.  However, name is modified depending on
-   * wm_client_machine, so push it slightly sooner.
-   */
-  i = 0;
-  initial_props[i++] = display->atom_WM_CLIENT_MACHINE;
-  initial_props[i++] = display->atom__NET_WM_PID;
-  initial_props[i++] = display->atom__NET_WM_NAME;
-  initial_props[i++] = XA_WM_CLASS;
-  initial_props[i++] = XA_WM_NAME;
-  initial_props[i++] = display->atom__NET_WM_ICON_NAME;
-  initial_props[i++] = XA_WM_ICON_NAME;
-  initial_props[i++] = display->atom__NET_WM_DESKTOP;
-  initial_props[i++] = display->atom__NET_STARTUP_ID;
-  initial_props[i++] = display->atom__NET_WM_SYNC_REQUEST_COUNTER;
-  initial_props[i++] = XA_WM_NORMAL_HINTS;
-  initial_props[i++] = display->atom_WM_PROTOCOLS;
-  initial_props[i++] = XA_WM_HINTS;
-  initial_props[i++] = display->atom__NET_WM_USER_TIME;
-  initial_props[i++] = display->atom__NET_WM_STATE;
-  initial_props[i++] = display->atom__MOTIF_WM_HINTS;
-  initial_props[i++] = XA_WM_TRANSIENT_FOR;
-  initial_props[i++] = display->atom__NET_WM_USER_TIME_WINDOW;
-  initial_props[i++] = display->atom__NET_WM_FULLSCREEN_MONITORS;
-  initial_props[i++] = display->atom__GTK_THEME_VARIANT;
-  g_assert(N_INITIAL_PROPS == i);
+  get_initial_props(display, initial_props);
 
   meta_window_reload_properties(window, initial_props, N_INITIAL_PROPS, TRUE);
 
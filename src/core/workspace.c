@@ -518,9 +518,134 @@ void meta_workspace_invalidate_work_area(MetaWorkspace *workspace) {
   meta_screen_queue_workarea_recalc(workspace->screen);
 }
 
+/* Spanning sets are memoized per screen, keyed by the basic rect and
+ * the struts that overlap it. So a strut changing on one xinerama
+ * doesn't recompute the others, and the sets are computed once for all
+ * the workspaces sharing the same struts.
+ */
+#define MAX_SPANNING_SETS 64
+
+static void free_region(gpointer region) { g_list_free_full(region, g_free); }
+
+static GList *copy_list(const GList *list, gsize size) {
+  GList *copy;
+
+  copy = NULL;
+  for (; list != NULL; list = list->next) {
+    gpointer item = g_malloc(size);
+
+    memcpy(item, list->data, size);
+    copy = g_list_prepend(copy, item);
+  }
+
+  return g_list_reverse(copy);
+}
+
+static GList *get_spanning_set(MetaScreen *screen,
+                               const MetaRectangle *basic_rect,
+                               const GSList *all_struts,
+                               gboolean skip_middle_struts) {
+  GByteArray *key_data;
+  GBytes *key;
+  GSList *struts;
+  const GSList *tmp;
+  gpointer region;
+
+  key_data = g_byte_array_sized_new(256);
+  g_byte_array_append(key_data, (const guint8 *)basic_rect,
+                      sizeof(*basic_rect));
+  g_byte_array_append(key_data, (const guint8 *)&skip_middle_struts,
+                      sizeof(skip_middle_struts));
+
+  struts = NULL;
+  for (tmp = all_struts; tmp != NULL; tmp = tmp->next) {
+    MetaStrut *strut = tmp->data;
+
+    /* These don't change the result */
+    if (!meta_rectangle_overlap(&strut->rect, basic_rect)) continue;
+
+    g_byte_array_append(key_data, (const guint8 *)strut, sizeof(*strut));
+    struts = g_slist_prepend(struts, strut);
+  }
+  struts = g_slist_reverse(struts);
+  key = g_byte_array_free_to_bytes(key_data);
+
+  if (screen->spanning_sets == NULL)
+    screen->spanning_sets =
+        g_hash_table_new_full(g_bytes_hash, g_bytes_equal,
+                              (GDestroyNotify)g_bytes_unref, free_region);
+
+  /* The region may be NULL, if struts cover all of basic_rect */
+  if (g_hash_table_lookup_extended(screen->spanning_sets, key, NULL,
+                                   &region)) {
+    g_bytes_unref(key);
+  } else {
+    /* Animated struts would grow the memo forever */
+    if (g_hash_table_size(screen->spanning_sets) >= MAX_SPANNING_SETS)
+      g_hash_table_remove_all(screen->spanning_sets);
+
+    region = meta_rectangle_get_minimal_spanning_set_for_region(
+        basic_rect, struts, skip_middle_struts);
+    g_hash_table_insert(screen->spanning_sets, key, region);
+  }
+  g_slist_free(struts);
+
+  return copy_list(region, sizeof(MetaRectangle));
+}
+
+static gboolean same_struts(const GSList *a, const GSList *b) {
+  for (; a != NULL && b != NULL; a = a->next, b = b->next)
+    if (memcmp(a->data, b->data, sizeof(MetaStrut)) != 0) return FALSE;
+
+  return a == NULL && b == NULL;
+}
+
+/* Returns another workspace whose work areas are valid and were
+ * computed from the same struts as workspace's, or NULL
+ */
+static MetaWorkspace *find_workspace_with_same_struts(
+    MetaWorkspace *workspace) {
+  GList *tmp;
+
+  for (tmp = workspace->screen->workspaces; tmp != NULL; tmp = tmp->next) {
+    MetaWorkspace *other = tmp->data;
+
+    if (other != workspace && !other->work_areas_invalid &&
+        same_struts(other->all_struts, workspace->all_struts))
+      return other;
+  }
+
+  return NULL;
+}
+
+static void copy_work_areas(MetaWorkspace *workspace, MetaWorkspace *other) {
+  int i;
+
+  workspace->work_area_screen = other->work_area_screen;
+
+  g_free(workspace->work_area_xinerama);
+  workspace->work_area_xinerama =
+      g_new(MetaRectangle, workspace->screen->n_xinerama_infos);
+  memcpy(workspace->work_area_xinerama, other->work_area_xinerama,
+         workspace->screen->n_xinerama_infos * sizeof(MetaRectangle));
+
+  workspace->xinerama_region =
+      g_new(GList *, workspace->screen->n_xinerama_infos);
+  for (i = 0; i < workspace->screen->n_xinerama_infos; i++)
+    workspace->xinerama_region[i] =
+        copy_list(other->xinerama_region[i], sizeof(MetaRectangle));
+  workspace->screen_region =
+      copy_list(other->screen_region, sizeof(MetaRectangle));
+
+  workspace->screen_edges = copy_list(other->screen_edges, sizeof(MetaEdge));
+  workspace->xinerama_edges =
+      copy_list(other->xinerama_edges, sizeof(MetaEdge));
+}
+
 static void ensure_work_areas_validated(MetaWorkspace *workspace) {
   GList *windows;
   GList *tmp;
+  MetaWorkspace *other;
   MetaRectangle work_area;
   int i; /* C89 absolutely sucks... */
 
@@ -546,6 +671,19 @@ static void ensure_work_areas_validated(MetaWorkspace *workspace) {
   }
   g_list_free(windows);
 
+  /* Docks are usually on all workspaces, so the other workspaces may
+   * already have done the rest of the work
+   */
+  other = find_workspace_with_same_struts(workspace);
+  if (other != NULL) {
+    copy_work_areas(workspace, other);
+    meta_topic(META_DEBUG_WORKAREA,
+               "Copied work areas for workspace %d from workspace %d\n",
+               meta_workspace_index(workspace), meta_workspace_index(other));
+    workspace->work_areas_invalid = FALSE;
+    return;
+  }
+
   /* STEP 2: Get the maximal/spanning rects for the onscreen and
    *         on-single-xinerama regions
    */
@@ -555,13 +693,13 @@ static void ensure_work_areas_validated(MetaWorkspace *workspace) {
   workspace->xinerama_region =
       g_new(GList *, workspace->screen->n_xinerama_infos);
   for (i = 0; i < workspace->screen->n_xinerama_infos; i++) {
-    workspace->xinerama_region[i] =
-        meta_rectangle_get_minimal_spanning_set_for_region(
-            &workspace->screen->xinerama_infos[i].rect, workspace->all_struts,
-            FALSE);
+    workspace->xinerama_region[i] = get_spanning_set(
+        workspace->screen, &workspace->screen->xinerama_infos[i].rect,
+        workspace->all_struts, FALSE);
   }
-  workspace->screen_region = meta_rectangle_get_minimal_spanning_set_for_region(
-      &workspace->screen->rect, workspace->all_struts, TRUE);
+  workspace->screen_region =
+      get_spanning_set(workspace->screen, &workspace->screen->rect,
+                       workspace->all_struts, TRUE);
 
   /* STEP 3: Get the work areas (region-to-maximize-to) for the screen and
    *         xineramas.
@@ -169,6 +169,159 @@ static gboolean validate_or_free_results(GetPropertyResults *results,
   return FALSE;
 }
 
+typedef struct {
+  Atom xatom;
+  Atom type;
+  int format;
+  unsigned long n_items;
+  unsigned long bytes_after;
+  unsigned char *prop;
+} PrefetchedProperty;
+
+typedef struct {
+  Window xwindow;
+  GHashTable *props; /* Atom -> PrefetchedProperty */
+} PrefetchedWindow;
+
+static void free_prefetched_property(gpointer data) {
+  PrefetchedProperty *prefetched = data;
+
+  if (prefetched->prop) XFree(prefetched->prop);
+  g_free(prefetched);
+}
+
+static void free_prefetched_window(gpointer data) {
+  PrefetchedWindow *prefetched = data;
+
+  g_hash_table_destroy(prefetched->props);
+  g_free(prefetched);
+}
+
+static PrefetchedProperty *lookup_prefetched(MetaDisplay *display,
+                                             Window xwindow, Atom xatom) {
+  PrefetchedWindow *prefetched;
+
+  if (display->prefetched_props == NULL) return NULL;
+
+  prefetched = g_hash_table_lookup(display->prefetched_props, &xwindow);
+  if (prefetched == NULL) return NULL;
+
+  return g_hash_table_lookup(prefetched->props, &xatom);
+}
+
+/* Fills in results as the GetProperty request would have, and forgets
+ * the value. Returns FALSE if it wasn't prefetched.
+ */
+static gboolean take_prefetched(MetaDisplay *display, Window xwindow,
+                                Atom xatom, Atom req_type,
+                                GetPropertyResults *results) {
+  PrefetchedWindow *window;
+  PrefetchedProperty *prefetched;
+
+  prefetched = lookup_prefetched(display, xwindow, xatom);
+  if (prefetched == NULL) return FALSE;
+
+  results->type = prefetched->type;
+  results->format = prefetched->format;
+  results->n_items = prefetched->n_items;
+  results->bytes_after = prefetched->bytes_after;
+  results->prop = prefetched->prop;
+
+  window = g_hash_table_lookup(display->prefetched_props, &xwindow);
+  g_hash_table_steal(window->props, &xatom);
+  g_free(prefetched);
+
+  /* It was fetched with AnyPropertyType; the server sends the type
+   * and the length, but no data, when the type doesn't match.
+   */
+  if (results->type != None && req_type != AnyPropertyType &&
+      results->type != req_type) {
+    results->bytes_after = results->n_items * (results->format / 8);
+    results->n_items = 0;
+    if (results->prop) XFree(results->prop);
+    results->prop = ag_Xmalloc0(1);
+  }
+
+  return TRUE;
+}
+
+static void add_prefetched(MetaDisplay *display, AgGetPropertyTask *task) {
+  PrefetchedWindow *window;
+  PrefetchedProperty *prefetched;
+  Window xwindow;
+
+  xwindow = ag_task_get_window(task);
+  window = g_hash_table_lookup(display->prefetched_props, &xwindow);
+  if (window == NULL) {
+    window = g_new(PrefetchedWindow, 1);
+    window->xwindow = xwindow;
+    window->props =
+        g_hash_table_new_full(meta_unsigned_long_hash, meta_unsigned_long_equal,
+                              NULL, free_prefetched_property);
+    g_hash_table_replace(display->prefetched_props, &window->xwindow, window);
+  }
+
+  prefetched = g_new0(PrefetchedProperty, 1);
+  prefetched->xatom = ag_task_get_property(task);
+
+  /* An error, such as the window being gone, reads as an unset property
+   * just like it does in get_property()
+   */
+  if (ag_task_get_reply_and_free(task, &prefetched->type, &prefetched->format,
+                                 &prefetched->n_items, &prefetched->bytes_after,
+                                 &prefetched->prop) != Success) {
+    if (prefetched->prop) XFree(prefetched->prop);
+    prefetched->prop = NULL;
+    prefetched->type = None;
+  }
+
+  g_hash_table_replace(window->props, &prefetched->xatom, prefetched);
+}
+
+void meta_prop_prefetch(MetaDisplay *display, const Window *xwindows,
+                        int n_xwindows, const Atom *xatoms, int n_xatoms) {
+  AgGetPropertyTask *task;
+  int i, j;
+
+  if (n_xwindows == 0 || n_xatoms == 0) return;
+
+  if (display->prefetched_props == NULL)
+    display->prefetched_props =
+        g_hash_table_new_full(meta_unsigned_long_hash, meta_unsigned_long_equal,
+                              NULL, free_prefetched_window);
+
+  /* Windows may be gone already; with XCB the errors for them don't
+   * reach the tasks, but the error handler
+   */
+  meta_error_trap_push(display);
+
+  for (i = 0; i < n_xwindows; i++)
+    for (j = 0; j < n_xatoms; j++)
+      ag_task_create(display->xdisplay, xwindows[i], xatoms[j], 0, G_MAXLONG,
+                     False, AnyPropertyType);
+
+  meta_topic(META_DEBUG_SYNC, "Syncing to get %d GetProperty replies in %s\n",
+             n_xwindows * n_xatoms, G_STRFUNC);
+  XSync(display->xdisplay, False);
+
+  meta_error_trap_pop(display, TRUE);
+
+  while ((task = ag_get_next_completed_task(display->xdisplay)) != NULL)
+    add_prefetched(display, task);
+}
+
+void meta_prop_forget_prefetched(MetaDisplay *display, Window xwindow) {
+  if (display->prefetched_props == NULL) return;
+
+  if (xwindow != None) {
+    g_hash_table_remove(display->prefetched_props, &xwindow);
+    return;
+  }
+
+  g_hash_table_destroy(display->prefetched_props);
+  display->prefetched_props = NULL;
+}
+
 static gboolean get_property(MetaDisplay *display, Window xwindow, Atom xatom,
                              Atom req_type, GetPropertyResults *results) {
   results->display = display;
@@ -180,6 +333,13 @@ static gboolean get_property(MetaDisplay *display, Window xwindow, Atom xatom,
   results->bytes_after = 0;
   results->format = 0;
 
+  if (take_prefetched(display, xwindow, xatom, req_type, results)) {
+    if (results->type != None) return TRUE;
+
+    if (results->prop) XFree(results->prop);
+    return FALSE;
+  }
+
   meta_error_trap_push(display);
   if (XGetWindowProperty(display->xdisplay, xwindow, xatom, 0, G_MAXLONG, False,
                          req_type, &results->type, &results->format,
@@ -822,7 +982,7 @@ static char *latin1_to_utf8(const char *text) {
 
 void meta_prop_get_values(MetaDisplay *display, Window xwindow,
                           MetaPropValue *values, int n_values) {
-  int i;
+  int i, n_tasks;
   AgGetPropertyTask **tasks;
 
   meta_verbose("Requesting %d properties of 0x%lx at once\n", n_values,
@@ -835,6 +995,7 @@ void meta_prop_get_values(MetaDisplay *display, Window xwindow,
   /* Start up tasks. The "values" array can have values
    * with atom == None, which means to ignore that element.
    */
+  n_tasks = 0;
   i = 0;
   while (i < n_values) {
     if (values[i].required_type == None) {
@@ -885,35 +1046,31 @@ void meta_prop_get_values(MetaDisplay *display, Window xwindow,
       }
     }
 
-    if (values[i].atom != None)
+    /* Prefetched values are picked up below */
+    if (values[i].atom != None &&
+        lookup_prefetched(display, xwindow, values[i].atom) == NULL) {
       tasks[i] =
           get_task(display, xwindow, values[i].atom, values[i].required_type);
+      if (tasks[i] != NULL) n_tasks += 1;
+    }
 
     ++i;
   }
 
   /* Get replies for all our tasks */
-  meta_topic(META_DEBUG_SYNC, "Syncing to get %d GetProperty replies in %s\n",
-             n_values, G_STRFUNC);
-  XSync(display->xdisplay, False);
+  if (n_tasks > 0) {
+    meta_topic(META_DEBUG_SYNC,
+               "Syncing to get %d GetProperty replies in %s\n", n_tasks,
+               G_STRFUNC);
+    XSync(display->xdisplay, False);
+  }
 
   /* Collect results, should arrive in order requested */
   i = 0;
   while (i < n_values) {
     AgGetPropertyTask *task;
     GetPropertyResults results;
-
-    if (tasks[i] == NULL) {
-      /* Probably values[i].type was None, or ag_task_create()
-       * returned NULL.
-       */
-      values[i].type = META_PROP_VALUE_INVALID;
-      goto next;
-    }
-
-    task = ag_get_next_completed_task(display->xdisplay);
-    g_assert(task != NULL);
-    g_assert(ag_task_have_reply(task));
+    Status status;
 
     results.display = display;
     results.xwindow = xwindow;
@@ -924,10 +1081,27 @@ void meta_prop_get_values(MetaDisplay *display, Window xwindow,
     results.bytes_after = 0;
     results.format = 0;
 
-    if (ag_task_get_reply_and_free(task, &results.type, &results.format,
-                                   &results.n_items, &results.bytes_after,
-                                   &results.prop) != Success ||
-        results.type == None) {
+    if (tasks[i] != NULL) {
+      task = ag_get_next_completed_task(display->xdisplay);
+      g_assert(task != NULL);
+      g_assert(ag_task_have_reply(task));
+
+      status = ag_task_get_reply_and_free(task, &results.type, &results.format,
+                                          &results.n_items,
+                                          &results.bytes_after, &results.prop);
+    } else if (values[i].atom != None &&
+               take_prefetched(display, xwindow, values[i].atom,
+                               values[i].required_type, &results)) {
+      status = Success;
+    } else {
+      /* Probably values[i].type was None, or ag_task_create()
+       * returned NULL.
+       */
+      values[i].type = META_PROP_VALUE_INVALID;
+      goto next;
+    }
+
+    if (status != Success || results.type == None) {
       values[i].type = META_PROP_VALUE_INVALID;
       if (results.prop) {
         XFree(results.prop);
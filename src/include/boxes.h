@@ -125,6 +125,19 @@ gboolean meta_rectangle_could_fit_rect(const MetaRectangle *outer_rect,
 gboolean meta_rectangle_contains_rect(const MetaRectangle *outer_rect,
                                       const MetaRectangle *inner_rect);
 
+/* An index of a set of rectangles, to find out quickly whether some
+ * rectangle intersects (as in meta_rectangle_intersect) any of them.
+ * Building it is linear in the number of rectangles; a query only
+ * looks at the ones near the rectangle.
+ */
+typedef struct _MetaRectangleGrid MetaRectangleGrid;
+
+MetaRectangleGrid *meta_rectangle_grid_new(const MetaRectangle *rects,
+                                           int n_rects);
+void meta_rectangle_grid_free(MetaRectangleGrid *grid);
+gboolean meta_rectangle_grid_overlaps(const MetaRectangleGrid *grid,
+                                      const MetaRectangle *rect);
+
 /* Resize old_rect to the given new_width and new_height, but store the
  * result in rect.  NOTE THAT THIS IS RESIZE ONLY SO IT CANNOT BE USED FOR
  * A MOVERESIZE OPERATION (that simplies the routine a little bit as it
@@ -151,6 +164,13 @@ GList *meta_rectangle_get_minimal_spanning_set_for_region(
     const MetaRectangle *basic_rect, const GSList *all_struts,
     gboolean skip_middle_struts);
 
+/* Same, but returns a GArray of MetaRectangles; free it with
+ * g_array_unref()
+ */
+GArray *meta_rectangle_get_minimal_spanning_array_for_region(
+    const MetaRectangle *basic_rect, const GSList *all_struts,
+    gboolean skip_middle_struts);
+
 /* Expand all rectangles in region by the given amount on each side */
 GList *meta_rectangle_expand_region(GList *region, const int left_expand,
                                     const int right_expand,
@@ -239,16 +259,21 @@ gint meta_rectangle_edge_cmp(gconstpointer a, gconstpointer b);
 gint meta_rectangle_edge_cmp_ignore_type(gconstpointer a, gconstpointer b);
 
 /* Removes an parts of edges in the given list that intersect any box in the
- * given rectangle list.  Returns the result.
+ * given rectangle list.  Returns the result.  The _array versions of this
+ * and the functions below work on GArrays of MetaEdges instead.
  */
 GList *meta_rectangle_remove_intersections_with_boxes_from_edges(
     GList *edges, const GSList *rectangles);
+void meta_rectangle_remove_intersections_with_boxes_from_edge_array(
+    GArray *edges, const GSList *rectangles);
 
 /* Finds all the edges of an onscreen region, returning a GList* of
  * MetaEdgeRect's.
  */
 GList *meta_rectangle_find_onscreen_edges(const MetaRectangle *basic_rect,
                                           const GSList *all_struts);
+GArray *meta_rectangle_find_onscreen_edge_array(const MetaRectangle *basic_rect,
+                                                const GSList *all_struts);
 
 /* Finds edges between adjacent xineramas which are not covered by the given
  * struts.
@@ -256,5 +281,8 @@ GList *meta_rectangle_find_onscreen_edges(const MetaRectangle *basic_rect,
 GList *meta_rectangle_find_nonintersected_xinerama_edges(
     const MetaRectangle *screen_rect, const GList *xinerama_rects,
     const GSList *all_struts);
+GArray *meta_rectangle_find_nonintersected_xinerama_edge_array(
+    const MetaRectangle *screen_rect, const GList *xinerama_rects,
+    const GSList *all_struts);
 
 #endif /* META_BOXES_H */
@@ -62,4 +62,16 @@ void meta_compositor_maximize_window(MetaCompositor *compositor,
                                      MetaWindow *window);
 void meta_compositor_unmaximize_window(MetaCompositor *compositor,
                                        MetaWindow *window);
+
+/* Returns "name=value" lines describing the painting done so far, or
+   NULL if the compositor keeps no statistics. Free with g_free (). */
+char *meta_compositor_get_stats(MetaCompositor *compositor);
+
+/* Returns a scaled copy of the window whose longer side is max_width
+   (landscape windows) or max_height (portrait ones), reusing the copy
+   made for the previous call when it is recent enough. Release it with
+   cairo_surface_destroy (). */
+cairo_surface_t *meta_compositor_get_window_thumbnail(
+    MetaCompositor *compositor, MetaWindow *window, int max_width,
+    int max_height);
 #endif
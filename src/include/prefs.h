@@ -65,6 +65,10 @@ typedef enum {
   META_PREF_ALT_TAB_EXPAND_TO_FIT_TITLE,
   META_PREF_COMPOSITING_MANAGER,
   META_PREF_COMPOSITING_FAST_ALT_TAB,
+  META_PREF_COMPOSITING_UNREDIRECT_FULLSCREEN,
+  META_PREF_COMPOSITING_MAX_FRAME_RATE,
+  META_PREF_COMPOSITING_BUFFER_COUNT,
+  META_PREF_DRAW_CACHE_SIZE,
   META_PREF_RESIZE_WITH_RIGHT_BUTTON,
   META_PREF_SHOW_TAB_BORDER,
   META_PREF_CENTER_NEW_WINDOWS,
@@ -135,6 +139,10 @@ int meta_prefs_get_alt_tab_max_columns(void);
 gboolean meta_prefs_get_alt_tab_expand_to_fit_title(void);
 gboolean meta_prefs_get_compositing_manager(void);
 gboolean meta_prefs_get_compositing_fast_alt_tab(void);
+gboolean meta_prefs_get_compositing_unredirect_fullscreen(void);
+int meta_prefs_get_compositing_max_frame_rate(void);
+int meta_prefs_get_compositing_buffer_count(void);
+int meta_prefs_get_draw_cache_size(void);
 gboolean meta_prefs_get_center_new_windows(void);
 gboolean meta_prefs_get_force_fullscreen(void);
 gboolean meta_prefs_show_tab_border(void);
@@ -180,4 +180,17 @@ void meta_prop_get_values(MetaDisplay *display, Window xwindow,
 
 void meta_prop_free_values(MetaPropValue *values, int n_values);
 
+/* Fetches every atom of every window with a single round trip. Each
+ * value is then returned, once, by the first meta_prop_get_*() call
+ * that asks for it, instead of being fetched again. Only worth it
+ * while the server is grabbed, so that the values can't go stale.
+ */
+void meta_prop_prefetch(MetaDisplay *display, const Window *xwindows,
+                        int n_xwindows, const Atom *xatoms, int n_xatoms);
+
+/* Drops the unused values prefetched for xwindow, or for every window
+ * if xwindow is None
+ */
+void meta_prop_forget_prefetched(MetaDisplay *display, Window xwindow);
+
 #endif
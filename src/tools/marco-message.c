@@ -26,6 +26,7 @@
 #include <gdk/gdkx.h>
 #include <glib/gi18n.h>
 #include <gtk/gtk.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -127,11 +128,77 @@ static void send_toggle_verbose(void) {
 }
 #endif
 
+static gboolean print_compositor_stats(void) {
+  Display *xdisplay = GDK_DISPLAY_XDISPLAY(gdk_display_get_default());
+  Window xroot = gdk_x11_get_default_root_xwindow();
+  Atom stats_atom, utf8_atom, type;
+  XEvent xev;
+  int format, tries;
+  unsigned long n_items, bytes_after;
+  unsigned char *data = NULL;
+  gboolean answered = FALSE;
+
+  stats_atom = XInternAtom(xdisplay, "_MARCO_COMPOSITOR_STATS", False);
+  utf8_atom = XInternAtom(xdisplay, "UTF8_STRING", False);
+
+  /* Marco answers by setting the property, so watch for it before asking */
+  XSelectInput(xdisplay, xroot, PropertyChangeMask);
+
+  xev.xclient.type = ClientMessage;
+  xev.xclient.serial = 0;
+  xev.xclient.send_event = True;
+  xev.xclient.display = xdisplay;
+  xev.xclient.window = xroot;
+  xev.xclient.message_type =
+      XInternAtom(xdisplay, "_MARCO_COMPOSITOR_STATS_MESSAGE", False);
+  xev.xclient.format = 32;
+  xev.xclient.data.l[0] = 0;
+  xev.xclient.data.l[1] = 0;
+  xev.xclient.data.l[2] = 0;
+
+  XSendEvent(xdisplay, xroot, False,
+             SubstructureRedirectMask | SubstructureNotifyMask, &xev);
+  XFlush(xdisplay);
+
+  for (tries = 0; tries < 200 && !answered; tries++) {
+    while (XCheckTypedWindowEvent(xdisplay, xroot, PropertyNotify, &xev)) {
+      if (xev.xproperty.atom == stats_atom &&
+          xev.xproperty.state == PropertyNewValue)
+        answered = TRUE;
+    }
+
+    if (!answered) g_usleep(10 * G_USEC_PER_SEC / 1000);
+  }
+
+  if (!answered) {
+    g_printerr(_("Marco did not answer the request\n"));
+    return FALSE;
+  }
+
+  if (XGetWindowProperty(xdisplay, xroot, stats_atom, 0, G_MAXLONG, False,
+                         utf8_atom, &type, &format, &n_items, &bytes_after,
+                         &data) != Success ||
+      type != utf8_atom || format != 8) {
+    if (data) XFree(data);
+    g_printerr(_("Could not read the compositor statistics\n"));
+    return FALSE;
+  }
+
+  if (n_items == 0)
+    g_printerr(_("The compositing manager is not running\n"));
+  else
+    fwrite(data, 1, n_items, stdout);
+
+  XFree(data);
+
+  return n_items != 0;
+}
+
 static void usage(void) {
   g_printerr(_("Usage: %s\n"),
              "marco-message "
              "(restart|reload-theme|enable-keybindings|disable-keybindings|"
-             "toggle-verbose)");
+             "toggle-verbose|compositor-stats)");
   exit(1);
 }
 
@@ -157,6 +224,8 @@ int main(int argc, char **argv) {
 #else
     send_toggle_verbose();
 #endif
+  } else if (strcmp(argv[1], "compositor-stats") == 0) {
+    if (!print_compositor_stats()) return 1;
   } else
     usage();
 
@@ -0,0 +1,163 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Marco cache of rendered theme images */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "draw-cache.h"
+
+#include <glib-object.h>
+#include <math.h>
+#include <string.h>
+
+#include "prefs.h"
+
+typedef struct {
+  GList link; /* in lru; data points back to the entry */
+  GBytes *key;
+  cairo_surface_t *surface;
+  gpointer source;
+  gsize size;
+} CacheEntry;
+
+/* GBytes key -> CacheEntry */
+static GHashTable *entries = NULL;
+
+/* Most recently used first */
+static GQueue lru = G_QUEUE_INIT;
+
+static MetaDrawCacheStats stats;
+
+static void free_entry(gpointer data) {
+  CacheEntry *entry = data;
+
+  g_queue_unlink(&lru, &entry->link);
+  stats.bytes -= entry->size;
+
+  cairo_surface_destroy(entry->surface);
+  if (entry->source) g_object_unref(entry->source);
+
+  /* The hash table frees the key */
+  g_free(entry);
+}
+
+/* Roughly the memory the surface takes, counted in device pixels so
+   that scaled and unscaled surfaces are measured the same way */
+static gsize get_surface_size(cairo_surface_t *surface, double width,
+                              double height) {
+  double scale_x, scale_y;
+
+  cairo_surface_get_device_scale(surface, &scale_x, &scale_y);
+
+  return (gsize)ceil(width * scale_x) * (gsize)ceil(height * scale_y) * 4;
+}
+
+static gsize get_limit(void) {
+  return (gsize)meta_prefs_get_draw_cache_size() * 1024;
+}
+
+static void evict(gsize limit) {
+  while (stats.bytes > limit && lru.tail != NULL) {
+    CacheEntry *entry = lru.tail->data;
+
+    g_hash_table_remove(entries, entry->key);
+    stats.evictions++;
+  }
+}
+
+GByteArray *meta_draw_cache_key_new(const char *kind) {
+  GByteArray *key;
+
+  key = g_byte_array_sized_new(64);
+  g_byte_array_append(key, (const guint8 *)kind, strlen(kind) + 1);
+
+  return key;
+}
+
+cairo_surface_t *meta_draw_cache_lookup(const GByteArray *key) {
+  CacheEntry *entry;
+  GBytes *bytes;
+
+  entry = NULL;
+  if (entries != NULL) {
+    bytes = g_bytes_new_static(key->data, key->len);
+    entry = g_hash_table_lookup(entries, bytes);
+    g_bytes_unref(bytes);
+  }
+
+  if (entry == NULL) {
+    stats.misses++;
+    return NULL;
+  }
+
+  stats.hits++;
+
+  g_queue_unlink(&lru, &entry->link);
+  g_queue_push_head_link(&lru, &entry->link);
+
+  return cairo_surface_reference(entry->surface);
+}
+
+void meta_draw_cache_insert(const GByteArray *key, cairo_surface_t *surface,
+                            gpointer source, double width, double height) {
+  CacheEntry *entry;
+  gsize limit, size;
+
+  limit = get_limit();
+  size = get_surface_size(surface, width, height);
+
+  /* This also catches up with a preference that shrank */
+  if (size > limit) {
+    evict(limit);
+    return;
+  }
+
+  evict(limit - size);
+
+  if (entries == NULL)
+    entries = g_hash_table_new_full(g_bytes_hash, g_bytes_equal,
+                                    (GDestroyNotify)g_bytes_unref, free_entry);
+
+  entry = g_new0(CacheEntry, 1);
+  entry->link.data = entry;
+  entry->key = g_bytes_new(key->data, key->len);
+  entry->surface = cairo_surface_reference(surface);
+  entry->source = source ? g_object_ref(source) : NULL;
+  entry->size = size;
+
+  /* Replaces, and so frees, any entry with the same key */
+  g_hash_table_replace(entries, entry->key, entry);
+
+  g_queue_push_head_link(&lru, &entry->link);
+  stats.bytes += size;
+}
+
+void meta_draw_cache_clear(void) {
+  if (entries != NULL) g_hash_table_remove_all(entries);
+
+  memset(&stats, 0, sizeof(stats));
+}
+
+void meta_draw_cache_get_stats(MetaDrawCacheStats *stats_out) {
+  *stats_out = stats;
+  stats_out->n_entries = lru.length;
+}
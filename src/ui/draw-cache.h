@@ -0,0 +1,62 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Marco cache of rendered theme images */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef META_DRAW_CACHE_H
+#define META_DRAW_CACHE_H
+
+#include <cairo.h>
+#include <glib.h>
+
+typedef struct {
+  guint64 hits;
+  guint64 misses;
+  guint64 evictions;
+  guint n_entries;
+  gsize bytes;
+} MetaDrawCacheStats;
+
+/* A key is the bytes of every value the image depends on, starting
+ * with a name for the kind of image. Add only scalars and structs
+ * without padding.
+ */
+GByteArray *meta_draw_cache_key_new(const char *kind);
+
+#define meta_draw_cache_key_add(key, value) \
+  g_byte_array_append((key), (const guint8 *)&(value), sizeof(value))
+
+/* Returns a new reference to the surface stored under key, or NULL */
+cairo_surface_t *meta_draw_cache_lookup(const GByteArray *key);
+
+/* Stores surface, which is width x height in user space, under key,
+ * dropping the least recently used surfaces to stay within the
+ * draw-cache-size preference. If the key holds the address of an object, pass it as
+ * source: it is kept alive as long as the entry, so that the address
+ * can't be reused by another object.
+ */
+void meta_draw_cache_insert(const GByteArray *key, cairo_surface_t *surface,
+                            gpointer source, double width, double height);
+
+/* Drops every surface and zeroes the statistics */
+void meta_draw_cache_clear(void);
+
+void meta_draw_cache_get_stats(MetaDrawCacheStats *stats);
+
+#endif
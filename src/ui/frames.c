@@ -135,6 +135,55 @@ static gint unsigned_long_equal(gconstpointer v1, gconstpointer v2) {
   return *((const gulong *)v1) == *((const gulong *)v2);
 }
 
+typedef struct {
+  GtkStyleContext *style;
+  MetaFrameType type;
+  MetaFrameFlags flags;
+  int text_height;
+  int width; /* of the client */
+  int height;
+  int scale;
+  int piece; /* index into CachedPixels */
+} SharedPieceKey;
+
+typedef struct {
+  cairo_surface_t *pixmap;
+  gboolean used; /* since invalidate_cache_timeout () last ran */
+} SharedPiece;
+
+static void shared_piece_free(gpointer data) {
+  SharedPiece *shared = data;
+
+  cairo_surface_destroy(shared->pixmap);
+  g_free(shared);
+}
+
+static guint shared_piece_key_hash(gconstpointer v) {
+  const SharedPieceKey *key = v;
+  guint hash;
+
+  hash = g_direct_hash(key->style);
+  hash = hash * 31 + key->type;
+  hash = hash * 31 + key->flags;
+  hash = hash * 31 + key->text_height;
+  hash = hash * 31 + key->width;
+  hash = hash * 31 + key->height;
+  hash = hash * 31 + key->scale;
+  hash = hash * 31 + key->piece;
+
+  return hash;
+}
+
+static gboolean shared_piece_key_equal(gconstpointer a, gconstpointer b) {
+  const SharedPieceKey *ka = a;
+  const SharedPieceKey *kb = b;
+
+  return ka->style == kb->style && ka->type == kb->type &&
+         ka->flags == kb->flags && ka->text_height == kb->text_height &&
+         ka->width == kb->width && ka->height == kb->height &&
+         ka->scale == kb->scale && ka->piece == kb->piece;
+}
+
 static guint unsigned_long_hash(gconstpointer v) {
   gulong val = *(const gulong *)v;
 
@@ -154,6 +203,9 @@ static void prefs_changed_callback(MetaPreference pref, void *data) {
     case META_PREF_BUTTON_LAYOUT:
       meta_frames_button_layout_changed(META_FRAMES(data));
       break;
+    case META_PREF_THEME:
+      g_hash_table_remove_all(META_FRAMES(data)->shared_pieces);
+      break;
     default:
       break;
   }
@@ -224,6 +276,10 @@ static void meta_frames_init(MetaFrames *frames) {
   frames->invalidate_cache_timeout_id = 0;
   frames->invalidate_frames = NULL;
   frames->cache = g_hash_table_new(g_direct_hash, g_direct_equal);
+  frames->shared_pieces =
+      g_hash_table_new_full(shared_piece_key_hash, shared_piece_key_equal,
+                            g_free, shared_piece_free);
+  frames->shared_pieces_theme = NULL;
   frames->style_variants =
       g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
   update_style_contexts(frames);
@@ -289,6 +345,7 @@ static void meta_frames_finalize(GObject *object) {
   g_assert(g_hash_table_size(frames->frames) == 0);
   g_hash_table_destroy(frames->frames);
   g_hash_table_destroy(frames->cache);
+  g_hash_table_destroy(frames->shared_pieces);
 
   G_OBJECT_CLASS(meta_frames_parent_class)->finalize(object);
 }
@@ -342,10 +399,24 @@ static void invalidate_all_caches(MetaFrames *frames) {
   frames->invalidate_frames = NULL;
 }
 
+/* Keeps the pieces in use, but lets go of the sizes that windows have
+   been resized away from */
+static gboolean shared_piece_unused(gpointer key, gpointer value,
+                                    gpointer data) {
+  SharedPiece *shared = value;
+
+  if (!shared->used) return TRUE;
+
+  shared->used = FALSE;
+  return FALSE;
+}
+
 static gboolean invalidate_cache_timeout(gpointer data) {
   MetaFrames *frames = data;
 
   invalidate_all_caches(frames);
+  g_hash_table_foreach_remove(frames->shared_pieces, shared_piece_unused,
+                              NULL);
   frames->invalidate_cache_timeout_id = 0;
   return FALSE;
 }
@@ -376,6 +447,9 @@ static void meta_frames_font_changed(MetaFrames *frames) {
     frames->text_heights = g_hash_table_new(NULL, NULL);
   }
 
+  /* Also called when the GTK style changes */
+  g_hash_table_remove_all(frames->shared_pieces);
+
   /* Queue a draw/resize on all frames */
   g_hash_table_foreach(frames->frames, queue_recalc_func, frames);
 }
@@ -1976,6 +2050,54 @@ static cairo_surface_t *generate_pixmap(MetaFrames *frames, MetaUIFrame *frame,
   return result;
 }
 
+/* The title, icons and buttons only show in the titlebar, so the other
+   borders look the same on every frame with the same style, state and
+   size. Maximized windows in particular share them. */
+static cairo_surface_t *get_shared_piece(MetaFrames *frames,
+                                         MetaUIFrame *frame, int piece,
+                                         cairo_rectangle_int_t *rect,
+                                         MetaFrameType type,
+                                         MetaFrameFlags flags, int width,
+                                         int height) {
+  SharedPieceKey key, *stored;
+  SharedPiece *shared;
+  cairo_surface_t *pixmap;
+  MetaTheme *theme;
+
+  /* A reloaded theme has the same name, but not the same address */
+  theme = meta_theme_get_current();
+  if (theme != frames->shared_pieces_theme) {
+    g_hash_table_remove_all(frames->shared_pieces);
+    frames->shared_pieces_theme = theme;
+  }
+
+  key.style = frame->style;
+  key.type = type;
+  key.flags = flags;
+  key.text_height = frame->text_height;
+  key.width = width;
+  key.height = height;
+  key.scale = gdk_window_get_scale_factor(frame->window);
+  key.piece = piece;
+
+  shared = g_hash_table_lookup(frames->shared_pieces, &key);
+
+  if (shared == NULL) {
+    pixmap = generate_pixmap(frames, frame, rect);
+    if (pixmap == NULL) return NULL;
+
+    stored = g_new(SharedPieceKey, 1);
+    *stored = key;
+    shared = g_new(SharedPiece, 1);
+    shared->pixmap = pixmap;
+    g_hash_table_insert(frames->shared_pieces, stored, shared);
+  }
+
+  shared->used = TRUE;
+
+  return cairo_surface_reference(shared->pixmap);
+}
+
 static void populate_cache(MetaFrames *frames, MetaUIFrame *frame) {
   MetaFrameBorders borders;
   int width, height;
@@ -2042,8 +2164,14 @@ static void populate_cache(MetaFrames *frames, MetaUIFrame *frame) {
 
   for (i = 0; i < 4; i++) {
     CachedFramePiece *piece = &pixels->piece[i];
-    if (!piece->pixmap)
+
+    if (piece->pixmap) continue;
+
+    if (i == 0)
       piece->pixmap = generate_pixmap(frames, frame, &piece->rect);
+    else
+      piece->pixmap = get_shared_piece(frames, frame, i, &piece->rect,
+                                       frame_type, frame_flags, width, height);
   }
 
   if (frames->invalidate_cache_timeout_id)
@@ -2135,6 +2263,25 @@ static void cached_pixels_draw(CachedPixels *pixels, cairo_t *cr,
 static MetaUIFrame *find_frame_to_draw(MetaFrames *frames, cairo_t *cr) {
   GHashTableIter iter;
   MetaUIFrame *frame;
+  GdkEvent *event;
+
+  /* GTK+ draws the frames while handling the expose event of the frame
+     window, so the frame is usually one lookup away. cr only says
+     whether a given window is being drawn, which would mean asking
+     every frame. */
+  event = gtk_get_current_event();
+  if (event != NULL) {
+    frame = NULL;
+
+    if (event->type == GDK_EXPOSE && event->any.window != NULL)
+      frame = meta_frames_lookup_window(frames,
+                                        GDK_WINDOW_XID(event->any.window));
+
+    gdk_event_free(event);
+
+    if (frame != NULL && gtk_cairo_should_draw_window(cr, frame->window))
+      return frame;
+  }
 
   g_hash_table_iter_init(&iter, frames->frames);
   while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&frame))
@@ -109,6 +109,8 @@ struct _MetaFrames {
   int invalidate_cache_timeout_id;
   GList *invalidate_frames;
   GHashTable *cache;
+  GHashTable *shared_pieces; /* borders shared by look-alike frames */
+  MetaTheme *shared_pieces_theme; /* the theme they were drawn with */
 };
 
 struct _MetaFramesClass {
@@ -36,6 +36,12 @@
 
 #include <string.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (__GNUC__ >= 5 || defined(__clang__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
 /* Used as the destroy notification function for gdk_pixbuf_new() */
 static void free_buffer(guchar *pixels, gpointer data) { g_free(pixels); }
 
@@ -56,6 +62,329 @@ static GdkPixbuf *blank_pixbuf(int width, int height) {
                                   height, rowstride, free_buffer, NULL);
 }
 
+/*
+ * The inner loops. Each comes as plain C, which defines the result,
+ * and in SSE2 and AVX2 versions that must match it byte for byte;
+ * testgradient --check compares them.
+ *
+ * fill_row: pixel i of the n pixel row gets each channel c set to
+ *   (start[c] + i * step[c]) >> 16, which is how the gradients step
+ *   through their 16.16 fixed point colors.
+ * multiply_alpha: scales the alpha of n pixels by alpha / 255.
+ * multiply_alphas: scales the alpha of pixel i by alphas[i] / 255.
+ */
+typedef struct {
+  void (*fill_row)(guchar *ptr, int n, const long start[4],
+                   const long step[4]);
+  void (*multiply_alpha)(guchar *ptr, int n, guchar alpha);
+  void (*multiply_alphas)(guchar *ptr, int n, const guchar *alphas);
+} GradientKernels;
+
+static void fill_row_c(guchar *ptr, int n, const long start[4],
+                       const long step[4]) {
+  long r, g, b, a;
+  int i;
+
+  r = start[0];
+  g = start[1];
+  b = start[2];
+  a = start[3];
+
+  for (i = 0; i < n; i++) {
+    *(ptr++) = (unsigned char)(r >> 16);
+    *(ptr++) = (unsigned char)(g >> 16);
+    *(ptr++) = (unsigned char)(b >> 16);
+    *(ptr++) = (unsigned char)(a >> 16);
+    r += step[0];
+    g += step[1];
+    b += step[2];
+    a += step[3];
+  }
+}
+
+/* multiply the two alpha channels. not sure this is right.
+ * but some end cases are that if the pixbuf contains 255,
+ * then it should be modified to contain "alpha"; if the
+ * pixbuf contains 0, it should remain 0.
+ */
+/* ((*p / 255.0) * (alpha / 255.0)) * 255; */
+static void multiply_alpha_c(guchar *ptr, int n, guchar alpha) {
+  for (ptr += 3; n > 0; n--, ptr += 4)
+    *ptr = (guchar)(((int)*ptr * (int)alpha) / (int)255);
+}
+
+static void multiply_alphas_c(guchar *ptr, int n, const guchar *alphas) {
+  for (ptr += 3; n > 0; n--, ptr += 4, alphas++)
+    *ptr = (guchar)(((int)*ptr * (int)*alphas) / (int)255);
+}
+
+static const GradientKernels scalar_kernels = {fill_row_c, multiply_alpha_c,
+                                               multiply_alphas_c};
+
+#ifdef HAVE_X86_KERNELS
+/* The vector loops keep each channel in a 32-bit lane, which gives
+ * the same bits as the long accumulators as long as every value that
+ * gets stored fits; the values are linear in i, so checking the ends
+ * of the row will do. Gradients of real colors never come close.
+ */
+static gboolean row_fits_in_lanes(int n, const long start[4],
+                                  const long step[4]) {
+  int c;
+
+  for (c = 0; c < 4; c++) {
+    gint64 last = (gint64)start[c] + (gint64)(n - 1) * step[c];
+
+    if (start[c] < G_MININT32 || start[c] > G_MAXINT32 ||
+        last < G_MININT32 || last > G_MAXINT32 ||
+        step[c] < G_MININT32 / 8 || step[c] > G_MAXINT32 / 8)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Finishes a row from pixel i with the plain C loop */
+static void fill_row_tail(guchar *ptr, int i, int n, const long start[4],
+                          const long step[4]) {
+  long tail[4];
+  int c;
+
+  if (i == n) return;
+
+  for (c = 0; c < 4; c++) tail[c] = start[c] + i * step[c];
+
+  fill_row_c(ptr + 4 * i, n - i, tail, step);
+}
+
+/* For a/255 with a < 65536: ((a * 0x8081) >> 16) >> 7 is exact, and
+ * with the high half of each 32-bit lane zero the 16-bit multiplies
+ * work on whole lanes.
+ */
+#define DIV_255_MAGIC 0x8081
+
+__attribute__((target("sse2"))) static void fill_row_sse2(
+    guchar *ptr, int n, const long start[4], const long step[4]) {
+  __m128i mask, d, d4, v0, v1, v2, v3;
+  int i;
+
+  if (!row_fits_in_lanes(n, start, step)) {
+    fill_row_c(ptr, n, start, step);
+    return;
+  }
+
+  mask = _mm_set1_epi32(0xff);
+  d = _mm_setr_epi32(step[0], step[1], step[2], step[3]);
+  d4 = _mm_slli_epi32(d, 2);
+
+  /* v0 to v3 hold pixels i to i + 3 */
+  v0 = _mm_setr_epi32(start[0], start[1], start[2], start[3]);
+  v1 = _mm_add_epi32(v0, d);
+  v2 = _mm_add_epi32(v1, d);
+  v3 = _mm_add_epi32(v2, d);
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128i p01, p23;
+
+    p01 = _mm_packs_epi32(_mm_and_si128(_mm_srai_epi32(v0, 16), mask),
+                          _mm_and_si128(_mm_srai_epi32(v1, 16), mask));
+    p23 = _mm_packs_epi32(_mm_and_si128(_mm_srai_epi32(v2, 16), mask),
+                          _mm_and_si128(_mm_srai_epi32(v3, 16), mask));
+    _mm_storeu_si128((__m128i *)(ptr + 4 * i), _mm_packus_epi16(p01, p23));
+
+    v0 = _mm_add_epi32(v0, d4);
+    v1 = _mm_add_epi32(v1, d4);
+    v2 = _mm_add_epi32(v2, d4);
+    v3 = _mm_add_epi32(v3, d4);
+  }
+
+  fill_row_tail(ptr, i, n, start, step);
+}
+
+__attribute__((target("sse2"))) static void multiply_alpha_sse2(
+    guchar *ptr, int n, guchar alpha) {
+  __m128i rgb, factor, magic;
+  int i;
+
+  rgb = _mm_set1_epi32(0x00ffffff);
+  factor = _mm_set1_epi32(alpha);
+  magic = _mm_set1_epi32(DIV_255_MAGIC);
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128i px, a;
+
+    px = _mm_loadu_si128((const __m128i *)(ptr + 4 * i));
+    a = _mm_mullo_epi16(_mm_srli_epi32(px, 24), factor);
+    a = _mm_srli_epi32(_mm_mulhi_epu16(a, magic), 7);
+    px = _mm_or_si128(_mm_and_si128(px, rgb), _mm_slli_epi32(a, 24));
+    _mm_storeu_si128((__m128i *)(ptr + 4 * i), px);
+  }
+
+  multiply_alpha_c(ptr + 4 * i, n - i, alpha);
+}
+
+__attribute__((target("sse2"))) static void multiply_alphas_sse2(
+    guchar *ptr, int n, const guchar *alphas) {
+  __m128i rgb, magic, zero;
+  int i;
+
+  rgb = _mm_set1_epi32(0x00ffffff);
+  magic = _mm_set1_epi32(DIV_255_MAGIC);
+  zero = _mm_setzero_si128();
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128i px, a, factor;
+    gint32 packed;
+
+    memcpy(&packed, alphas + i, sizeof(packed));
+    factor = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero);
+    factor = _mm_unpacklo_epi16(factor, zero);
+
+    px = _mm_loadu_si128((const __m128i *)(ptr + 4 * i));
+    a = _mm_mullo_epi16(_mm_srli_epi32(px, 24), factor);
+    a = _mm_srli_epi32(_mm_mulhi_epu16(a, magic), 7);
+    px = _mm_or_si128(_mm_and_si128(px, rgb), _mm_slli_epi32(a, 24));
+    _mm_storeu_si128((__m128i *)(ptr + 4 * i), px);
+  }
+
+  multiply_alphas_c(ptr + 4 * i, n - i, alphas + i);
+}
+
+__attribute__((target("avx2"))) static void fill_row_avx2(
+    guchar *ptr, int n, const long start[4], const long step[4]) {
+  __m256i mask, d, d8, v0, v1, v2, v3;
+  int i;
+
+  if (!row_fits_in_lanes(n, start, step)) {
+    fill_row_c(ptr, n, start, step);
+    return;
+  }
+
+  mask = _mm256_set1_epi32(0xff);
+  d = _mm256_setr_epi32(step[0], step[1], step[2], step[3], step[0], step[1],
+                        step[2], step[3]);
+  d8 = _mm256_slli_epi32(d, 3);
+
+  /* The packs work within 128-bit halves, so v0 holds pixels i and
+   * i + 4, v1 pixels i + 1 and i + 5 and so on; that way the packed
+   * bytes come out in order.
+   */
+  v0 = _mm256_setr_epi32(start[0], start[1], start[2], start[3], start[0],
+                         start[1], start[2], start[3]);
+  v0 = _mm256_add_epi32(
+      v0, _mm256_blend_epi32(_mm256_setzero_si256(), _mm256_slli_epi32(d, 2),
+                             0xf0));
+  v1 = _mm256_add_epi32(v0, d);
+  v2 = _mm256_add_epi32(v1, d);
+  v3 = _mm256_add_epi32(v2, d);
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256i p01, p23;
+
+    p01 = _mm256_packs_epi32(
+        _mm256_and_si256(_mm256_srai_epi32(v0, 16), mask),
+        _mm256_and_si256(_mm256_srai_epi32(v1, 16), mask));
+    p23 = _mm256_packs_epi32(
+        _mm256_and_si256(_mm256_srai_epi32(v2, 16), mask),
+        _mm256_and_si256(_mm256_srai_epi32(v3, 16), mask));
+    _mm256_storeu_si256((__m256i *)(ptr + 4 * i),
+                        _mm256_packus_epi16(p01, p23));
+
+    v0 = _mm256_add_epi32(v0, d8);
+    v1 = _mm256_add_epi32(v1, d8);
+    v2 = _mm256_add_epi32(v2, d8);
+    v3 = _mm256_add_epi32(v3, d8);
+  }
+
+  fill_row_tail(ptr, i, n, start, step);
+}
+
+__attribute__((target("avx2"))) static void multiply_alpha_avx2(
+    guchar *ptr, int n, guchar alpha) {
+  __m256i rgb, factor, magic;
+  int i;
+
+  rgb = _mm256_set1_epi32(0x00ffffff);
+  factor = _mm256_set1_epi32(alpha);
+  magic = _mm256_set1_epi32(DIV_255_MAGIC);
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256i px, a;
+
+    px = _mm256_loadu_si256((const __m256i *)(ptr + 4 * i));
+    a = _mm256_mullo_epi16(_mm256_srli_epi32(px, 24), factor);
+    a = _mm256_srli_epi32(_mm256_mulhi_epu16(a, magic), 7);
+    px = _mm256_or_si256(_mm256_and_si256(px, rgb), _mm256_slli_epi32(a, 24));
+    _mm256_storeu_si256((__m256i *)(ptr + 4 * i), px);
+  }
+
+  multiply_alpha_c(ptr + 4 * i, n - i, alpha);
+}
+
+__attribute__((target("avx2"))) static void multiply_alphas_avx2(
+    guchar *ptr, int n, const guchar *alphas) {
+  __m256i rgb, magic;
+  int i;
+
+  rgb = _mm256_set1_epi32(0x00ffffff);
+  magic = _mm256_set1_epi32(DIV_255_MAGIC);
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256i px, a, factor;
+
+    factor = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64((const __m128i *)(alphas + i)));
+
+    px = _mm256_loadu_si256((const __m256i *)(ptr + 4 * i));
+    a = _mm256_mullo_epi16(_mm256_srli_epi32(px, 24), factor);
+    a = _mm256_srli_epi32(_mm256_mulhi_epu16(a, magic), 7);
+    px = _mm256_or_si256(_mm256_and_si256(px, rgb), _mm256_slli_epi32(a, 24));
+    _mm256_storeu_si256((__m256i *)(ptr + 4 * i), px);
+  }
+
+  multiply_alphas_c(ptr + 4 * i, n - i, alphas + i);
+}
+
+static const GradientKernels sse2_kernels = {
+    fill_row_sse2, multiply_alpha_sse2, multiply_alphas_sse2};
+
+static const GradientKernels avx2_kernels = {
+    fill_row_avx2, multiply_alpha_avx2, multiply_alphas_avx2};
+#endif /* HAVE_X86_KERNELS */
+
+static const GradientKernels *kernels = NULL;
+
+gboolean meta_gradient_set_kernels(MetaGradientKernels which) {
+  switch (which) {
+    case META_GRADIENT_KERNELS_SCALAR:
+      kernels = &scalar_kernels;
+      return TRUE;
+
+#ifdef HAVE_X86_KERNELS
+    case META_GRADIENT_KERNELS_SSE2:
+      if (!__builtin_cpu_supports("sse2")) return FALSE;
+      kernels = &sse2_kernels;
+      return TRUE;
+
+    case META_GRADIENT_KERNELS_AVX2:
+      if (!__builtin_cpu_supports("avx2")) return FALSE;
+      kernels = &avx2_kernels;
+      return TRUE;
+#endif
+
+    default:
+      return FALSE;
+  }
+}
+
+static const GradientKernels *get_kernels(void) {
+  if (kernels == NULL &&
+      !meta_gradient_set_kernels(META_GRADIENT_KERNELS_AVX2) &&
+      !meta_gradient_set_kernels(META_GRADIENT_KERNELS_SSE2))
+    meta_gradient_set_kernels(META_GRADIENT_KERNELS_SCALAR);
+
+  return kernels;
+}
+
 /*
  *----------------------------------------------------------------------
  * meta_gradient_create_horizontal--
@@ -73,9 +402,8 @@ static GdkPixbuf *meta_gradient_create_horizontal(int width, int height,
                                                   const GdkRGBA *from,
                                                   const GdkRGBA *to) {
   int i;
-  long r, g, b, a, dr, dg, db, da;
+  long start[4], step[4];
   GdkPixbuf *pixbuf;
-  unsigned char *ptr;
   unsigned char *pixels;
   int r0, g0, b0, a0;
   int rf, gf, bf, af;
@@ -85,7 +413,6 @@ static GdkPixbuf *meta_gradient_create_horizontal(int width, int height,
   if (pixbuf == NULL) return NULL;
 
   pixels = gdk_pixbuf_get_pixels(pixbuf);
-  ptr = pixels;
   rowstride = gdk_pixbuf_get_rowstride(pixbuf);
 
   r0 = (guchar)(from->red * 0xff);
@@ -97,26 +424,17 @@ static GdkPixbuf *meta_gradient_create_horizontal(int width, int height,
   bf = (guchar)(to->blue * 0xff);
   af = (guchar)(to->alpha * 0xff);
 
-  r = r0 << 16;
-  g = g0 << 16;
-  b = b0 << 16;
-  a = a0 << 16;
+  start[0] = r0 << 16;
+  start[1] = g0 << 16;
+  start[2] = b0 << 16;
+  start[3] = a0 << 16;
 
-  dr = ((rf - r0) << 16) / (int)width;
-  dg = ((gf - g0) << 16) / (int)width;
-  db = ((bf - b0) << 16) / (int)width;
-  da = ((af - a0) << 16) / (int)width;
+  step[0] = ((rf - r0) << 16) / (int)width;
+  step[1] = ((gf - g0) << 16) / (int)width;
+  step[2] = ((bf - b0) << 16) / (int)width;
+  step[3] = ((af - a0) << 16) / (int)width;
   /* render the first line */
-  for (i = 0; i < width; i++) {
-    *(ptr++) = (unsigned char)(r >> 16);
-    *(ptr++) = (unsigned char)(g >> 16);
-    *(ptr++) = (unsigned char)(b >> 16);
-    *(ptr++) = (unsigned char)(a >> 16);
-    r += dr;
-    g += dg;
-    b += db;
-    a += da;
-  }
+  get_kernels()->fill_row(pixels, width, start, step);
 
   /* copy the first line to the other lines */
   for (i = 1; i < height; i++) {
@@ -253,8 +571,10 @@ static GdkPixbuf *meta_gradient_create_diagonal(int width, int height,
 static GdkPixbuf *meta_gradient_create_multi_horizontal(int width, int height,
                                                         const GdkRGBA *colors,
                                                         int count) {
-  int i, j, k;
-  long r, g, b, a, dr, dg, db, da;
+  static const long no_step[4] = {0, 0, 0, 0};
+  const GradientKernels *k;
+  int i;
+  long color[4], step[4];
   GdkPixbuf *pixbuf;
   unsigned char *ptr;
   unsigned char *pixels;
@@ -269,6 +589,7 @@ static GdkPixbuf *meta_gradient_create_multi_horizontal(int width, int height,
   pixels = gdk_pixbuf_get_pixels(pixbuf);
   rowstride = gdk_pixbuf_get_rowstride(pixbuf);
   ptr = pixels;
+  k = get_kernels();
 
   if (count > width) count = width;
 
@@ -277,43 +598,30 @@ static GdkPixbuf *meta_gradient_create_multi_horizontal(int width, int height,
   else
     width2 = width;
 
-  k = 0;
-
-  r = (long)(colors[0].red * 0xffffff);
-  g = (long)(colors[0].green * 0xffffff);
-  b = (long)(colors[0].blue * 0xffffff);
-  a = (long)(colors[0].alpha * 0xffffff);
+  color[0] = (long)(colors[0].red * 0xffffff);
+  color[1] = (long)(colors[0].green * 0xffffff);
+  color[2] = (long)(colors[0].blue * 0xffffff);
+  color[3] = (long)(colors[0].alpha * 0xffffff);
 
   /* render the first line */
   for (i = 1; i < count; i++) {
-    dr = (int)((colors[i].red - colors[i - 1].red) * 0xffffff) / (int)width2;
-    dg =
+    step[0] =
+        (int)((colors[i].red - colors[i - 1].red) * 0xffffff) / (int)width2;
+    step[1] =
         (int)((colors[i].green - colors[i - 1].green) * 0xffffff) / (int)width2;
-    db = (int)((colors[i].blue - colors[i - 1].blue) * 0xffffff) / (int)width2;
-    da =
+    step[2] =
+        (int)((colors[i].blue - colors[i - 1].blue) * 0xffffff) / (int)width2;
+    step[3] =
         (int)((colors[i].alpha - colors[i - 1].alpha) * 0xffffff) / (int)width2;
-    for (j = 0; j < width2; j++) {
-      *ptr++ = (unsigned char)(r >> 16);
-      *ptr++ = (unsigned char)(g >> 16);
-      *ptr++ = (unsigned char)(b >> 16);
-      *ptr++ = (unsigned char)(a >> 16);
-      r += dr;
-      g += dg;
-      b += db;
-      a += da;
-      k++;
-    }
-    r = (long)(colors[i].red * 0xffffff);
-    g = (long)(colors[i].green * 0xffffff);
-    b = (long)(colors[i].blue * 0xffffff);
-    a = (long)(colors[i].alpha * 0xffffff);
-  }
-  for (j = k; j < width; j++) {
-    *ptr++ = (unsigned char)(r >> 16);
-    *ptr++ = (unsigned char)(g >> 16);
-    *ptr++ = (unsigned char)(b >> 16);
-    *ptr++ = (unsigned char)(a >> 16);
+    k->fill_row(ptr, width2, color, step);
+    ptr += 4 * width2;
+
+    color[0] = (long)(colors[i].red * 0xffffff);
+    color[1] = (long)(colors[i].green * 0xffffff);
+    color[2] = (long)(colors[i].blue * 0xffffff);
+    color[3] = (long)(colors[i].alpha * 0xffffff);
   }
+  k->fill_row(ptr, width - (count - 1) * width2, color, no_step);
 
   /* copy the first line to the other lines */
   for (i = 1; i < height; i++) {
@@ -466,6 +774,7 @@ static GdkPixbuf *meta_gradient_create_multi_diagonal(int width, int height,
 }
 
 static void simple_multiply_alpha(GdkPixbuf *pixbuf, guchar alpha) {
+  const GradientKernels *k;
   guchar *pixels;
   int rowstride;
   int height;
@@ -480,39 +789,18 @@ static void simple_multiply_alpha(GdkPixbuf *pixbuf, guchar alpha) {
   pixels = gdk_pixbuf_get_pixels(pixbuf);
   rowstride = gdk_pixbuf_get_rowstride(pixbuf);
   height = gdk_pixbuf_get_height(pixbuf);
+  k = get_kernels();
 
-  row = 0;
-  while (row < height) {
-    guchar *p;
-    guchar *end;
-
-    p = pixels + row * rowstride;
-    end = p + rowstride;
-
-    while (p != end) {
-      p += 3; /* skip RGB */
-
-      /* multiply the two alpha channels. not sure this is right.
-       * but some end cases are that if the pixbuf contains 255,
-       * then it should be modified to contain "alpha"; if the
-       * pixbuf contains 0, it should remain 0.
-       */
-      /* ((*p / 255.0) * (alpha / 255.0)) * 255; */
-      *p = (guchar)(((int)*p * (int)alpha) / (int)255);
-
-      ++p; /* skip A */
-    }
-
-    ++row;
-  }
+  for (row = 0; row < height; row++)
+    k->multiply_alpha(pixels + row * rowstride, rowstride / 4, alpha);
 }
 
 static void meta_gradient_add_alpha_horizontal(GdkPixbuf *pixbuf,
                                                const unsigned char *alphas,
                                                int n_alphas) {
+  const GradientKernels *k;
   int i, j;
   long a, da;
-  unsigned char *p;
   unsigned char *pixels;
   int width2;
   int rowstride;
@@ -566,30 +854,10 @@ static void meta_gradient_add_alpha_horizontal(GdkPixbuf *pixbuf,
   /* Now for each line of the pixbuf, fill in with the gradient */
   pixels = gdk_pixbuf_get_pixels(pixbuf);
   rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+  k = get_kernels();
 
-  p = pixels;
-  i = 0;
-  while (i < height) {
-    unsigned char *row_end = p + rowstride;
-    gradient_p = gradient;
-
-    p += 3;
-    while (gradient_p != gradient_end) {
-      /* multiply the two alpha channels. not sure this is right.
-       * but some end cases are that if the pixbuf contains 255,
-       * then it should be modified to contain "alpha"; if the
-       * pixbuf contains 0, it should remain 0.
-       */
-      /* ((*p / 255.0) * (alpha / 255.0)) * 255; */
-      *p = (guchar)(((int)*p * (int)*gradient_p) / (int)255);
-
-      p += 4;
-      ++gradient_p;
-    }
-
-    p = row_end;
-    ++i;
-  }
+  for (i = 0; i < height; i++)
+    k->multiply_alphas(pixels + i * rowstride, width, gradient);
 
   g_free(gradient);
 }
@@ -42,6 +42,27 @@ typedef enum {
   META_GRADIENT_LAST
 } MetaGradientType;
 
+/**
+ * MetaGradientKernels:
+ * @META_GRADIENT_KERNELS_SCALAR: Plain C loops
+ * @META_GRADIENT_KERNELS_SSE2: SSE2 loops
+ * @META_GRADIENT_KERNELS_AVX2: AVX2 loops
+ *
+ * The inner loops used to fill and fade gradient pixbufs. They all
+ * produce identical pixels.
+ */
+typedef enum {
+  META_GRADIENT_KERNELS_SCALAR,
+  META_GRADIENT_KERNELS_SSE2,
+  META_GRADIENT_KERNELS_AVX2
+} MetaGradientKernels;
+
+/* By default the fastest kernels the CPU supports are used; this
+ * switches to others, for testing. Returns FALSE, changing nothing, if
+ * this build or CPU can't run them.
+ */
+gboolean meta_gradient_set_kernels(MetaGradientKernels kernels);
+
 GdkPixbuf *meta_gradient_create_simple(int width, int height,
                                        const GdkRGBA *from, const GdkRGBA *to,
                                        MetaGradientType style);
@@ -21,6 +21,8 @@
  * 02110-1301, USA.  */
 
 #include <gtk/gtk.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "gradient.h"
 
@@ -241,7 +243,174 @@ static void meta_gradient_test(void) {
                          render_diagonal_alpha_func);
 }
 
+/* --check: compare the vector kernels with the plain C ones and time
+ * them, without opening any windows.
+ */
+
+#define CHECK_ITERATIONS 200
+
+typedef enum {
+  CHECK_SIMPLE,
+  CHECK_MULTI,
+  CHECK_INTERWOVEN,
+  CHECK_ALPHA,
+  CHECK_MULTI_ALPHA
+} CheckKind;
+
+static const struct {
+  const char *name;
+  MetaGradientKernels kernels;
+} check_kernels[] = {{"scalar", META_GRADIENT_KERNELS_SCALAR},
+                     {"sse2", META_GRADIENT_KERNELS_SSE2},
+                     {"avx2", META_GRADIENT_KERNELS_AVX2}};
+
+static GdkPixbuf *render_check(CheckKind kind, MetaGradientType type,
+                               int width, int height) {
+  const guchar alphas[] = {0xff, 0xaa, 0x2f, 0x0, 0xcc, 0xff, 0xff};
+  GdkRGBA colors[5];
+  GdkPixbuf *pixbuf;
+
+  gdk_rgba_parse(&colors[0], "red");
+  gdk_rgba_parse(&colors[1], "rgba(10,200,30,0.6)");
+  gdk_rgba_parse(&colors[2], "orange");
+  gdk_rgba_parse(&colors[3], "pink");
+  gdk_rgba_parse(&colors[4], "green");
+
+  switch (kind) {
+    case CHECK_SIMPLE:
+      return meta_gradient_create_simple(width, height, &colors[0],
+                                         &colors[1], type);
+    case CHECK_MULTI:
+      return meta_gradient_create_multi(width, height, colors, 5, type);
+    case CHECK_INTERWOVEN:
+      return meta_gradient_create_interwoven(width, height, colors, 3,
+                                             colors + 2, 2);
+    case CHECK_ALPHA:
+    case CHECK_MULTI_ALPHA:
+      pixbuf = meta_gradient_create_simple(width, height, &colors[2],
+                                           &colors[1], type);
+      if (kind == CHECK_ALPHA)
+        meta_gradient_add_alpha(pixbuf, &alphas[1], 1,
+                                META_GRADIENT_HORIZONTAL);
+      else
+        meta_gradient_add_alpha(pixbuf, alphas, G_N_ELEMENTS(alphas),
+                                META_GRADIENT_HORIZONTAL);
+      return pixbuf;
+  }
+
+  g_assert_not_reached();
+  return NULL;
+}
+
+static gboolean same_pixels(GdkPixbuf *a, GdkPixbuf *b) {
+  int row, height, row_length;
+
+  height = gdk_pixbuf_get_height(a);
+  row_length = gdk_pixbuf_get_width(a) * gdk_pixbuf_get_n_channels(a);
+
+  for (row = 0; row < height; row++)
+    if (memcmp(gdk_pixbuf_get_pixels(a) + row * gdk_pixbuf_get_rowstride(a),
+               gdk_pixbuf_get_pixels(b) + row * gdk_pixbuf_get_rowstride(b),
+               row_length) != 0)
+      return FALSE;
+
+  return TRUE;
+}
+
+static int check_kernels_match(void) {
+  static const int sizes[][2] = {{1, 1},   {1, 9},    {7, 1},   {3, 5},
+                                 {8, 8},   {17, 13},  {31, 64}, {64, 3},
+                                 {250, 24}, {1023, 37}};
+  int failures = 0;
+  int kind, type, size, k;
+
+  for (kind = CHECK_SIMPLE; kind <= CHECK_MULTI_ALPHA; kind++)
+    for (type = 0; type < META_GRADIENT_LAST; type++)
+      for (size = 0; size < (int)G_N_ELEMENTS(sizes); size++) {
+        int width = sizes[size][0];
+        int height = sizes[size][1];
+        GdkPixbuf *expected;
+
+        /* Interwoven gradients have no type */
+        if (kind == CHECK_INTERWOVEN && type != META_GRADIENT_VERTICAL)
+          continue;
+
+        meta_gradient_set_kernels(META_GRADIENT_KERNELS_SCALAR);
+        expected = render_check(kind, type, width, height);
+
+        for (k = 1; k < (int)G_N_ELEMENTS(check_kernels); k++) {
+          GdkPixbuf *pixbuf;
+
+          if (!meta_gradient_set_kernels(check_kernels[k].kernels)) continue;
+
+          pixbuf = render_check(kind, type, width, height);
+          if (!same_pixels(expected, pixbuf)) {
+            printf("MISMATCH: %s, kind %d, type %d, %dx%d\n",
+                   check_kernels[k].name, kind, type, width, height);
+            failures++;
+          }
+          g_object_unref(pixbuf);
+        }
+
+        g_object_unref(expected);
+      }
+
+  return failures;
+}
+
+static void time_kernels(void) {
+  static const struct {
+    const char *name;
+    CheckKind kind;
+    MetaGradientType type;
+  } cases[] = {{"horizontal", CHECK_SIMPLE, META_GRADIENT_HORIZONTAL},
+               {"diagonal", CHECK_SIMPLE, META_GRADIENT_DIAGONAL},
+               {"multi horizontal", CHECK_MULTI, META_GRADIENT_HORIZONTAL},
+               {"alpha", CHECK_ALPHA, META_GRADIENT_VERTICAL},
+               {"multi alpha", CHECK_MULTI_ALPHA, META_GRADIENT_VERTICAL}};
+  int c, k, i;
+
+  printf("%-18s", "1600x40, us");
+  for (k = 0; k < (int)G_N_ELEMENTS(check_kernels); k++)
+    printf("%10s", check_kernels[k].name);
+  printf("\n");
+
+  for (c = 0; c < (int)G_N_ELEMENTS(cases); c++) {
+    printf("%-18s", cases[c].name);
+
+    for (k = 0; k < (int)G_N_ELEMENTS(check_kernels); k++) {
+      gint64 start;
+
+      if (!meta_gradient_set_kernels(check_kernels[k].kernels)) {
+        printf("%10s", "-");
+        continue;
+      }
+
+      start = g_get_monotonic_time();
+      for (i = 0; i < CHECK_ITERATIONS; i++)
+        g_object_unref(render_check(cases[c].kind, cases[c].type, 1600, 40));
+      printf("%10.1f",
+             (g_get_monotonic_time() - start) / (double)CHECK_ITERATIONS);
+    }
+
+    printf("\n");
+  }
+}
+
 int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "--check") == 0) {
+    int failures = check_kernels_match();
+
+    if (failures > 0) {
+      printf("%d mismatches\n", failures);
+      return 1;
+    }
+
+    printf("all kernels match\n");
+    time_kernels();
+    return 0;
+  }
+
   gtk_init(&argc, &argv);
 
   meta_gradient_test();
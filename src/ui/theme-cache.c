@@ -0,0 +1,1350 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Marco binary theme cache */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/*
+ * A parsed theme is written out as a flat stream of native-endian
+ * records: the layouts, draw op lists, frame styles and style sets, each
+ * kind in an order where objects only refer back to ones already
+ * written, so that reading it is a single pass over the mapped file.
+ * Expressions are stored as tokens after constant substitution, and
+ * images by the filename they were loaded from.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "theme-cache.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "util.h"
+
+#define CACHE_MAGIC "marco-theme-cache"
+
+/* Bump whenever the layout of the records changes */
+#define CACHE_FORMAT_VERSION 1
+
+/* Marks a missing string or object */
+#define NONE G_MAXUINT32
+
+/* Size at which theme images are loaded, as in theme-parser.c */
+#define THEME_ICON_SIZE 64
+
+#define N_STYLE_SLOTS                                     \
+  (2 * META_FRAME_RESIZE_LAST * META_FRAME_FOCUS_LAST + \
+   6 * META_FRAME_FOCUS_LAST)
+
+typedef struct {
+  GByteArray *data;
+  GHashTable *indices;     /* object -> index in its kind + 1 */
+  GHashTable *names;       /* object -> name in the theme */
+  GHashTable *image_names; /* GdkPixbuf -> filename */
+  GPtrArray *layouts;
+  GPtrArray *op_lists;
+  GPtrArray *styles;
+  GPtrArray *style_sets;
+  gboolean failed;
+} CacheWriter;
+
+typedef struct {
+  const guchar *pos;
+  const guchar *end;
+  MetaTheme *theme;
+  GPtrArray *layouts;
+  GPtrArray *op_lists;
+  GPtrArray *styles;
+  GPtrArray *style_sets;
+  gboolean failed;
+} CacheReader;
+
+static char *get_cache_filename(const char *theme_file) {
+  char *checksum;
+  char *basename;
+  char *filename;
+
+  checksum = g_compute_checksum_for_string(G_CHECKSUM_SHA1, theme_file, -1);
+  basename = g_strconcat(checksum, ".cache", NULL);
+  filename = g_build_filename(g_get_user_cache_dir(), "marco", "themes",
+                              basename, NULL);
+
+  g_free(checksum);
+  g_free(basename);
+
+  return filename;
+}
+
+/* Every style slot of a style set, in the order they are stored */
+static void get_style_slots(MetaFrameStyleSet *style_set,
+                            MetaFrameStyle **slots[N_STYLE_SLOTS]) {
+  int i, j, n;
+
+  n = 0;
+
+  for (i = 0; i < META_FRAME_RESIZE_LAST; i++)
+    for (j = 0; j < META_FRAME_FOCUS_LAST; j++) {
+      slots[n++] = &style_set->normal_styles[i][j];
+      slots[n++] = &style_set->shaded_styles[i][j];
+    }
+
+  for (j = 0; j < META_FRAME_FOCUS_LAST; j++) {
+    slots[n++] = &style_set->maximized_styles[j];
+    slots[n++] = &style_set->tiled_left_styles[j];
+    slots[n++] = &style_set->tiled_right_styles[j];
+    slots[n++] = &style_set->maximized_and_shaded_styles[j];
+    slots[n++] = &style_set->tiled_left_and_shaded_styles[j];
+    slots[n++] = &style_set->tiled_right_and_shaded_styles[j];
+  }
+
+  g_assert(n == N_STYLE_SLOTS);
+}
+
+/* Writing */
+
+static void write_uint(CacheWriter *w, guint32 value) {
+  g_byte_array_append(w->data, (const guint8 *)&value, sizeof(value));
+}
+
+static void write_int(CacheWriter *w, gint32 value) {
+  g_byte_array_append(w->data, (const guint8 *)&value, sizeof(value));
+}
+
+static void write_int64(CacheWriter *w, gint64 value) {
+  g_byte_array_append(w->data, (const guint8 *)&value, sizeof(value));
+}
+
+static void write_double(CacheWriter *w, double value) {
+  g_byte_array_append(w->data, (const guint8 *)&value, sizeof(value));
+}
+
+/* Strings keep their nul so that names can be looked up in place when
+   read. Strings the theme keeps are copied, it outlives the mapping. */
+static void write_string(CacheWriter *w, const char *str) {
+  guint32 len;
+
+  if (str == NULL) {
+    write_uint(w, NONE);
+    return;
+  }
+
+  len = strlen(str);
+  write_uint(w, len);
+  g_byte_array_append(w->data, (const guint8 *)str, len + 1);
+}
+
+static void write_index(CacheWriter *w, gconstpointer object) {
+  if (object == NULL)
+    write_uint(w, NONE);
+  else
+    write_uint(w, GPOINTER_TO_UINT(g_hash_table_lookup(w->indices, object)) -
+                      1);
+}
+
+static void add_object(CacheWriter *w, GPtrArray *objects, gpointer object) {
+  g_ptr_array_add(objects, object);
+  g_hash_table_insert(w->indices, object, GUINT_TO_POINTER(objects->len));
+}
+
+static void collect_layout(CacheWriter *w, gpointer layout) {
+  if (layout == NULL || g_hash_table_contains(w->indices, layout)) return;
+
+  add_object(w, w->layouts, layout);
+}
+
+static void collect_op_list(CacheWriter *w, gpointer object) {
+  MetaDrawOpList *op_list = object;
+  int i;
+
+  if (op_list == NULL || g_hash_table_contains(w->indices, op_list)) return;
+
+  /* Included lists go first, so that reading never has to look ahead */
+  for (i = 0; i < op_list->n_ops; i++) {
+    MetaDrawOp *op = op_list->ops[i];
+
+    if (op->type == META_DRAW_OP_LIST)
+      collect_op_list(w, op->data.op_list.op_list);
+    else if (op->type == META_DRAW_TILE)
+      collect_op_list(w, op->data.tile.op_list);
+  }
+
+  add_object(w, w->op_lists, op_list);
+}
+
+static void collect_style(CacheWriter *w, gpointer object) {
+  MetaFrameStyle *style = object;
+  int i, j;
+
+  if (style == NULL || g_hash_table_contains(w->indices, style)) return;
+
+  collect_style(w, style->parent);
+  collect_layout(w, style->layout);
+
+  for (i = 0; i < META_FRAME_PIECE_LAST; i++)
+    collect_op_list(w, style->pieces[i]);
+
+  for (i = 0; i < META_BUTTON_TYPE_LAST; i++)
+    for (j = 0; j < META_BUTTON_STATE_LAST; j++)
+      collect_op_list(w, style->buttons[i][j]);
+
+  add_object(w, w->styles, style);
+}
+
+static void collect_style_set(CacheWriter *w, gpointer object) {
+  MetaFrameStyleSet *style_set = object;
+  MetaFrameStyle **slots[N_STYLE_SLOTS];
+  int i;
+
+  if (style_set == NULL || g_hash_table_contains(w->indices, style_set))
+    return;
+
+  collect_style_set(w, style_set->parent);
+
+  get_style_slots(style_set, slots);
+  for (i = 0; i < N_STYLE_SLOTS; i++) collect_style(w, *slots[i]);
+
+  add_object(w, w->style_sets, style_set);
+}
+
+static void add_names(CacheWriter *w, GHashTable *objects_by_name) {
+  GHashTableIter iter;
+  gpointer name, object;
+
+  g_hash_table_iter_init(&iter, objects_by_name);
+  while (g_hash_table_iter_next(&iter, &name, &object))
+    g_hash_table_insert(w->names, object, name);
+}
+
+static void collect_named(CacheWriter *w, GHashTable *objects_by_name,
+                          void (*collect_func)(CacheWriter *w,
+                                               gpointer object)) {
+  GHashTableIter iter;
+  gpointer object;
+
+  g_hash_table_iter_init(&iter, objects_by_name);
+  while (g_hash_table_iter_next(&iter, NULL, &object))
+    collect_func(w, object);
+}
+
+static void write_border(CacheWriter *w, const GtkBorder *border) {
+  write_int(w, border->left);
+  write_int(w, border->right);
+  write_int(w, border->top);
+  write_int(w, border->bottom);
+}
+
+static void write_layout(CacheWriter *w, gpointer object) {
+  const MetaFrameLayout *layout = object;
+
+  write_string(w, g_hash_table_lookup(w->names, layout));
+
+  write_int(w, layout->left_width);
+  write_int(w, layout->right_width);
+  write_int(w, layout->bottom_height);
+  write_border(w, &layout->invisible_border);
+  write_border(w, &layout->title_border);
+  write_int(w, layout->title_vertical_pad);
+  write_int(w, layout->right_titlebar_edge);
+  write_int(w, layout->left_titlebar_edge);
+  write_uint(w, layout->button_sizing);
+  write_double(w, layout->button_aspect);
+  write_int(w, layout->button_width);
+  write_int(w, layout->button_height);
+  write_border(w, &layout->button_border);
+  write_double(w, layout->title_scale);
+  write_uint(w, layout->has_title);
+  write_uint(w, layout->hide_buttons);
+  write_uint(w, layout->top_left_corner_rounded_radius);
+  write_uint(w, layout->top_right_corner_rounded_radius);
+  write_uint(w, layout->bottom_left_corner_rounded_radius);
+  write_uint(w, layout->bottom_right_corner_rounded_radius);
+}
+
+static void write_color_spec(CacheWriter *w, const MetaColorSpec *spec) {
+  if (spec == NULL) {
+    write_uint(w, NONE);
+    return;
+  }
+
+  write_uint(w, spec->type);
+
+  switch (spec->type) {
+    case META_COLOR_SPEC_BASIC:
+      write_double(w, spec->data.basic.color.red);
+      write_double(w, spec->data.basic.color.green);
+      write_double(w, spec->data.basic.color.blue);
+      write_double(w, spec->data.basic.color.alpha);
+      break;
+
+    case META_COLOR_SPEC_GTK:
+      write_uint(w, spec->data.gtk.component);
+      write_uint(w, spec->data.gtk.state);
+      break;
+
+    case META_COLOR_SPEC_GTK_CUSTOM:
+      write_string(w, spec->data.gtkcustom.color_name);
+      write_color_spec(w, spec->data.gtkcustom.fallback);
+      break;
+
+    case META_COLOR_SPEC_BLEND:
+      write_color_spec(w, spec->data.blend.foreground);
+      write_color_spec(w, spec->data.blend.background);
+      write_double(w, spec->data.blend.alpha);
+      break;
+
+    case META_COLOR_SPEC_SHADE:
+      write_color_spec(w, spec->data.shade.base);
+      write_double(w, spec->data.shade.factor);
+      break;
+  }
+}
+
+static void write_gradient_spec(CacheWriter *w, const MetaGradientSpec *spec) {
+  GSList *tmp;
+
+  if (spec == NULL) {
+    write_uint(w, NONE);
+    return;
+  }
+
+  write_uint(w, spec->type);
+  write_uint(w, g_slist_length(spec->color_specs));
+
+  for (tmp = spec->color_specs; tmp != NULL; tmp = tmp->next)
+    write_color_spec(w, tmp->data);
+}
+
+static void write_alpha_spec(CacheWriter *w,
+                             const MetaAlphaGradientSpec *spec) {
+  if (spec == NULL) {
+    write_uint(w, NONE);
+    return;
+  }
+
+  write_uint(w, spec->type);
+  write_uint(w, spec->n_alphas);
+  g_byte_array_append(w->data, spec->alphas, spec->n_alphas);
+}
+
+static void write_draw_spec(CacheWriter *w, const MetaDrawSpec *spec) {
+  int i;
+
+  if (spec == NULL) {
+    write_uint(w, NONE);
+    return;
+  }
+
+  write_uint(w, spec->n_tokens);
+
+  for (i = 0; i < spec->n_tokens; i++) {
+    const PosToken *t = &spec->tokens[i];
+
+    write_uint(w, t->type);
+
+    switch (t->type) {
+      case POS_TOKEN_INT:
+        write_int(w, t->d.i.val);
+        break;
+      case POS_TOKEN_DOUBLE:
+        write_double(w, t->d.d.val);
+        break;
+      case POS_TOKEN_OPERATOR:
+        write_uint(w, t->d.o.op);
+        break;
+      case POS_TOKEN_VARIABLE:
+        write_string(w, t->d.v.name);
+        break;
+      case POS_TOKEN_OPEN_PAREN:
+      case POS_TOKEN_CLOSE_PAREN:
+        break;
+    }
+  }
+}
+
+static void write_rect_specs(CacheWriter *w, const MetaDrawSpec *x,
+                             const MetaDrawSpec *y, const MetaDrawSpec *width,
+                             const MetaDrawSpec *height) {
+  write_draw_spec(w, x);
+  write_draw_spec(w, y);
+  write_draw_spec(w, width);
+  write_draw_spec(w, height);
+}
+
+static void write_draw_op(CacheWriter *w, const MetaDrawOp *op) {
+  const char *filename;
+
+  write_uint(w, op->type);
+
+  switch (op->type) {
+    case META_DRAW_LINE:
+      write_color_spec(w, op->data.line.color_spec);
+      write_int(w, op->data.line.dash_on_length);
+      write_int(w, op->data.line.dash_off_length);
+      write_int(w, op->data.line.width);
+      write_rect_specs(w, op->data.line.x1, op->data.line.y1,
+                       op->data.line.x2, op->data.line.y2);
+      break;
+
+    case META_DRAW_RECTANGLE:
+      write_color_spec(w, op->data.rectangle.color_spec);
+      write_uint(w, op->data.rectangle.filled);
+      write_rect_specs(w, op->data.rectangle.x, op->data.rectangle.y,
+                       op->data.rectangle.width, op->data.rectangle.height);
+      break;
+
+    case META_DRAW_ARC:
+      write_color_spec(w, op->data.arc.color_spec);
+      write_uint(w, op->data.arc.filled);
+      write_rect_specs(w, op->data.arc.x, op->data.arc.y, op->data.arc.width,
+                       op->data.arc.height);
+      write_double(w, op->data.arc.start_angle);
+      write_double(w, op->data.arc.extent_angle);
+      break;
+
+    case META_DRAW_CLIP:
+      write_rect_specs(w, op->data.clip.x, op->data.clip.y,
+                       op->data.clip.width, op->data.clip.height);
+      break;
+
+    case META_DRAW_TINT:
+      write_color_spec(w, op->data.tint.color_spec);
+      write_alpha_spec(w, op->data.tint.alpha_spec);
+      write_rect_specs(w, op->data.tint.x, op->data.tint.y,
+                       op->data.tint.width, op->data.tint.height);
+      break;
+
+    case META_DRAW_GRADIENT:
+      write_gradient_spec(w, op->data.gradient.gradient_spec);
+      write_alpha_spec(w, op->data.gradient.alpha_spec);
+      write_rect_specs(w, op->data.gradient.x, op->data.gradient.y,
+                       op->data.gradient.width, op->data.gradient.height);
+      break;
+
+    case META_DRAW_IMAGE:
+      /* The pixels are not cached; the image is loaded again, at the
+       * scale current then.
+       */
+      filename = g_hash_table_lookup(w->image_names, op->data.image.pixbuf);
+      if (filename == NULL) w->failed = TRUE;
+
+      write_color_spec(w, op->data.image.colorize_spec);
+      write_alpha_spec(w, op->data.image.alpha_spec);
+      write_string(w, filename);
+      write_rect_specs(w, op->data.image.x, op->data.image.y,
+                       op->data.image.width, op->data.image.height);
+      write_uint(w, op->data.image.fill_type);
+      break;
+
+    case META_DRAW_GTK_ARROW:
+      write_uint(w, op->data.gtk_arrow.state);
+      write_uint(w, op->data.gtk_arrow.shadow);
+      write_uint(w, op->data.gtk_arrow.arrow);
+      write_uint(w, op->data.gtk_arrow.filled);
+      write_rect_specs(w, op->data.gtk_arrow.x, op->data.gtk_arrow.y,
+                       op->data.gtk_arrow.width, op->data.gtk_arrow.height);
+      break;
+
+    case META_DRAW_GTK_BOX:
+      write_uint(w, op->data.gtk_box.state);
+      write_uint(w, op->data.gtk_box.shadow);
+      write_rect_specs(w, op->data.gtk_box.x, op->data.gtk_box.y,
+                       op->data.gtk_box.width, op->data.gtk_box.height);
+      break;
+
+    case META_DRAW_GTK_VLINE:
+      write_uint(w, op->data.gtk_vline.state);
+      write_draw_spec(w, op->data.gtk_vline.x);
+      write_draw_spec(w, op->data.gtk_vline.y1);
+      write_draw_spec(w, op->data.gtk_vline.y2);
+      break;
+
+    case META_DRAW_ICON:
+      write_alpha_spec(w, op->data.icon.alpha_spec);
+      write_rect_specs(w, op->data.icon.x, op->data.icon.y,
+                       op->data.icon.width, op->data.icon.height);
+      write_uint(w, op->data.icon.fill_type);
+      break;
+
+    case META_DRAW_TITLE:
+      write_color_spec(w, op->data.title.color_spec);
+      write_draw_spec(w, op->data.title.x);
+      write_draw_spec(w, op->data.title.y);
+      write_draw_spec(w, op->data.title.ellipsize_width);
+      break;
+
+    case META_DRAW_OP_LIST:
+      write_index(w, op->data.op_list.op_list);
+      write_rect_specs(w, op->data.op_list.x, op->data.op_list.y,
+                       op->data.op_list.width, op->data.op_list.height);
+      break;
+
+    case META_DRAW_TILE:
+      write_index(w, op->data.tile.op_list);
+      write_rect_specs(w, op->data.tile.x, op->data.tile.y,
+                       op->data.tile.width, op->data.tile.height);
+      write_rect_specs(w, op->data.tile.tile_xoffset,
+                       op->data.tile.tile_yoffset, op->data.tile.tile_width,
+                       op->data.tile.tile_height);
+      break;
+  }
+}
+
+static void write_op_list(CacheWriter *w, gpointer object) {
+  const MetaDrawOpList *op_list = object;
+  int i;
+
+  write_string(w, g_hash_table_lookup(w->names, op_list));
+  write_uint(w, op_list->n_ops);
+
+  for (i = 0; i < op_list->n_ops; i++) write_draw_op(w, op_list->ops[i]);
+}
+
+static void write_style(CacheWriter *w, gpointer object) {
+  const MetaFrameStyle *style = object;
+  int i, j;
+
+  write_string(w, g_hash_table_lookup(w->names, style));
+  write_index(w, style->parent);
+  write_index(w, style->layout);
+
+  for (i = 0; i < META_FRAME_PIECE_LAST; i++)
+    write_index(w, style->pieces[i]);
+
+  for (i = 0; i < META_BUTTON_TYPE_LAST; i++)
+    for (j = 0; j < META_BUTTON_STATE_LAST; j++)
+      write_index(w, style->buttons[i][j]);
+
+  write_color_spec(w, style->window_background_color);
+  write_uint(w, style->window_background_alpha);
+}
+
+static void write_style_set(CacheWriter *w, gpointer object) {
+  MetaFrameStyleSet *style_set = object;
+  MetaFrameStyle **slots[N_STYLE_SLOTS];
+  int i;
+
+  write_string(w, g_hash_table_lookup(w->names, style_set));
+  write_index(w, style_set->parent);
+
+  get_style_slots(style_set, slots);
+  for (i = 0; i < N_STYLE_SLOTS; i++) write_index(w, *slots[i]);
+}
+
+static void write_objects(CacheWriter *w, GPtrArray *objects,
+                          void (*write_func)(CacheWriter *w, gpointer object)) {
+  guint i;
+
+  write_uint(w, objects->len);
+
+  for (i = 0; i < objects->len; i++)
+    write_func(w, g_ptr_array_index(objects, i));
+}
+
+static void write_theme(CacheWriter *w, MetaTheme *theme) {
+  GHashTableIter iter;
+  gpointer key, value;
+  int i;
+
+  add_names(w, theme->layouts_by_name);
+  add_names(w, theme->draw_op_lists_by_name);
+  add_names(w, theme->styles_by_name);
+  add_names(w, theme->style_sets_by_name);
+
+  g_hash_table_iter_init(&iter, theme->images_by_filename);
+  while (g_hash_table_iter_next(&iter, &key, &value))
+    g_hash_table_insert(w->image_names, value, key);
+
+  collect_named(w, theme->layouts_by_name, collect_layout);
+  collect_named(w, theme->draw_op_lists_by_name, collect_op_list);
+  collect_named(w, theme->styles_by_name, collect_style);
+  collect_named(w, theme->style_sets_by_name, collect_style_set);
+
+  for (i = 0; i < META_FRAME_TYPE_LAST; i++)
+    collect_style_set(w, theme->style_sets_by_type[i]);
+
+  write_string(w, theme->readable_name);
+  write_string(w, theme->author);
+  write_string(w, theme->copyright);
+  write_string(w, theme->date);
+  write_string(w, theme->description);
+  write_uint(w, theme->format_version);
+
+  write_objects(w, w->layouts, write_layout);
+  write_objects(w, w->op_lists, write_op_list);
+  write_objects(w, w->styles, write_style);
+  write_objects(w, w->style_sets, write_style_set);
+
+  for (i = 0; i < META_FRAME_TYPE_LAST; i++)
+    write_index(w, theme->style_sets_by_type[i]);
+
+  /* The constants come last. The parser only substitutes the ones
+   * defined before an expression, so they must not be known yet when
+   * the expressions are read back.
+   */
+  if (theme->integer_constants) {
+    write_uint(w, g_hash_table_size(theme->integer_constants));
+    g_hash_table_iter_init(&iter, theme->integer_constants);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+      write_string(w, key);
+      write_int(w, GPOINTER_TO_INT(value));
+    }
+  } else
+    write_uint(w, 0);
+
+  if (theme->float_constants) {
+    write_uint(w, g_hash_table_size(theme->float_constants));
+    g_hash_table_iter_init(&iter, theme->float_constants);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+      write_string(w, key);
+      write_double(w, *(double *)value);
+    }
+  } else
+    write_uint(w, 0);
+
+  if (theme->color_constants) {
+    write_uint(w, g_hash_table_size(theme->color_constants));
+    g_hash_table_iter_init(&iter, theme->color_constants);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+      write_string(w, key);
+      write_string(w, value);
+    }
+  } else
+    write_uint(w, 0);
+}
+
+static void write_header(CacheWriter *w, const char *theme_file,
+                         const GStatBuf *st) {
+  write_string(w, CACHE_MAGIC);
+  write_uint(w, CACHE_FORMAT_VERSION);
+  write_uint(w, G_BYTE_ORDER);
+  write_string(w, PACKAGE_VERSION);
+  write_string(w, theme_file);
+  write_int64(w, st->st_mtime);
+  write_int64(w, st->st_size);
+}
+
+void meta_theme_cache_save(MetaTheme *theme, const GStatBuf *st) {
+  CacheWriter w = {0};
+  GError *error = NULL;
+  char *filename;
+  char *dirname;
+
+  filename = get_cache_filename(theme->filename);
+  dirname = g_path_get_dirname(filename);
+
+  w.data = g_byte_array_new();
+  w.indices = g_hash_table_new(NULL, NULL);
+  w.names = g_hash_table_new(NULL, NULL);
+  w.image_names = g_hash_table_new(NULL, NULL);
+  w.layouts = g_ptr_array_new();
+  w.op_lists = g_ptr_array_new();
+  w.styles = g_ptr_array_new();
+  w.style_sets = g_ptr_array_new();
+
+  write_header(&w, theme->filename, st);
+  write_theme(&w, theme);
+
+  if (w.failed)
+    meta_topic(META_DEBUG_THEMES, "Theme %s cannot be cached\n", theme->name);
+  else if (g_mkdir_with_parents(dirname, 0700) < 0)
+    meta_topic(META_DEBUG_THEMES, "Could not create directory %s: %s\n",
+               dirname, g_strerror(errno));
+  else if (!g_file_set_contents(filename, (const char *)w.data->data,
+                                w.data->len, &error)) {
+    meta_topic(META_DEBUG_THEMES, "Could not write theme cache: %s\n",
+               error->message);
+    g_error_free(error);
+  } else
+    meta_topic(META_DEBUG_THEMES, "Cached theme file %s in %s\n",
+               theme->filename, filename);
+
+  g_byte_array_unref(w.data);
+  g_hash_table_destroy(w.indices);
+  g_hash_table_destroy(w.names);
+  g_hash_table_destroy(w.image_names);
+  g_ptr_array_unref(w.layouts);
+  g_ptr_array_unref(w.op_lists);
+  g_ptr_array_unref(w.styles);
+  g_ptr_array_unref(w.style_sets);
+
+  g_free(dirname);
+  g_free(filename);
+}
+
+/* Reading; any short or malformed data marks the reader failed, after
+ * which everything reads as zero or NULL and the theme is dropped.
+ */
+
+static void read_bytes(CacheReader *r, void *dest, gsize n_bytes) {
+  if (r->failed || (gsize)(r->end - r->pos) < n_bytes) {
+    r->failed = TRUE;
+    memset(dest, 0, n_bytes);
+    return;
+  }
+
+  memcpy(dest, r->pos, n_bytes);
+  r->pos += n_bytes;
+}
+
+static guint32 read_uint(CacheReader *r) {
+  guint32 value;
+
+  read_bytes(r, &value, sizeof(value));
+  return value;
+}
+
+static gint32 read_int(CacheReader *r) {
+  gint32 value;
+
+  read_bytes(r, &value, sizeof(value));
+  return value;
+}
+
+static gint64 read_int64(CacheReader *r) {
+  gint64 value;
+
+  read_bytes(r, &value, sizeof(value));
+  return value;
+}
+
+static double read_double(CacheReader *r) {
+  double value;
+
+  read_bytes(r, &value, sizeof(value));
+  return value;
+}
+
+static guint32 read_enum(CacheReader *r, guint32 n_values) {
+  guint32 value;
+
+  value = read_uint(r);
+  if (value >= n_values) {
+    r->failed = TRUE;
+    return 0;
+  }
+
+  return value;
+}
+
+/* A count of things that each take at least a byte */
+static guint32 read_count(CacheReader *r) {
+  guint32 count;
+
+  count = read_uint(r);
+  if (count > (gsize)(r->end - r->pos)) {
+    r->failed = TRUE;
+    return 0;
+  }
+
+  return count;
+}
+
+/* Returns a string inside the mapped file, g_strdup () it to keep it */
+static const char *read_string(CacheReader *r) {
+  const char *str;
+  guint32 len;
+
+  len = read_uint(r);
+  if (len == NONE || r->failed) return NULL;
+
+  if (len >= (gsize)(r->end - r->pos) || r->pos[len] != '\0') {
+    r->failed = TRUE;
+    return NULL;
+  }
+
+  str = (const char *)r->pos;
+  r->pos += len + 1;
+
+  return str;
+}
+
+static gpointer read_index(CacheReader *r, GPtrArray *objects) {
+  guint32 index;
+
+  index = read_uint(r);
+  if (index == NONE || r->failed) return NULL;
+
+  if (index >= objects->len) {
+    r->failed = TRUE;
+    return NULL;
+  }
+
+  return g_ptr_array_index(objects, index);
+}
+
+static MetaFrameLayout *read_layout_ref(CacheReader *r) {
+  MetaFrameLayout *layout;
+
+  layout = read_index(r, r->layouts);
+  if (layout) meta_frame_layout_ref(layout);
+
+  return layout;
+}
+
+static MetaDrawOpList *read_op_list_ref(CacheReader *r) {
+  MetaDrawOpList *op_list;
+
+  op_list = read_index(r, r->op_lists);
+  if (op_list) meta_draw_op_list_ref(op_list);
+
+  return op_list;
+}
+
+static MetaFrameStyle *read_style_ref(CacheReader *r) {
+  MetaFrameStyle *style;
+
+  style = read_index(r, r->styles);
+  if (style) meta_frame_style_ref(style);
+
+  return style;
+}
+
+static void read_border(CacheReader *r, GtkBorder *border) {
+  border->left = read_int(r);
+  border->right = read_int(r);
+  border->top = read_int(r);
+  border->bottom = read_int(r);
+}
+
+static gpointer read_layout(CacheReader *r) {
+  MetaFrameLayout *layout;
+  const char *name;
+
+  name = read_string(r);
+
+  layout = meta_frame_layout_new();
+
+  layout->left_width = read_int(r);
+  layout->right_width = read_int(r);
+  layout->bottom_height = read_int(r);
+  read_border(r, &layout->invisible_border);
+  read_border(r, &layout->title_border);
+  layout->title_vertical_pad = read_int(r);
+  layout->right_titlebar_edge = read_int(r);
+  layout->left_titlebar_edge = read_int(r);
+  layout->button_sizing = read_enum(r, META_BUTTON_SIZING_LAST + 1);
+  layout->button_aspect = read_double(r);
+  layout->button_width = read_int(r);
+  layout->button_height = read_int(r);
+  read_border(r, &layout->button_border);
+  layout->title_scale = read_double(r);
+  layout->has_title = read_uint(r) != 0;
+  layout->hide_buttons = read_uint(r) != 0;
+  layout->top_left_corner_rounded_radius = read_uint(r);
+  layout->top_right_corner_rounded_radius = read_uint(r);
+  layout->bottom_left_corner_rounded_radius = read_uint(r);
+  layout->bottom_right_corner_rounded_radius = read_uint(r);
+
+  if (name && !r->failed) meta_theme_insert_layout(r->theme, name, layout);
+
+  return layout;
+}
+
+static MetaColorSpec *read_color_spec(CacheReader *r) {
+  MetaColorSpec *spec;
+  const char *color_name;
+  guint32 type;
+
+  type = read_uint(r);
+  if (type == NONE || r->failed) return NULL;
+
+  if (type > META_COLOR_SPEC_SHADE) {
+    r->failed = TRUE;
+    return NULL;
+  }
+
+  spec = meta_color_spec_new(type);
+
+  switch (spec->type) {
+    case META_COLOR_SPEC_BASIC:
+      spec->data.basic.color.red = read_double(r);
+      spec->data.basic.color.green = read_double(r);
+      spec->data.basic.color.blue = read_double(r);
+      spec->data.basic.color.alpha = read_double(r);
+      break;
+
+    case META_COLOR_SPEC_GTK:
+      spec->data.gtk.component = read_enum(r, META_GTK_COLOR_LAST);
+      spec->data.gtk.state = read_uint(r);
+      break;
+
+    case META_COLOR_SPEC_GTK_CUSTOM:
+      color_name = read_string(r);
+      if (color_name == NULL) r->failed = TRUE;
+      spec->data.gtkcustom.color_name = g_strdup(color_name);
+      spec->data.gtkcustom.fallback = read_color_spec(r);
+      break;
+
+    case META_COLOR_SPEC_BLEND:
+      spec->data.blend.foreground = read_color_spec(r);
+      spec->data.blend.background = read_color_spec(r);
+      spec->data.blend.alpha = read_double(r);
+      break;
+
+    case META_COLOR_SPEC_SHADE:
+      spec->data.shade.base = read_color_spec(r);
+      spec->data.shade.factor = read_double(r);
+      break;
+  }
+
+  return spec;
+}
+
+static MetaGradientSpec *read_gradient_spec(CacheReader *r) {
+  MetaGradientSpec *spec;
+  guint32 type, n_colors, i;
+
+  type = read_uint(r);
+  if (type == NONE || r->failed) return NULL;
+
+  if (type >= META_GRADIENT_LAST) {
+    r->failed = TRUE;
+    return NULL;
+  }
+
+  spec = meta_gradient_spec_new(type);
+
+  n_colors = read_count(r);
+  for (i = 0; i < n_colors && !r->failed; i++) {
+    MetaColorSpec *color_spec = read_color_spec(r);
+
+    if (color_spec)
+      spec->color_specs = g_slist_prepend(spec->color_specs, color_spec);
+  }
+  spec->color_specs = g_slist_reverse(spec->color_specs);
+
+  return spec;
+}
+
+static MetaAlphaGradientSpec *read_alpha_spec(CacheReader *r) {
+  MetaAlphaGradientSpec *spec;
+  guint32 type, n_alphas;
+
+  type = read_uint(r);
+  if (type == NONE || r->failed) return NULL;
+
+  n_alphas = read_count(r);
+  if (type >= META_GRADIENT_LAST || n_alphas == 0) {
+    r->failed = TRUE;
+    return NULL;
+  }
+
+  spec = meta_alpha_gradient_spec_new(type, n_alphas);
+  read_bytes(r, spec->alphas, n_alphas);
+
+  return spec;
+}
+
+static MetaDrawSpec *read_draw_spec(CacheReader *r) {
+  MetaDrawSpec *spec;
+  PosToken *tokens;
+  guint32 n_tokens, i;
+
+  n_tokens = read_uint(r);
+  if (n_tokens == NONE || r->failed) return NULL;
+
+  if (n_tokens == 0 || n_tokens > (gsize)(r->end - r->pos)) {
+    r->failed = TRUE;
+    return NULL;
+  }
+
+  tokens = g_new(PosToken, n_tokens);
+
+  for (i = 0; i < n_tokens; i++) {
+    PosToken *t = &tokens[i];
+
+    t->type = read_enum(r, POS_TOKEN_CLOSE_PAREN + 1);
+
+    switch (t->type) {
+      case POS_TOKEN_INT:
+        t->d.i.val = read_int(r);
+        break;
+      case POS_TOKEN_DOUBLE:
+        t->d.d.val = read_double(r);
+        break;
+      case POS_TOKEN_OPERATOR:
+        t->d.o.op = read_enum(r, POS_OP_MIN + 1);
+        break;
+      case POS_TOKEN_VARIABLE:
+        t->d.v.name = g_strdup(read_string(r));
+        if (t->d.v.name == NULL) r->failed = TRUE;
+        break;
+      case POS_TOKEN_OPEN_PAREN:
+      case POS_TOKEN_CLOSE_PAREN:
+        break;
+    }
+  }
+
+  if (r->failed) {
+    for (i = 0; i < n_tokens; i++)
+      if (tokens[i].type == POS_TOKEN_VARIABLE) g_free(tokens[i].d.v.name);
+    g_free(tokens);
+
+    return NULL;
+  }
+
+  spec = meta_draw_spec_new_from_tokens(r->theme, tokens, n_tokens, NULL);
+  if (spec == NULL) r->failed = TRUE;
+
+  return spec;
+}
+
+static void read_rect_specs(CacheReader *r, MetaDrawSpec **x, MetaDrawSpec **y,
+                            MetaDrawSpec **width, MetaDrawSpec **height) {
+  *x = read_draw_spec(r);
+  *y = read_draw_spec(r);
+  *width = read_draw_spec(r);
+  *height = read_draw_spec(r);
+}
+
+static MetaDrawOp *read_draw_op(CacheReader *r) {
+  MetaDrawOp *op;
+  MetaDrawType type;
+  const char *filename;
+
+  type = read_enum(r, META_DRAW_TYPE_COUNT);
+  if (r->failed) return NULL;
+
+  op = meta_draw_op_new(type);
+
+  switch (op->type) {
+    case META_DRAW_LINE:
+      op->data.line.color_spec = read_color_spec(r);
+      op->data.line.dash_on_length = read_int(r);
+      op->data.line.dash_off_length = read_int(r);
+      op->data.line.width = read_int(r);
+      read_rect_specs(r, &op->data.line.x1, &op->data.line.y1,
+                      &op->data.line.x2, &op->data.line.y2);
+      break;
+
+    case META_DRAW_RECTANGLE:
+      op->data.rectangle.color_spec = read_color_spec(r);
+      op->data.rectangle.filled = read_uint(r) != 0;
+      read_rect_specs(r, &op->data.rectangle.x, &op->data.rectangle.y,
+                      &op->data.rectangle.width, &op->data.rectangle.height);
+      break;
+
+    case META_DRAW_ARC:
+      op->data.arc.color_spec = read_color_spec(r);
+      op->data.arc.filled = read_uint(r) != 0;
+      read_rect_specs(r, &op->data.arc.x, &op->data.arc.y,
+                      &op->data.arc.width, &op->data.arc.height);
+      op->data.arc.start_angle = read_double(r);
+      op->data.arc.extent_angle = read_double(r);
+      break;
+
+    case META_DRAW_CLIP:
+      read_rect_specs(r, &op->data.clip.x, &op->data.clip.y,
+                      &op->data.clip.width, &op->data.clip.height);
+      break;
+
+    case META_DRAW_TINT:
+      op->data.tint.color_spec = read_color_spec(r);
+      op->data.tint.alpha_spec = read_alpha_spec(r);
+      read_rect_specs(r, &op->data.tint.x, &op->data.tint.y,
+                      &op->data.tint.width, &op->data.tint.height);
+      break;
+
+    case META_DRAW_GRADIENT:
+      op->data.gradient.gradient_spec = read_gradient_spec(r);
+      op->data.gradient.alpha_spec = read_alpha_spec(r);
+      read_rect_specs(r, &op->data.gradient.x, &op->data.gradient.y,
+                      &op->data.gradient.width, &op->data.gradient.height);
+      break;
+
+    case META_DRAW_IMAGE:
+      op->data.image.colorize_spec = read_color_spec(r);
+      op->data.image.alpha_spec = read_alpha_spec(r);
+
+      filename = read_string(r);
+      if (filename)
+        op->data.image.pixbuf =
+            meta_theme_load_image(r->theme, filename, THEME_ICON_SIZE, NULL);
+
+      if (op->data.image.pixbuf)
+        meta_draw_op_find_stripes(op);
+      else
+        r->failed = TRUE;
+
+      read_rect_specs(r, &op->data.image.x, &op->data.image.y,
+                      &op->data.image.width, &op->data.image.height);
+      op->data.image.fill_type = read_enum(r, META_IMAGE_FILL_TILE + 1);
+      break;
+
+    case META_DRAW_GTK_ARROW:
+      op->data.gtk_arrow.state = read_uint(r);
+      op->data.gtk_arrow.shadow = read_uint(r);
+      op->data.gtk_arrow.arrow = read_uint(r);
+      op->data.gtk_arrow.filled = read_uint(r) != 0;
+      read_rect_specs(r, &op->data.gtk_arrow.x, &op->data.gtk_arrow.y,
+                      &op->data.gtk_arrow.width, &op->data.gtk_arrow.height);
+      break;
+
+    case META_DRAW_GTK_BOX:
+      op->data.gtk_box.state = read_uint(r);
+      op->data.gtk_box.shadow = read_uint(r);
+      read_rect_specs(r, &op->data.gtk_box.x, &op->data.gtk_box.y,
+                      &op->data.gtk_box.width, &op->data.gtk_box.height);
+      break;
+
+    case META_DRAW_GTK_VLINE:
+      op->data.gtk_vline.state = read_uint(r);
+      op->data.gtk_vline.x = read_draw_spec(r);
+      op->data.gtk_vline.y1 = read_draw_spec(r);
+      op->data.gtk_vline.y2 = read_draw_spec(r);
+      break;
+
+    case META_DRAW_ICON:
+      op->data.icon.alpha_spec = read_alpha_spec(r);
+      read_rect_specs(r, &op->data.icon.x, &op->data.icon.y,
+                      &op->data.icon.width, &op->data.icon.height);
+      op->data.icon.fill_type = read_enum(r, META_IMAGE_FILL_TILE + 1);
+      break;
+
+    case META_DRAW_TITLE:
+      op->data.title.color_spec = read_color_spec(r);
+      op->data.title.x = read_draw_spec(r);
+      op->data.title.y = read_draw_spec(r);
+      op->data.title.ellipsize_width = read_draw_spec(r);
+      break;
+
+    case META_DRAW_OP_LIST:
+      op->data.op_list.op_list = read_op_list_ref(r);
+      read_rect_specs(r, &op->data.op_list.x, &op->data.op_list.y,
+                      &op->data.op_list.width, &op->data.op_list.height);
+      break;
+
+    case META_DRAW_TILE:
+      op->data.tile.op_list = read_op_list_ref(r);
+      read_rect_specs(r, &op->data.tile.x, &op->data.tile.y,
+                      &op->data.tile.width, &op->data.tile.height);
+      read_rect_specs(r, &op->data.tile.tile_xoffset,
+                      &op->data.tile.tile_yoffset, &op->data.tile.tile_width,
+                      &op->data.tile.tile_height);
+      break;
+  }
+
+  return op;
+}
+
+static gpointer read_op_list(CacheReader *r) {
+  MetaDrawOpList *op_list;
+  const char *name;
+  guint32 n_ops, i;
+
+  name = read_string(r);
+  n_ops = read_count(r);
+
+  op_list = meta_draw_op_list_new(MAX(n_ops, 1));
+
+  for (i = 0; i < n_ops && !r->failed; i++) {
+    MetaDrawOp *op = read_draw_op(r);
+
+    if (op) meta_draw_op_list_append(op_list, op);
+  }
+
+  if (name && !r->failed)
+    meta_theme_insert_draw_op_list(r->theme, name, op_list);
+
+  return op_list;
+}
+
+static gpointer read_style(CacheReader *r) {
+  MetaFrameStyle *style;
+  const char *name;
+  int i, j;
+
+  name = read_string(r);
+
+  style = meta_frame_style_new(read_index(r, r->styles));
+  style->layout = read_layout_ref(r);
+
+  for (i = 0; i < META_FRAME_PIECE_LAST; i++)
+    style->pieces[i] = read_op_list_ref(r);
+
+  for (i = 0; i < META_BUTTON_TYPE_LAST; i++)
+    for (j = 0; j < META_BUTTON_STATE_LAST; j++)
+      style->buttons[i][j] = read_op_list_ref(r);
+
+  style->window_background_color = read_color_spec(r);
+  style->window_background_alpha = read_enum(r, 256);
+
+  if (name && !r->failed) meta_theme_insert_style(r->theme, name, style);
+
+  return style;
+}
+
+static gpointer read_style_set(CacheReader *r) {
+  MetaFrameStyleSet *style_set;
+  MetaFrameStyle **slots[N_STYLE_SLOTS];
+  const char *name;
+  int i;
+
+  name = read_string(r);
+
+  style_set = meta_frame_style_set_new(read_index(r, r->style_sets));
+
+  get_style_slots(style_set, slots);
+  for (i = 0; i < N_STYLE_SLOTS; i++) *slots[i] = read_style_ref(r);
+
+  if (name && !r->failed)
+    meta_theme_insert_style_set(r->theme, name, style_set);
+
+  return style_set;
+}
+
+static void read_objects(CacheReader *r, GPtrArray *objects,
+                         gpointer (*read_func)(CacheReader *r)) {
+  guint32 n_objects, i;
+
+  n_objects = read_count(r);
+
+  for (i = 0; i < n_objects && !r->failed; i++)
+    g_ptr_array_add(objects, read_func(r));
+}
+
+static void read_theme(CacheReader *r) {
+  MetaTheme *theme = r->theme;
+  guint32 n_constants, i;
+
+  theme->readable_name = g_strdup(read_string(r));
+  theme->author = g_strdup(read_string(r));
+  theme->copyright = g_strdup(read_string(r));
+  theme->date = g_strdup(read_string(r));
+  theme->description = g_strdup(read_string(r));
+  theme->format_version = read_uint(r);
+
+  read_objects(r, r->layouts, read_layout);
+  read_objects(r, r->op_lists, read_op_list);
+  read_objects(r, r->styles, read_style);
+  read_objects(r, r->style_sets, read_style_set);
+
+  for (i = 0; i < META_FRAME_TYPE_LAST; i++) {
+    theme->style_sets_by_type[i] = read_index(r, r->style_sets);
+    if (theme->style_sets_by_type[i])
+      meta_frame_style_set_ref(theme->style_sets_by_type[i]);
+  }
+
+  n_constants = read_count(r);
+  for (i = 0; i < n_constants && !r->failed; i++) {
+    const char *name = read_string(r);
+    int value = read_int(r);
+
+    if (r->failed ||
+        !meta_theme_define_int_constant(theme, name, value, NULL))
+      r->failed = TRUE;
+  }
+
+  n_constants = read_count(r);
+  for (i = 0; i < n_constants && !r->failed; i++) {
+    const char *name = read_string(r);
+    double value = read_double(r);
+
+    if (r->failed ||
+        !meta_theme_define_float_constant(theme, name, value, NULL))
+      r->failed = TRUE;
+  }
+
+  n_constants = read_count(r);
+  for (i = 0; i < n_constants && !r->failed; i++) {
+    const char *name = read_string(r);
+    const char *value = read_string(r);
+
+    if (r->failed || name == NULL || value == NULL ||
+        !meta_theme_define_color_constant(theme, name, value, NULL))
+      r->failed = TRUE;
+  }
+
+  if (r->pos != r->end) r->failed = TRUE;
+}
+
+static gboolean read_header(CacheReader *r, const char *theme_file,
+                            const GStatBuf *st) {
+  if (g_strcmp0(read_string(r), CACHE_MAGIC) != 0 ||
+      read_uint(r) != CACHE_FORMAT_VERSION || read_uint(r) != G_BYTE_ORDER ||
+      g_strcmp0(read_string(r), PACKAGE_VERSION) != 0 ||
+      g_strcmp0(read_string(r), theme_file) != 0 ||
+      read_int64(r) != (gint64)st->st_mtime ||
+      read_int64(r) != (gint64)st->st_size)
+    return FALSE;
+
+  return !r->failed;
+}
+
+MetaTheme *meta_theme_cache_load(const char *theme_name, const char *theme_dir,
+                                 const char *theme_file, const GStatBuf *st) {
+  CacheReader r = {0};
+  GMappedFile *mapped;
+  MetaTheme *theme;
+  char *filename;
+
+  filename = get_cache_filename(theme_file);
+
+  mapped = g_mapped_file_new(filename, FALSE, NULL);
+  if (mapped == NULL) {
+    g_free(filename);
+    return NULL;
+  }
+
+  r.pos = (const guchar *)g_mapped_file_get_contents(mapped);
+  r.end = r.pos + g_mapped_file_get_length(mapped);
+
+  theme = NULL;
+
+  if (read_header(&r, theme_file, st)) {
+    theme = meta_theme_new();
+    theme->name = g_strdup(theme_name);
+    theme->filename = g_strdup(theme_file);
+    theme->dirname = g_strdup(theme_dir);
+
+    r.theme = theme;
+    r.layouts =
+        g_ptr_array_new_with_free_func((GDestroyNotify)meta_frame_layout_unref);
+    r.op_lists =
+        g_ptr_array_new_with_free_func((GDestroyNotify)meta_draw_op_list_unref);
+    r.styles =
+        g_ptr_array_new_with_free_func((GDestroyNotify)meta_frame_style_unref);
+    r.style_sets = g_ptr_array_new_with_free_func(
+        (GDestroyNotify)meta_frame_style_set_unref);
+
+    read_theme(&r);
+
+    /* The theme holds its own references to everything it uses */
+    g_ptr_array_unref(r.layouts);
+    g_ptr_array_unref(r.op_lists);
+    g_ptr_array_unref(r.styles);
+    g_ptr_array_unref(r.style_sets);
+
+    if (r.failed) {
+      meta_topic(META_DEBUG_THEMES, "Theme cache %s is damaged\n", filename);
+      meta_theme_free(theme);
+      theme = NULL;
+    } else
+      meta_topic(META_DEBUG_THEMES, "Loaded theme file %s from cache %s\n",
+                 theme_file, filename);
+  } else
+    meta_topic(META_DEBUG_THEMES, "Theme cache %s is out of date\n", filename);
+
+  g_mapped_file_unref(mapped);
+  g_free(filename);
+
+  return theme;
+}
@@ -0,0 +1,41 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* Marco binary theme cache */
+
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+#ifndef META_THEME_CACHE_H
+#define META_THEME_CACHE_H
+
+#include <glib/gstdio.h>
+
+#include "theme.h"
+
+/* Returns the theme parsed from theme_file, whose stat is st, if the
+ * user's cache holds a copy made from that same file by this version
+ * of marco; otherwise NULL.
+ */
+MetaTheme *meta_theme_cache_load(const char *theme_name, const char *theme_dir,
+                                 const char *theme_file, const GStatBuf *st);
+
+/* Stores theme, freshly parsed from theme->filename as it was when
+ * stat returned st, in the user's cache.
+ */
+void meta_theme_cache_save(MetaTheme *theme, const GStatBuf *st);
+
+#endif
@@ -28,9 +28,11 @@
 #include "theme-parser.h"
 
 #include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "theme-cache.h"
 #include "util.h"
 
 /* We were intending to put the version number
@@ -1834,9 +1836,6 @@ static void parse_draw_op_element(GMarkupParseContext *context,
     GdkPixbuf *pixbuf;
     MetaColorSpec *colorize_spec = NULL;
     MetaImageFillType fill_type_val;
-    int h, w, c;
-    int pixbuf_width, pixbuf_height, pixbuf_n_channels, pixbuf_rowstride;
-    guchar *pixbuf_pixels;
 
     if (!locate_attributes(context, element_name, attribute_names,
                            attribute_values, error, "!x", &x, "!y", &y,
@@ -1911,50 +1910,7 @@ static void parse_draw_op_element(GMarkupParseContext *context,
     op->data.image.alpha_spec = alpha_spec;
     op->data.image.fill_type = fill_type_val;
 
-    /* Check for vertical & horizontal stripes */
-    pixbuf_n_channels = gdk_pixbuf_get_n_channels(pixbuf);
-    pixbuf_width = gdk_pixbuf_get_width(pixbuf);
-    pixbuf_height = gdk_pixbuf_get_height(pixbuf);
-    pixbuf_rowstride = gdk_pixbuf_get_rowstride(pixbuf);
-    pixbuf_pixels = gdk_pixbuf_get_pixels(pixbuf);
-
-    /* Check for horizontal stripes */
-    for (h = 0; h < pixbuf_height; h++) {
-      for (w = 1; w < pixbuf_width; w++) {
-        for (c = 0; c < pixbuf_n_channels; c++) {
-          if (pixbuf_pixels[(h * pixbuf_rowstride) + c] !=
-              pixbuf_pixels[(h * pixbuf_rowstride) + w + c])
-            break;
-        }
-        if (c < pixbuf_n_channels) break;
-      }
-      if (w < pixbuf_width) break;
-    }
-
-    if (h >= pixbuf_height) {
-      op->data.image.horizontal_stripes = TRUE;
-    } else {
-      op->data.image.horizontal_stripes = FALSE;
-    }
-
-    /* Check for vertical stripes */
-    for (w = 0; w < pixbuf_width; w++) {
-      for (h = 1; h < pixbuf_height; h++) {
-        for (c = 0; c < pixbuf_n_channels; c++) {
-          if (pixbuf_pixels[w + c] !=
-              pixbuf_pixels[(h * pixbuf_rowstride) + w + c])
-            break;
-        }
-        if (c < pixbuf_n_channels) break;
-      }
-      if (h < pixbuf_height) break;
-    }
-
-    if (w >= pixbuf_width) {
-      op->data.image.vertical_stripes = TRUE;
-    } else {
-      op->data.image.vertical_stripes = FALSE;
-    }
+    meta_draw_op_find_stripes(op);
 
     g_assert(info->op_list);
 
@@ -3632,6 +3588,8 @@ static MetaTheme *load_theme(const char *theme_dir, const char *theme_name,
   char *theme_filename;
   char *theme_file;
   MetaTheme *retval;
+  GStatBuf st;
+  gboolean have_stat;
 
   g_return_val_if_fail(error && *error == NULL, NULL);
 
@@ -3642,6 +3600,15 @@ static MetaTheme *load_theme(const char *theme_dir, const char *theme_name,
   theme_filename = g_strdup_printf(MARCO_THEME_FILENAME_FORMAT, major_version);
   theme_file = g_build_filename(theme_dir, theme_filename, NULL);
 
+  /* Stat before reading, so a change made meanwhile is not cached as
+   * this version of the file
+   */
+  have_stat = g_stat(theme_file, &st) == 0;
+  if (have_stat) {
+    retval = meta_theme_cache_load(theme_name, theme_dir, theme_file, &st);
+    if (retval) goto out;
+  }
+
   if (!g_file_get_contents(theme_file, &text, &length, error)) goto out;
 
   meta_topic(META_DEBUG_THEMES, "Parsing theme file %s\n", theme_file);
@@ -3663,6 +3630,8 @@ static MetaTheme *load_theme(const char *theme_dir, const char *theme_name,
   retval = info.theme;
   info.theme = NULL;
 
+  if (retval && have_stat) meta_theme_cache_save(retval, &st);
+
 out:
   if (*error && !theme_error_is_fatal(*error))
     meta_topic(META_DEBUG_THEMES, "Failed to read theme from file %s: %s\n",
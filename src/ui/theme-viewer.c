@@ -35,6 +35,7 @@
 #include <string.h>
 #include <time.h>
 
+#include "draw-cache.h"
 #include "preview-widget.h"
 #include "theme-parser.h"
 #include "theme.h"
@@ -67,6 +68,20 @@ static GtkWidget *previews[META_FRAME_TYPE_LAST * FONT_SIZE_LAST +
 static double milliseconds_to_draw_frame = 0.0;
 
 static void run_theme_benchmark(void);
+static int run_json_benchmark(char **theme_names, int iterations);
+
+static gboolean benchmark = FALSE;
+static int benchmark_iterations = 10;
+static char **theme_names = NULL;
+
+static GOptionEntry options[] = {
+    {"benchmark", 0, 0, G_OPTION_ARG_NONE, &benchmark,
+     N_("Print frame drawing timings of the themes as JSON and exit"), NULL},
+    {"iterations", 0, 0, G_OPTION_ARG_INT, &benchmark_iterations,
+     N_("How often --benchmark draws each frame"), "N"},
+    {G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY, &theme_names, NULL,
+     NULL},
+    {NULL}};
 
 static const gchar *xml =
     "<interface>"
@@ -778,19 +793,32 @@ int main(int argc, char **argv) {
   bind_textdomain_codeset(GETTEXT_PACKAGE, "UTF-8");
 #endif /* ENABLE_NLS */
 
-  gtk_init(&argc, &argv);
+  err = NULL;
+  if (!gtk_init_with_args(&argc, &argv, _("[THEME...]"), options,
+                          GETTEXT_PACKAGE, &err)) {
+    if (err) g_printerr("%s\n", err->message);
+    exit(1);
+  }
 
   if (g_getenv("MARCO_DEBUG") != NULL) {
     meta_set_debugging(TRUE);
     meta_set_verbose(TRUE);
   }
 
+  if (benchmark) {
+    if (benchmark_iterations < 1) {
+      g_printerr(_("The number of iterations must be at least 1\n"));
+      exit(1);
+    }
+
+    return run_json_benchmark(theme_names, benchmark_iterations);
+  }
+
   start = clock();
-  err = NULL;
-  if (argc == 1)
+  if (theme_names == NULL)
     global_theme = meta_theme_load("ClearlooksRe", &err);
-  else if (argc == 2)
-    global_theme = meta_theme_load(argv[1], &err);
+  else if (g_strv_length(theme_names) == 1)
+    global_theme = meta_theme_load(theme_names[0], &err);
   else {
     g_printerr(_("Usage: marco-theme-viewer [THEMENAME]\n"));
     exit(1);
@@ -1004,3 +1032,384 @@ static void run_theme_benchmark(void) {
 
 #undef ITERATIONS
 }
+
+/* marco-theme-viewer --benchmark: draws every frame type in a few
+ * states, button layouts, button states, sizes and scales with each
+ * theme and prints the timings as JSON, without showing any window.
+ */
+
+static const struct {
+  int width;
+  int height;
+} benchmark_sizes[] = {{320, 240}, {1920, 1080}};
+
+static const int benchmark_scales[] = {1, 2};
+
+static const struct {
+  const char *name;
+  MetaFrameFlags set;
+  MetaFrameFlags unset;
+} benchmark_states[] = {{"focused", 0, 0},
+                        {"unfocused", 0, META_FRAME_HAS_FOCUS},
+                        {"maximized", META_FRAME_MAXIMIZED, 0},
+                        {"shaded", META_FRAME_SHADED, 0}};
+
+static const MetaButtonState benchmark_button_states[] = {
+    META_BUTTON_STATE_NORMAL, META_BUTTON_STATE_PRELIGHT,
+    META_BUTTON_STATE_PRESSED};
+
+static int compare_doubles(gconstpointer a, gconstpointer b) {
+  double da = *(const double *)a;
+  double db = *(const double *)b;
+
+  return (da > db) - (da < db);
+}
+
+static void json_append_string(GString *json, const char *str) {
+  g_string_append_c(json, '"');
+
+  for (; *str; str++) {
+    if (*str == '"' || *str == '\\')
+      g_string_append_printf(json, "\\%c", *str);
+    else if ((guchar)*str < 0x20)
+      g_string_append_printf(json, "\\u%04x", *str);
+    else
+      g_string_append_c(json, *str);
+  }
+
+  g_string_append_c(json, '"');
+}
+
+/* JSON wants a dot whatever the locale says */
+static void json_append_double(GString *json, const char *name,
+                               double value) {
+  char buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append_printf(json, "\"%s\": %s", name,
+                         g_ascii_formatd(buf, sizeof(buf), "%.3f", value));
+}
+
+/* Appends the count, min, median, p99 and mean of samples, which are
+ * sorted in the process.
+ */
+static void json_append_stats(GString *json, GArray *samples) {
+  double *values = (double *)samples->data;
+  double sum = 0.0;
+  guint i;
+
+  if (samples->len == 0) {
+    g_string_append(json, "\"count\": 0");
+    return;
+  }
+
+  g_array_sort(samples, compare_doubles);
+
+  for (i = 0; i < samples->len; i++) sum += values[i];
+
+  g_string_append_printf(json, "\"count\": %u, ", samples->len);
+  json_append_double(json, "min_us", values[0]);
+  g_string_append(json, ", ");
+  json_append_double(json, "median_us", values[samples->len / 2]);
+  g_string_append(json, ", ");
+  json_append_double(json, "p99_us",
+                     values[(samples->len * 99 + 99) / 100 - 1]);
+  g_string_append(json, ", ");
+  json_append_double(json, "mean_us", sum / samples->len);
+}
+
+/* Draws one frame type and state in every combination. The times go
+ * into samples, all and by_size unless samples is NULL.
+ */
+static void benchmark_style(
+    MetaTheme *theme, GtkWidget *widget, PangoLayout *layout,
+    int text_height, MetaFrameType type, MetaFrameFlags flags, int iterations,
+    GArray *samples, GArray *all,
+    GArray *by_size[][G_N_ELEMENTS(benchmark_scales)]) {
+  MetaButtonState button_states[META_BUTTON_TYPE_LAST];
+  MetaFrameBorders borders;
+  guint size, scale, layout_index, button_state, i;
+
+  meta_theme_get_frame_borders(theme, type, text_height, flags, &borders);
+
+  for (size = 0; size < G_N_ELEMENTS(benchmark_sizes); size++) {
+    int client_width = benchmark_sizes[size].width;
+    int client_height = benchmark_sizes[size].height;
+
+    if (flags & META_FRAME_SHADED) client_height = 0;
+
+    for (scale = 0; scale < G_N_ELEMENTS(benchmark_scales); scale++) {
+      int s = benchmark_scales[scale];
+      cairo_surface_t *surface;
+      cairo_t *cr;
+
+      surface = cairo_image_surface_create(
+          CAIRO_FORMAT_ARGB32,
+          (client_width + borders.total.left + borders.total.right) * s,
+          (client_height + borders.total.top + borders.total.bottom) * s);
+      cairo_surface_set_device_scale(surface, s, s);
+      cr = cairo_create(surface);
+
+      for (layout_index = 0; layout_index < BUTTON_LAYOUT_COMBINATIONS;
+           layout_index++) {
+        for (button_state = 0;
+             button_state < G_N_ELEMENTS(benchmark_button_states);
+             button_state++) {
+          for (i = 0; i < META_BUTTON_TYPE_LAST; i++)
+            button_states[i] = benchmark_button_states[button_state];
+
+          for (i = 0; i < (guint)iterations; i++) {
+            gint64 start;
+            double elapsed;
+
+            start = g_get_monotonic_time();
+
+            meta_theme_draw_frame(
+                theme, gtk_widget_get_style_context(widget), cr, type, flags,
+                client_width, client_height, layout, text_height,
+                &different_layouts[layout_index], button_states,
+                meta_preview_get_mini_icon(), meta_preview_get_icon());
+            cairo_surface_flush(surface);
+
+            elapsed = g_get_monotonic_time() - start;
+
+            if (samples == NULL) continue;
+
+            g_array_append_val(samples, elapsed);
+            g_array_append_val(all, elapsed);
+            g_array_append_val(by_size[size][scale], elapsed);
+          }
+        }
+      }
+
+      cairo_destroy(cr);
+      cairo_surface_destroy(surface);
+    }
+  }
+}
+
+static MetaFrameFlags get_benchmark_flags(MetaFrameType type, guint state) {
+  MetaFrameFlags flags;
+
+  flags = get_window_flags(type);
+  flags |= benchmark_states[state].set;
+  flags &= ~benchmark_states[state].unset;
+
+  return flags;
+}
+
+static void benchmark_theme(MetaTheme *theme, GtkWidget *widget,
+                            int iterations, GString *json) {
+  GArray *by_size[G_N_ELEMENTS(benchmark_sizes)]
+                 [G_N_ELEMENTS(benchmark_scales)];
+  GArray *all;
+  MetaDrawOpTiming timings[META_DRAW_TYPE_COUNT];
+  MetaDrawCacheStats cache_stats;
+  PangoLayout *layout;
+  int text_height;
+  guint type, state, size, scale, i;
+  gboolean first;
+
+  layout = create_title_layout(widget);
+  text_height = get_text_height(widget);
+
+  all = g_array_new(FALSE, FALSE, sizeof(double));
+  for (size = 0; size < G_N_ELEMENTS(benchmark_sizes); size++)
+    for (scale = 0; scale < G_N_ELEMENTS(benchmark_scales); scale++)
+      by_size[size][scale] = g_array_new(FALSE, FALSE, sizeof(double));
+
+  meta_draw_cache_clear();
+
+  g_string_append(json, ",\n      \"styles\": [");
+  first = TRUE;
+
+  for (type = 0; type < META_FRAME_TYPE_LAST; type++) {
+    for (state = 0; state < G_N_ELEMENTS(benchmark_states); state++) {
+      GArray *samples;
+
+      samples = g_array_new(FALSE, FALSE, sizeof(double));
+
+      benchmark_style(theme, widget, layout, text_height, type,
+                      get_benchmark_flags(type, state), iterations, samples,
+                      all, by_size);
+
+      g_string_append_printf(json, "%s\n        {\"type\": ", first ? "" : ",");
+      json_append_string(json, meta_frame_type_to_string(type));
+      g_string_append(json, ", \"state\": ");
+      json_append_string(json, benchmark_states[state].name);
+      g_string_append(json, ", ");
+      json_append_stats(json, samples);
+      g_string_append(json, "}");
+      first = FALSE;
+
+      g_array_free(samples, TRUE);
+    }
+  }
+
+  meta_draw_cache_get_stats(&cache_stats);
+
+  /* The ops are timed in a pass of their own, so that the cost of
+     timing them doesn't show in the frame times above */
+  memset(timings, 0, sizeof(timings));
+  meta_draw_op_set_timings(timings);
+
+  for (type = 0; type < META_FRAME_TYPE_LAST; type++)
+    for (state = 0; state < G_N_ELEMENTS(benchmark_states); state++)
+      benchmark_style(theme, widget, layout, text_height, type,
+                      get_benchmark_flags(type, state), iterations, NULL,
+                      NULL, NULL);
+
+  meta_draw_op_set_timings(NULL);
+
+  g_string_append(json, "\n      ],\n      \"sizes\": [");
+  first = TRUE;
+  for (size = 0; size < G_N_ELEMENTS(benchmark_sizes); size++) {
+    for (scale = 0; scale < G_N_ELEMENTS(benchmark_scales); scale++) {
+      g_string_append_printf(
+          json, "%s\n        {\"width\": %d, \"height\": %d, \"scale\": %d, ",
+          first ? "" : ",", benchmark_sizes[size].width,
+          benchmark_sizes[size].height, benchmark_scales[scale]);
+      json_append_stats(json, by_size[size][scale]);
+      g_string_append(json, "}");
+      first = FALSE;
+
+      g_array_free(by_size[size][scale], TRUE);
+    }
+  }
+
+  g_string_append(json, "\n      ],\n      \"ops\": [");
+  first = TRUE;
+  for (i = 0; i < META_DRAW_TYPE_COUNT; i++) {
+    if (timings[i].count == 0) continue;
+
+    g_string_append_printf(json, "%s\n        {\"op\": ", first ? "" : ",");
+    json_append_string(json, meta_draw_type_to_string(i));
+    g_string_append_printf(json, ", \"count\": %" G_GUINT64_FORMAT ", ",
+                           timings[i].count);
+    json_append_double(json, "total_us", timings[i].time / 1000.0);
+    g_string_append(json, ", ");
+    json_append_double(json, "mean_us",
+                       timings[i].time / 1000.0 / timings[i].count);
+    g_string_append(json, "}");
+    first = FALSE;
+  }
+
+  g_string_append_printf(
+      json,
+      "\n      ],\n      \"draw_cache\": {\"hits\": %" G_GUINT64_FORMAT
+      ", \"misses\": %" G_GUINT64_FORMAT ", \"evictions\": %" G_GUINT64_FORMAT
+      ", \"entries\": %u, \"bytes\": %" G_GSIZE_FORMAT "},",
+      cache_stats.hits, cache_stats.misses, cache_stats.evictions,
+      cache_stats.n_entries, cache_stats.bytes);
+
+  g_string_append(json, "\n      \"frames\": {");
+  json_append_stats(json, all);
+  g_string_append(json, "}");
+
+  g_array_free(all, TRUE);
+  g_object_unref(layout);
+}
+
+/* The themes in the source tree, when run from src/ */
+static GPtrArray *list_source_themes(void) {
+  GPtrArray *names;
+  const char *name;
+  GDir *dir;
+
+  names = g_ptr_array_new_with_free_func(g_free);
+
+  dir = g_dir_open("themes", 0, NULL);
+  if (dir == NULL) return names;
+
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    char *path = g_build_filename("themes", name, NULL);
+
+    if (g_file_test(path, G_FILE_TEST_IS_DIR))
+      g_ptr_array_add(names, g_strdup(name));
+
+    g_free(path);
+  }
+
+  g_dir_close(dir);
+
+  g_ptr_array_sort(names, (GCompareFunc)g_strcmp0);
+
+  return names;
+}
+
+static int run_json_benchmark(char **theme_names, int iterations) {
+  GPtrArray *names;
+  GtkWidget *widget;
+  GString *json;
+  gboolean failed = FALSE;
+  guint i;
+
+  names = g_ptr_array_new_with_free_func(g_free);
+
+  if (theme_names && theme_names[0]) {
+    for (i = 0; theme_names[i]; i++)
+      g_ptr_array_add(names, g_strdup(theme_names[i]));
+  } else {
+    g_ptr_array_unref(names);
+    names = list_source_themes();
+
+    /* Makes meta_theme_load () look in ./themes first */
+    meta_set_debugging(TRUE);
+  }
+
+  if (names->len == 0) {
+    g_printerr(_("No themes to benchmark; give theme names or run from the "
+                 "directory containing \"themes\"\n"));
+    g_ptr_array_unref(names);
+    return 1;
+  }
+
+  init_layouts();
+
+  widget = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+  gtk_widget_realize(widget);
+
+  json = g_string_new(NULL);
+  g_string_append_printf(json, "{\n  \"iterations\": %d,\n  \"themes\": [",
+                         iterations);
+
+  for (i = 0; i < names->len; i++) {
+    const char *name = g_ptr_array_index(names, i);
+    MetaTheme *theme;
+    GError *err = NULL;
+    gint64 start;
+
+    start = g_get_monotonic_time();
+    theme = meta_theme_load(name, &err);
+
+    g_string_append_printf(json, "%s\n    {\n      \"name\": ",
+                           i > 0 ? "," : "");
+    json_append_string(json, name);
+
+    if (theme == NULL) {
+      g_string_append(json, ",\n      \"error\": ");
+      json_append_string(json, err->message);
+      g_string_append(json, "\n    }");
+      g_error_free(err);
+      failed = TRUE;
+      continue;
+    }
+
+    g_string_append(json, ",\n      ");
+    json_append_double(json, "load_ms",
+                       (g_get_monotonic_time() - start) / 1000.0);
+
+    benchmark_theme(theme, widget, iterations, json);
+    g_string_append(json, "\n    }");
+
+    meta_theme_free(theme);
+  }
+
+  g_string_append(json, "\n  ]\n}\n");
+  fputs(json->str, stdout);
+
+  g_string_free(json, TRUE);
+  gtk_widget_destroy(widget);
+  g_ptr_array_unref(names);
+
+  return failed ? 1 : 0;
+}
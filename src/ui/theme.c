@@ -62,7 +62,9 @@
 #include <gtk/gtk.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "draw-cache.h"
 #include "gradient.h"
 #include "prefs.h"
 #include "theme-parser.h"
@@ -188,6 +190,36 @@ static cairo_surface_t *get_surface_from_pixbuf(GdkPixbuf *pixbuf,
   return copy;
 }
 
+/* Frames of the same size draw the same images at the same sizes, so
+ * keep what get_surface_from_pixbuf () made of them
+ */
+static cairo_surface_t *get_cached_surface_from_pixbuf(
+    GdkPixbuf *pixbuf, MetaImageFillType fill_type, gdouble width,
+    gdouble height, gboolean vertical_stripes, gboolean horizontal_stripes) {
+  cairo_surface_t *surface;
+  GByteArray *key;
+
+  key = meta_draw_cache_key_new("pixbuf");
+  meta_draw_cache_key_add(key, pixbuf);
+  meta_draw_cache_key_add(key, fill_type);
+  meta_draw_cache_key_add(key, width);
+  meta_draw_cache_key_add(key, height);
+  meta_draw_cache_key_add(key, vertical_stripes);
+  meta_draw_cache_key_add(key, horizontal_stripes);
+
+  surface = meta_draw_cache_lookup(key);
+  if (surface == NULL) {
+    surface = get_surface_from_pixbuf(pixbuf, fill_type, width, height,
+                                      vertical_stripes, horizontal_stripes);
+    if (surface != NULL)
+      meta_draw_cache_insert(key, surface, pixbuf, width, height);
+  }
+
+  g_byte_array_unref(key);
+
+  return surface;
+}
+
 static GdkPixbuf *colorize_pixbuf(GdkPixbuf *orig, GdkRGBA *new_color) {
   GdkPixbuf *pixbuf;
   double intensity;
@@ -1073,27 +1105,116 @@ void meta_gradient_spec_free(MetaGradientSpec *spec) {
   g_free(spec);
 }
 
+static void fill_with_gradient(cairo_t *cr, cairo_pattern_t *pattern, gint x,
+                               gint y, gint width, gint height) {
+  cairo_save(cr);
+
+  cairo_rectangle(cr, x, y, width, height);
+
+  cairo_translate(cr, x, y);
+  cairo_scale(cr, width, height);
+
+  cairo_set_source(cr, pattern);
+  cairo_fill(cr);
+
+  cairo_restore(cr);
+}
+
+/* Returns the cache key for pattern drawn over the given rectangle of
+ * cr, or NULL if the rectangle doesn't sit on whole device pixels, in
+ * which case a copy rendered elsewhere would not match.
+ */
+static GByteArray *get_gradient_key(cairo_t *cr, cairo_pattern_t *pattern,
+                                    gint x, gint y, gint width, gint height) {
+  cairo_surface_t *target;
+  cairo_surface_type_t type;
+  cairo_matrix_t matrix;
+  GByteArray *key;
+  double device_x, device_y, scale_x, scale_y;
+  double x0, y0, x1, y1;
+  int n_stops, i;
+
+  if (width <= 0 || height <= 0) return NULL;
+
+  cairo_get_matrix(cr, &matrix);
+  if (matrix.xx != 1.0 || matrix.yy != 1.0 || matrix.xy != 0.0 ||
+      matrix.yx != 0.0)
+    return NULL;
+
+  device_x = x;
+  device_y = y;
+  cairo_user_to_device(cr, &device_x, &device_y);
+  if (device_x != floor(device_x) || device_y != floor(device_y)) return NULL;
+
+  target = cairo_get_target(cr);
+  type = cairo_surface_get_type(target);
+  cairo_surface_get_device_scale(target, &scale_x, &scale_y);
+  cairo_pattern_get_linear_points(pattern, &x0, &y0, &x1, &y1);
+
+  key = meta_draw_cache_key_new("gradient");
+  meta_draw_cache_key_add(key, type);
+  meta_draw_cache_key_add(key, scale_x);
+  meta_draw_cache_key_add(key, scale_y);
+  meta_draw_cache_key_add(key, width);
+  meta_draw_cache_key_add(key, height);
+  meta_draw_cache_key_add(key, x1);
+  meta_draw_cache_key_add(key, y1);
+
+  cairo_pattern_get_color_stop_count(pattern, &n_stops);
+  for (i = 0; i < n_stops; i++) {
+    double stop[5];
+
+    cairo_pattern_get_color_stop_rgba(pattern, i, &stop[0], &stop[1],
+                                      &stop[2], &stop[3], &stop[4]);
+    meta_draw_cache_key_add(key, stop);
+  }
+
+  return key;
+}
+
 void meta_gradient_spec_render(const MetaGradientSpec *spec,
                                const MetaAlphaGradientSpec *alpha_spec,
                                cairo_t *cr, GtkStyleContext *context, gint x,
                                gint y, gint width, gint height) {
   cairo_pattern_t *pattern;
+  cairo_surface_t *surface;
+  GByteArray *key;
 
   pattern = create_cairo_pattern_from_gradient_spec(spec, alpha_spec, context);
   if (pattern == NULL) return;
 
-  cairo_save(cr);
+  key = get_gradient_key(cr, pattern, x, y, width, height);
+  if (key == NULL) {
+    fill_with_gradient(cr, pattern, x, y, width, height);
+    cairo_pattern_destroy(pattern);
+    return;
+  }
 
-  cairo_rectangle(cr, x, y, width, height);
+  surface = meta_draw_cache_lookup(key);
+  if (surface == NULL) {
+    cairo_t *surface_cr;
 
-  cairo_translate(cr, x, y);
-  cairo_scale(cr, width, height);
+    surface = cairo_surface_create_similar(
+        cairo_get_target(cr), CAIRO_CONTENT_COLOR_ALPHA, width, height);
 
-  cairo_set_source(cr, pattern);
+    surface_cr = cairo_create(surface);
+    fill_with_gradient(surface_cr, pattern, 0, 0, width, height);
+    cairo_destroy(surface_cr);
+
+    meta_draw_cache_insert(key, surface, NULL, width, height);
+  }
+
+  cairo_save(cr);
+
+  cairo_set_source_surface(cr, surface, x, y);
+  cairo_rectangle(cr, x, y, width, height);
   cairo_fill(cr);
-  cairo_pattern_destroy(pattern);
 
   cairo_restore(cr);
+
+  cairo_surface_destroy(surface);
+  g_byte_array_unref(key);
+  cairo_pattern_destroy(pattern);
 }
 
 gboolean meta_gradient_spec_validate(MetaGradientSpec *spec, GError **error) {
@@ -2502,6 +2623,383 @@ static gboolean pos_eval_helper(PosToken *tokens, int n_tokens,
   return TRUE;
 }
 
+/**
+ * The variables an expression can use, resolved when the expression is
+ * compiled instead of on every evaluation.
+ *
+ * \ingroup parser
+ */
+typedef enum {
+  POS_VAR_WIDTH,
+  POS_VAR_HEIGHT,
+  POS_VAR_OBJECT_WIDTH,
+  POS_VAR_OBJECT_HEIGHT,
+  POS_VAR_LEFT_WIDTH,
+  POS_VAR_RIGHT_WIDTH,
+  POS_VAR_TOP_HEIGHT,
+  POS_VAR_BOTTOM_HEIGHT,
+  POS_VAR_MINI_ICON_WIDTH,
+  POS_VAR_MINI_ICON_HEIGHT,
+  POS_VAR_ICON_WIDTH,
+  POS_VAR_ICON_HEIGHT,
+  POS_VAR_TITLE_WIDTH,
+  POS_VAR_TITLE_HEIGHT,
+  POS_VAR_FRAME_X_CENTER,
+  POS_VAR_FRAME_Y_CENTER,
+  POS_VAR_LAST
+} PosVariable;
+
+/* In PosVariable order */
+static const char *const pos_variable_names[POS_VAR_LAST] = {
+    "width",           "height",           "object_width",
+    "object_height",   "left_width",       "right_width",
+    "top_height",      "bottom_height",    "mini_icon_width",
+    "mini_icon_height", "icon_width",      "icon_height",
+    "title_width",     "title_height",     "frame_x_center",
+    "frame_y_center"};
+
+typedef enum {
+  POS_INSTR_PUSH,     /* push a constant */
+  POS_INSTR_VARIABLE, /* push the value of a variable */
+  POS_INSTR_OPERATOR  /* replace the top two values with the result */
+} PosInstrType;
+
+struct _PosInstr {
+  PosInstrType type;
+  union {
+    PosExpr value;
+    PosVariable variable;
+    PosOperatorType op;
+  } d;
+};
+
+/**
+ * The expression tree pos_compile() builds before flattening it.
+ *
+ * \ingroup parser
+ */
+typedef struct _PosNode PosNode;
+
+struct _PosNode {
+  PosInstr instr;
+  PosNode *left;
+  PosNode *right;
+};
+
+static void pos_node_free(PosNode *node) {
+  if (node == NULL) return;
+
+  pos_node_free(node->left);
+  pos_node_free(node->right);
+  g_free(node);
+}
+
+static PosNode *pos_node_new_leaf(PosInstrType type) {
+  PosNode *node = g_new0(PosNode, 1);
+
+  node->instr.type = type;
+
+  return node;
+}
+
+/* Applies op to left and right, computing the result right away when
+   both are constant and the operation is valid. Invalid operations are
+   left for evaluation time, where they are reported. */
+static PosNode *pos_node_combine(PosNode *left, PosOperatorType op,
+                                 PosNode *right) {
+  PosNode *node;
+
+  if (left->instr.type == POS_INSTR_PUSH &&
+      right->instr.type == POS_INSTR_PUSH) {
+    PosExpr a = left->instr.d.value;
+    PosExpr b = right->instr.d.value;
+
+    if (do_operation(&a, &b, op, NULL)) {
+      left->instr.d.value = a;
+      pos_node_free(right);
+      return left;
+    }
+  }
+
+  node = pos_node_new_leaf(POS_INSTR_OPERATOR);
+  node->instr.d.op = op;
+  node->left = left;
+  node->right = right;
+
+  return node;
+}
+
+/* Builds the tree for tokens the same way pos_eval_helper() evaluates
+   them: parenthesized groups first, then operators by precedence, left
+   to right. Returns NULL for anything pos_eval_helper() would reject,
+   so that it gets to report the error. */
+static PosNode *pos_compile_group(PosToken *tokens, int n_tokens) {
+  PosNode *operands[MAX_EXPRS];
+  PosOperatorType operators[MAX_EXPRS];
+  int n_operands, n_operators;
+  int precedence;
+  int i, j;
+
+  n_operands = 0;
+  n_operators = 0;
+
+  for (i = 0; i < n_tokens; i++) {
+    PosToken *t = &tokens[i];
+    PosNode *node = NULL;
+
+    /* Operands and operators have to alternate */
+    if ((t->type == POS_TOKEN_OPERATOR) != (n_operands > n_operators) ||
+        n_operands + n_operators >= MAX_EXPRS)
+      goto fail;
+
+    switch (t->type) {
+      case POS_TOKEN_INT:
+        node = pos_node_new_leaf(POS_INSTR_PUSH);
+        node->instr.d.value.type = POS_EXPR_INT;
+        node->instr.d.value.d.int_val = t->d.i.val;
+        break;
+
+      case POS_TOKEN_DOUBLE:
+        node = pos_node_new_leaf(POS_INSTR_PUSH);
+        node->instr.d.value.type = POS_EXPR_DOUBLE;
+        node->instr.d.value.d.double_val = t->d.d.val;
+        break;
+
+      case POS_TOKEN_VARIABLE:
+        for (j = 0; j < POS_VAR_LAST; j++)
+          if (strcmp(t->d.v.name, pos_variable_names[j]) == 0) break;
+
+        if (j == POS_VAR_LAST) goto fail;
+
+        node = pos_node_new_leaf(POS_INSTR_VARIABLE);
+        node->instr.d.variable = j;
+        break;
+
+      case POS_TOKEN_OPEN_PAREN: {
+        int level = 1;
+
+        for (j = i + 1; j < n_tokens; j++) {
+          if (tokens[j].type == POS_TOKEN_OPEN_PAREN)
+            ++level;
+          else if (tokens[j].type == POS_TOKEN_CLOSE_PAREN && --level == 0)
+            break;
+        }
+
+        if (j == n_tokens) goto fail;
+
+        node = pos_compile_group(&tokens[i + 1], j - i - 1);
+        if (node == NULL) goto fail;
+
+        i = j;
+        break;
+      }
+
+      case POS_TOKEN_CLOSE_PAREN:
+        goto fail;
+
+      case POS_TOKEN_OPERATOR:
+        operators[n_operators++] = t->d.o.op;
+        break;
+    }
+
+    if (node) operands[n_operands++] = node;
+  }
+
+  if (n_operands == 0 || n_operands == n_operators) goto fail;
+
+  for (precedence = 2; precedence >= 0; precedence--) {
+    i = 0;
+    while (i < n_operators) {
+      PosOperatorType op = operators[i];
+      gboolean matches;
+
+      if (precedence == 2)
+        matches = op == POS_OP_MULTIPLY || op == POS_OP_DIVIDE ||
+                  op == POS_OP_MOD;
+      else if (precedence == 1)
+        matches = op == POS_OP_ADD || op == POS_OP_SUBTRACT;
+      else
+        matches = op == POS_OP_MAX || op == POS_OP_MIN;
+
+      if (!matches) {
+        i++;
+        continue;
+      }
+
+      operands[i] = pos_node_combine(operands[i], op, operands[i + 1]);
+
+      memmove(&operands[i + 1], &operands[i + 2],
+              sizeof(PosNode *) * (n_operands - i - 2));
+      memmove(&operators[i], &operators[i + 1],
+              sizeof(PosOperatorType) * (n_operators - i - 1));
+      n_operands--;
+      n_operators--;
+    }
+  }
+
+  g_assert(n_operands == 1);
+
+  return operands[0];
+
+fail:
+  for (i = 0; i < n_operands; i++) pos_node_free(operands[i]);
+
+  return NULL;
+}
+
+/* Appends node to program in postfix order and returns how deep the
+   value stack gets while evaluating it */
+static int pos_node_flatten(PosNode *node, GArray *program) {
+  int depth = 1;
+
+  if (node->instr.type == POS_INSTR_OPERATOR) {
+    int left = pos_node_flatten(node->left, program);
+    int right = pos_node_flatten(node->right, program);
+
+    depth = MAX(left, right + 1);
+  }
+
+  g_array_append_val(program, node->instr);
+
+  return depth;
+}
+
+/**
+ * Compiles an expression into spec->program, so that evaluating it no
+ * longer has to look at parentheses, precedence or variable names.
+ * Leaves spec->program NULL if the expression has errors.
+ *
+ * \ingroup parser
+ */
+static void pos_compile(MetaDrawSpec *spec) {
+  PosNode *tree;
+  GArray *program;
+  int depth;
+
+  tree = pos_compile_group(spec->tokens, spec->n_tokens);
+  if (tree == NULL) return;
+
+  program = g_array_new(FALSE, FALSE, sizeof(PosInstr));
+  depth = pos_node_flatten(tree, program);
+  pos_node_free(tree);
+
+  if (depth > MAX_EXPRS) {
+    g_array_free(program, TRUE);
+    return;
+  }
+
+  spec->n_program = program->len;
+  spec->program = (PosInstr *)g_array_free(program, FALSE);
+}
+
+static gboolean pos_variable_value(PosVariable variable,
+                                   const MetaPositionExprEnv *env,
+                                   int *result) {
+  switch (variable) {
+    case POS_VAR_WIDTH:
+      *result = env->rect.width;
+      break;
+    case POS_VAR_HEIGHT:
+      *result = env->rect.height;
+      break;
+    case POS_VAR_OBJECT_WIDTH:
+      if (env->object_width < 0) return FALSE;
+      *result = env->object_width;
+      break;
+    case POS_VAR_OBJECT_HEIGHT:
+      if (env->object_height < 0) return FALSE;
+      *result = env->object_height;
+      break;
+    case POS_VAR_LEFT_WIDTH:
+      *result = env->left_width;
+      break;
+    case POS_VAR_RIGHT_WIDTH:
+      *result = env->right_width;
+      break;
+    case POS_VAR_TOP_HEIGHT:
+      *result = env->top_height;
+      break;
+    case POS_VAR_BOTTOM_HEIGHT:
+      *result = env->bottom_height;
+      break;
+    case POS_VAR_MINI_ICON_WIDTH:
+      *result = env->mini_icon_width;
+      break;
+    case POS_VAR_MINI_ICON_HEIGHT:
+      *result = env->mini_icon_height;
+      break;
+    case POS_VAR_ICON_WIDTH:
+      *result = env->icon_width;
+      break;
+    case POS_VAR_ICON_HEIGHT:
+      *result = env->icon_height;
+      break;
+    case POS_VAR_TITLE_WIDTH:
+      *result = env->title_width;
+      break;
+    case POS_VAR_TITLE_HEIGHT:
+      *result = env->title_height;
+      break;
+    case POS_VAR_FRAME_X_CENTER:
+      *result = env->frame_x_center;
+      break;
+    case POS_VAR_FRAME_Y_CENTER:
+      *result = env->frame_y_center;
+      break;
+    case POS_VAR_LAST:
+      g_assert_not_reached();
+      break;
+  }
+
+  return TRUE;
+}
+
+/**
+ * Runs a compiled expression. Returns FALSE without saying why if the
+ * expression cannot be evaluated in env; pos_eval_helper() finds the
+ * same problem and reports it.
+ *
+ * \ingroup parser
+ */
+static gboolean pos_program_run(const MetaDrawSpec *spec,
+                                const MetaPositionExprEnv *env,
+                                PosExpr *result) {
+  PosExpr stack[MAX_EXPRS];
+  int n_stack = 0;
+  int i;
+
+  for (i = 0; i < spec->n_program; i++) {
+    const PosInstr *instr = &spec->program[i];
+
+    switch (instr->type) {
+      case POS_INSTR_PUSH:
+        stack[n_stack++] = instr->d.value;
+        break;
+
+      case POS_INSTR_VARIABLE:
+        stack[n_stack].type = POS_EXPR_INT;
+        if (!pos_variable_value(instr->d.variable, env,
+                                &stack[n_stack].d.int_val))
+          return FALSE;
+        n_stack++;
+        break;
+
+      case POS_INSTR_OPERATOR:
+        n_stack--;
+        if (!do_operation(&stack[n_stack - 1], &stack[n_stack], instr->d.op,
+                          NULL))
+          return FALSE;
+        break;
+    }
+  }
+
+  g_assert(n_stack == 1);
+
+  *result = stack[0];
+
+  return TRUE;
+}
+
 /*
  *   expr = int | double | expr * expr | expr / expr |
  *          expr + expr | expr - expr | (expr)
@@ -2530,7 +3028,8 @@ static gboolean pos_eval(MetaDrawSpec *spec, const MetaPositionExprEnv *env,
 
   *val_p = 0;
 
-  if (pos_eval_helper(spec->tokens, spec->n_tokens, env, &expr, err)) {
+  if ((spec->program && env && pos_program_run(spec, env, &expr)) ||
+      pos_eval_helper(spec->tokens, spec->n_tokens, env, &expr, err)) {
     switch (expr.type) {
       case POS_EXPR_INT:
         *val_p = expr.d.int_val;
@@ -2699,16 +3198,29 @@ static int parse_size_unchecked(MetaDrawSpec *spec, MetaPositionExprEnv *env) {
 void meta_draw_spec_free(MetaDrawSpec *spec) {
   if (!spec) return;
   free_tokens(spec->tokens, spec->n_tokens);
+  g_free(spec->program);
   g_slice_free(MetaDrawSpec, spec);
 }
 
 MetaDrawSpec *meta_draw_spec_new(MetaTheme *theme, const char *expr,
                                  GError **error) {
+  PosToken *tokens;
+  int n_tokens;
+
+  pos_tokenize(expr, &tokens, &n_tokens, NULL);
+
+  return meta_draw_spec_new_from_tokens(theme, tokens, n_tokens, error);
+}
+
+MetaDrawSpec *meta_draw_spec_new_from_tokens(MetaTheme *theme,
+                                             PosToken *tokens, int n_tokens,
+                                             GError **error) {
   MetaDrawSpec *spec;
 
   spec = g_slice_new0(MetaDrawSpec);
 
-  pos_tokenize(expr, &spec->tokens, &spec->n_tokens, NULL);
+  spec->tokens = tokens;
+  spec->n_tokens = n_tokens;
 
   spec->constant =
       meta_theme_replace_constants(theme, spec->tokens, spec->n_tokens, NULL);
@@ -2717,7 +3229,8 @@ MetaDrawSpec *meta_draw_spec_new(MetaTheme *theme, const char *expr,
       meta_draw_spec_free(spec);
       return NULL;
     }
-  }
+  } else
+    pos_compile(spec);
 
   return spec;
 }
@@ -2943,6 +3456,61 @@ void meta_draw_op_free(MetaDrawOp *op) {
   g_free(op);
 }
 
+void meta_draw_op_find_stripes(MetaDrawOp *op) {
+  GdkPixbuf *pixbuf;
+  int h, w, c;
+  int pixbuf_width, pixbuf_height, pixbuf_n_channels, pixbuf_rowstride;
+  guchar *pixbuf_pixels;
+
+  g_return_if_fail(op->type == META_DRAW_IMAGE);
+
+  pixbuf = op->data.image.pixbuf;
+
+  pixbuf_n_channels = gdk_pixbuf_get_n_channels(pixbuf);
+  pixbuf_width = gdk_pixbuf_get_width(pixbuf);
+  pixbuf_height = gdk_pixbuf_get_height(pixbuf);
+  pixbuf_rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+  pixbuf_pixels = gdk_pixbuf_get_pixels(pixbuf);
+
+  /* Check for horizontal stripes */
+  for (h = 0; h < pixbuf_height; h++) {
+    for (w = 1; w < pixbuf_width; w++) {
+      for (c = 0; c < pixbuf_n_channels; c++) {
+        if (pixbuf_pixels[(h * pixbuf_rowstride) + c] !=
+            pixbuf_pixels[(h * pixbuf_rowstride) + w + c])
+          break;
+      }
+      if (c < pixbuf_n_channels) break;
+    }
+    if (w < pixbuf_width) break;
+  }
+
+  if (h >= pixbuf_height) {
+    op->data.image.horizontal_stripes = TRUE;
+  } else {
+    op->data.image.horizontal_stripes = FALSE;
+  }
+
+  /* Check for vertical stripes */
+  for (w = 0; w < pixbuf_width; w++) {
+    for (h = 1; h < pixbuf_height; h++) {
+      for (c = 0; c < pixbuf_n_channels; c++) {
+        if (pixbuf_pixels[w + c] !=
+            pixbuf_pixels[(h * pixbuf_rowstride) + w + c])
+          break;
+      }
+      if (c < pixbuf_n_channels) break;
+    }
+    if (h < pixbuf_height) break;
+  }
+
+  if (w >= pixbuf_width) {
+    op->data.image.vertical_stripes = TRUE;
+  } else {
+    op->data.image.vertical_stripes = FALSE;
+  }
+}
+
 static GdkPixbuf *apply_alpha(GdkPixbuf *pixbuf, MetaAlphaGradientSpec *spec,
                               gboolean force_copy) {
   GdkPixbuf *new_pixbuf;
@@ -3300,13 +3868,13 @@ static cairo_surface_t *draw_op_as_surface(const MetaDrawOp *op,
         }
 
         if (op->data.image.colorize_cache_pixbuf) {
-          surface = get_surface_from_pixbuf(
+          surface = get_cached_surface_from_pixbuf(
               op->data.image.colorize_cache_pixbuf, op->data.image.fill_type,
               width, height, op->data.image.vertical_stripes,
               op->data.image.horizontal_stripes);
         }
       } else {
-        surface = get_surface_from_pixbuf(
+        surface = get_cached_surface_from_pixbuf(
             op->data.image.pixbuf, op->data.image.fill_type, width, height,
             op->data.image.vertical_stripes, op->data.image.horizontal_stripes);
       }
@@ -3316,12 +3884,12 @@ static cairo_surface_t *draw_op_as_surface(const MetaDrawOp *op,
     case META_DRAW_ICON:
       if (info->mini_icon && width <= gdk_pixbuf_get_width(info->mini_icon) &&
           height <= gdk_pixbuf_get_height(info->mini_icon))
-        surface =
-            get_surface_from_pixbuf(info->mini_icon, op->data.icon.fill_type,
-                                    width, height, FALSE, FALSE);
+        surface = get_cached_surface_from_pixbuf(info->mini_icon,
+                                                 op->data.icon.fill_type,
+                                                 width, height, FALSE, FALSE);
       else if (info->icon)
-        surface = get_surface_from_pixbuf(info->icon, op->data.icon.fill_type,
-                                          width, height, FALSE, FALSE);
+        surface = get_cached_surface_from_pixbuf(
+            info->icon, op->data.icon.fill_type, width, height, FALSE, FALSE);
       break;
 
     case META_DRAW_TINT:
@@ -3380,6 +3948,21 @@ static void fill_env(MetaPositionExprEnv *env, const MetaDrawInfo *info,
   env->theme = meta_current_theme;
 }
 
+static MetaDrawOpTiming *draw_op_timings = NULL;
+
+void meta_draw_op_set_timings(MetaDrawOpTiming *timings) {
+  draw_op_timings = timings;
+}
+
+/* Most draw ops take less than a microsecond */
+static gint64 get_draw_op_time(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 /* This code was originally rendering anti-aliased using X primitives, and
  * now has been switched to draw anti-aliased using cairo. In general, the
  * closest correspondence between X rendering and cairo rendering is given
@@ -3397,6 +3980,9 @@ static void meta_draw_op_draw_with_env(const MetaDrawOp *op,
                                        MetaRectangle rect,
                                        MetaPositionExprEnv *env) {
   GdkRGBA color;
+  gint64 start = 0;
+
+  if (draw_op_timings) start = get_draw_op_time();
 
   cairo_save(cr);
   gtk_style_context_save(style_gtk);
@@ -3549,16 +4135,41 @@ static void meta_draw_op_draw_with_env(const MetaDrawOp *op,
         cairo_rectangle(cr, rx, ry, rwidth, rheight);
         cairo_fill(cr);
       } else {
-        GdkPixbuf *pixbuf;
+        MetaAlphaGradientSpec *alpha_spec = op->data.tint.alpha_spec;
+        cairo_surface_t *surface;
+        GByteArray *key;
+
+        meta_color_spec_render(op->data.tint.color_spec, style_gtk, &color);
+
+        key = meta_draw_cache_key_new("tint");
+        meta_draw_cache_key_add(key, color);
+        meta_draw_cache_key_add(key, alpha_spec->type);
+        g_byte_array_append(key, alpha_spec->alphas, alpha_spec->n_alphas);
+        meta_draw_cache_key_add(key, rwidth);
+        meta_draw_cache_key_add(key, rheight);
+
+        surface = meta_draw_cache_lookup(key);
+        if (surface == NULL) {
+          GdkPixbuf *pixbuf;
 
-        pixbuf = draw_op_as_pixbuf(op, style_gtk, info, rwidth, rheight);
+          pixbuf = draw_op_as_pixbuf(op, style_gtk, info, rwidth, rheight);
+
+          if (pixbuf) {
+            surface = gdk_cairo_surface_create_from_pixbuf(pixbuf, 1, NULL);
+            meta_draw_cache_insert(key, surface, NULL, rwidth, rheight);
+
+            g_object_unref(G_OBJECT(pixbuf));
+          }
+        }
 
-        if (pixbuf) {
-          gdk_cairo_set_source_pixbuf(cr, pixbuf, rx, ry);
+        if (surface) {
+          cairo_set_source_surface(cr, surface, rx, ry);
           cairo_paint(cr);
 
-          g_object_unref(G_OBJECT(pixbuf));
+          cairo_surface_destroy(surface);
         }
+
+        g_byte_array_unref(key);
       }
     } break;
 
@@ -3843,6 +4454,11 @@ static void meta_draw_op_draw_with_env(const MetaDrawOp *op,
 
   cairo_restore(cr);
   gtk_style_context_restore(style_gtk);
+
+  if (draw_op_timings) {
+    draw_op_timings[op->type].count++;
+    draw_op_timings[op->type].time += get_draw_op_time() - start;
+  }
 }
 
 void meta_draw_op_draw_with_style(const MetaDrawOp *op,
@@ -5727,6 +6343,42 @@ const char *meta_frame_type_to_string(MetaFrameType type) {
   return "<unknown>";
 }
 
+/* Returns the element name the op has in theme files */
+const char *meta_draw_type_to_string(MetaDrawType type) {
+  switch (type) {
+    case META_DRAW_LINE:
+      return "line";
+    case META_DRAW_RECTANGLE:
+      return "rectangle";
+    case META_DRAW_ARC:
+      return "arc";
+    case META_DRAW_CLIP:
+      return "clip";
+    case META_DRAW_TINT:
+      return "tint";
+    case META_DRAW_GRADIENT:
+      return "gradient";
+    case META_DRAW_IMAGE:
+      return "image";
+    case META_DRAW_GTK_ARROW:
+      return "gtk_arrow";
+    case META_DRAW_GTK_BOX:
+      return "gtk_box";
+    case META_DRAW_GTK_VLINE:
+      return "gtk_vline";
+    case META_DRAW_ICON:
+      return "icon";
+    case META_DRAW_TITLE:
+      return "title";
+    case META_DRAW_OP_LIST:
+      return "include";
+    case META_DRAW_TILE:
+      return "tile";
+  }
+
+  return "<unknown>";
+}
+
 MetaGradientType meta_gradient_type_from_string(const char *str) {
   if (strcmp("vertical", str) == 0)
     return META_GRADIENT_VERTICAL;
@@ -331,6 +331,18 @@ typedef enum {
   META_DRAW_TILE
 } MetaDrawType;
 
+#define META_DRAW_TYPE_COUNT (META_DRAW_TILE + 1)
+
+/**
+ * How often a kind of draw op ran and for how long, in nanoseconds.
+ * The time of META_DRAW_OP_LIST and META_DRAW_TILE includes the ops
+ * they contain, and the cost of timing them.
+ */
+typedef struct {
+  guint64 count;
+  gint64 time;
+} MetaDrawOpTiming;
+
 typedef enum {
   POS_TOKEN_INT,
   POS_TOKEN_DOUBLE,
@@ -380,6 +392,13 @@ typedef struct {
   } d;
 } PosToken;
 
+/**
+ * One step of an expression compiled by meta_draw_spec_new().
+ *
+ * \ingroup parser
+ */
+typedef struct _PosInstr PosInstr;
+
 /**
  * A computed expression in our simple vector drawing language.
  * While it appears to take the form of a tree, this is actually
@@ -403,6 +422,15 @@ typedef struct _MetaDrawSpec {
   /** How many tokens are in the tokens list. */
   int n_tokens;
 
+  /**
+   * The expression as a postfix program with constant parts folded,
+   * or NULL if it could not be compiled; the tokens are evaluated then.
+   */
+  PosInstr *program;
+
+  /** How many instructions are in the program. */
+  int n_program;
+
   /** Does the expression contain any variables? */
   gboolean constant : 1;
 } MetaDrawSpec;
@@ -865,6 +893,10 @@ gboolean meta_parse_size_expression(MetaDrawSpec *spec,
 
 MetaDrawSpec *meta_draw_spec_new(MetaTheme *theme, const char *expr,
                                  GError **error);
+/* Like meta_draw_spec_new (), but takes ownership of tokens */
+MetaDrawSpec *meta_draw_spec_new_from_tokens(MetaTheme *theme,
+                                             PosToken *tokens, int n_tokens,
+                                             GError **error);
 void meta_draw_spec_free(MetaDrawSpec *spec);
 
 MetaColorSpec *meta_color_spec_new(MetaColorSpecType type);
@@ -877,6 +909,8 @@ void meta_color_spec_render(MetaColorSpec *spec, GtkStyleContext *style_gtk,
 
 MetaDrawOp *meta_draw_op_new(MetaDrawType type);
 void meta_draw_op_free(MetaDrawOp *op);
+/* Sets the stripe flags of an image op from its pixbuf */
+void meta_draw_op_find_stripes(MetaDrawOp *op);
 void meta_draw_op_draw(const MetaDrawOp *op, GtkWidget *widget, cairo_t *cr,
                        const MetaDrawInfo *info,
                        /* logical region being drawn */
@@ -899,6 +933,13 @@ void meta_draw_op_list_draw_with_style(const MetaDrawOpList *op_list,
                                        const MetaDrawInfo *info,
                                        MetaRectangle rect);
 void meta_draw_op_list_append(MetaDrawOpList *op_list, MetaDrawOp *op);
+
+/* Accumulates draw op timings into timings, an array of
+ * META_DRAW_TYPE_COUNT entries, until called again with NULL. Timing
+ * every op slows drawing down, so frames drawn meanwhile should not be
+ * timed as a whole.
+ */
+void meta_draw_op_set_timings(MetaDrawOpTiming *timings);
 gboolean meta_draw_op_list_validate(MetaDrawOpList *op_list, GError **error);
 gboolean meta_draw_op_list_contains(MetaDrawOpList *op_list,
                                     MetaDrawOpList *child);
@@ -1041,6 +1082,7 @@ MetaFrameFocus meta_frame_focus_from_string(const char *str);
 const char *meta_frame_focus_to_string(MetaFrameFocus focus);
 MetaFrameType meta_frame_type_from_string(const char *str);
 const char *meta_frame_type_to_string(MetaFrameType type);
+const char *meta_draw_type_to_string(MetaDrawType type);
 MetaGradientType meta_gradient_type_from_string(const char *str);
 const char *meta_gradient_type_to_string(MetaGradientType type);
 GtkStateFlags meta_gtk_state_from_string(const char *str);